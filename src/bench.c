@@ -0,0 +1,587 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ternaryplot.h"
+#include "ternaryplot-csv.h"
+#include "ternaryplot-render.h"
+
+#define UNUSED(x) (void)(x)
+#define CSV_MAX_POINTS 1000000 /* largest text file written for load-csv */
+#define TRAJECTORY_STEP 100 /* samples appended per frame by the trajectory case */
+#define STREAM_BLOCK_CAPACITY 1024 /* queue length of the stream-block case */
+#define STREAM_BLOCK_TIMEOUT 10 /* seconds the stream-block producer may take */
+#define LAYER_TIMEOUT 60 /* seconds the data layer of the largest case may take */
+
+static gint frames = 100;
+static gint width = 600, height = 600;
+static gint64 max_points = 10000000;
+static gchar *format = NULL;
+
+static GOptionEntry entries[] =
+{
+    { "frames", 'n', 0, G_OPTION_ARG_INT, &frames,
+      "Frames timed per case, 100 by default", "N" },
+    { "width", 'W', 0, G_OPTION_ARG_INT, &width,
+      "Plot width, 600 by default", "PX" },
+    { "height", 'H', 0, G_OPTION_ARG_INT, &height,
+      "Plot height, 600 by default", "PX" },
+    { "max-points", 'm', 0, G_OPTION_ARG_INT64, &max_points,
+      "Largest data layer, 1e7 by default", "N" },
+    { "format", 'f', 0, G_OPTION_ARG_STRING, &format,
+      "Output format, json or csv", "FORMAT" },
+    { NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+static gboolean csv;
+static gint n_reports;
+
+static int compare_doubles (const void *a, const void *b)
+{
+    gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* prints summary statistics of per-frame times in milliseconds */
+static void report (const gchar *name, gsize n_points, gdouble *ms, gint n)
+{
+    gdouble sum = 0.0;
+    gint i;
+
+    qsort (ms, n, sizeof (gdouble), compare_doubles);
+    for (i = 0; i < n; i++)
+        sum += ms[i];
+
+    if (csv)
+    {
+        if (n_reports == 0)
+            printf ("case,points,frames,mean_ms,median_ms,p95_ms,min_ms,max_ms\n");
+        printf ("%s,%" G_GSIZE_FORMAT ",%d,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+                name, n_points, n, sum / n, ms[n / 2], ms[n * 95 / 100],
+                ms[0], ms[n - 1]);
+    }
+    else
+        printf ("%s\n  {\"case\": \"%s\", \"points\": %" G_GSIZE_FORMAT
+                ", \"frames\": %d, \"mean_ms\": %.4f, \"median_ms\": %.4f"
+                ", \"p95_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f}",
+                n_reports ? "," : "[",
+                name, n_points, n, sum / n, ms[n / 2], ms[n * 95 / 100],
+                ms[0], ms[n - 1]);
+    fflush (stdout);
+    n_reports++;
+}
+
+/* uniformly distributed compositions */
+static void random_points (gdouble *x, gdouble *y, gdouble *z, gsize n)
+{
+    gsize i;
+
+    for (i = 0; i < n; i++)
+    {
+        gdouble a, b;
+
+        a = g_random_double ();
+        b = g_random_double ();
+        if (a + b > 1.0)
+        {
+            a = 1.0 - a;
+            b = 1.0 - b;
+        }
+        x[i] = a;
+        y[i] = b;
+        z[i] = 1.0 - a - b;
+    }
+}
+
+static void state_init (TernaryRenderState *state)
+{
+    ternary_render_state_init (state);
+    state->xlabel = "Tax";
+    state->ylabel = "Luxury";
+    state->zlabel = "Science";
+    state->x = 0.1;
+    state->y = 0.3;
+    state->z = 0.6;
+    state->glyphs = ternary_glyphs_new ();
+    ternary_glyphs_set_label (state->glyphs, 0, state->xlabel);
+    ternary_glyphs_set_label (state->glyphs, 1, state->ylabel);
+    ternary_glyphs_set_label (state->glyphs, 2, state->zlabel);
+    ternary_render_set_geometry (state, 0, 0, width, height);
+}
+
+/* labels alone, the text path redrawn on every value change */
+static void bench_labels (gdouble *ms)
+{
+    TernaryRenderState state;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    gint i;
+
+    state_init (&state);
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+    cr = cairo_create (surface);
+
+    for (i = 0; i < frames; i++)
+    {
+        gint64 start;
+
+        state.x = (gdouble) i / frames;
+        state.z = 1.0 - state.x - state.y;
+        start = g_get_monotonic_time ();
+        ternary_render_labels (&state, cr);
+        cairo_surface_flush (surface);
+        ms[i] = (g_get_monotonic_time () - start) / 1000.0;
+    }
+
+    cairo_destroy (cr);
+    cairo_surface_destroy (surface);
+    ternary_glyphs_free (state.glyphs);
+    report ("labels", 0, ms, frames);
+}
+
+/* Everything from scratch, as for a resize or a headless render. The
+ * mapped case colours the points by their x through a colormap. */
+static void bench_render (const gchar *name, gdouble *x, gdouble *y,
+    gdouble *z, gsize n, gboolean lod, gboolean mapped, gdouble *ms)
+{
+    TernaryRenderState state;
+    cairo_surface_t *surface;
+    gint i;
+
+    state_init (&state);
+    state.xs = x;
+    state.ys = y;
+    state.zs = z;
+    state.n_points = n;
+    if (mapped)
+    {
+        state.values = x;
+        state.n_values = n;
+    }
+    if (lod)
+        state.pyramid = ternary_pyramid_new (x, y, z, n,
+                                             ternary_pyramid_depth_for (n));
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+
+    for (i = 0; i < frames; i++)
+    {
+        gint64 start;
+        cairo_t *cr;
+
+        start = g_get_monotonic_time ();
+        cr = cairo_create (surface);
+        ternary_render (&state, cr, width, height);
+        cairo_destroy (cr);
+        cairo_surface_flush (surface);
+        ms[i] = (g_get_monotonic_time () - start) / 1000.0;
+    }
+
+    cairo_surface_destroy (surface);
+    ternary_glyphs_free (state.glyphs);
+    ternary_pyramid_free (state.pyramid);
+    report (name, n, ms, frames);
+}
+
+/* parsing a text file already in the page cache, one load per frame */
+static void bench_load_csv (gdouble *x, gdouble *y, gdouble *z, gsize n,
+    gdouble *ms)
+{
+    TernaryCsv *csv;
+    gchar *filename;
+    FILE *stream;
+    gsize i;
+    gint fd, f;
+
+    fd = g_file_open_tmp ("ternaryplot-XXXXXX.csv", &filename, NULL);
+    if (fd < 0)
+        return;
+    stream = fdopen (fd, "w");
+    fprintf (stream, "Tax,Luxury,Science\n");
+    for (i = 0; i < n; i++)
+        fprintf (stream, "%.9f,%.9f,%.9f\n", x[i], y[i], z[i]);
+    fclose (stream);
+
+    for (f = 0; f < frames; f++)
+    {
+        gint64 start;
+
+        start = g_get_monotonic_time ();
+        csv = ternary_csv_load (filename, NULL);
+        ms[f] = (g_get_monotonic_time () - start) / 1000.0;
+        ternary_csv_free (csv);
+    }
+
+    g_unlink (filename);
+    g_free (filename);
+    report ("load-csv", n, ms, frames);
+}
+
+/* dispatches pending events and idles, then repaints */
+static void flush_frame (GtkWidget *plot)
+{
+    while (gtk_events_pending ())
+        gtk_main_iteration_do (FALSE);
+    gdk_window_process_updates (plot->window, TRUE);
+    gdk_flush ();
+}
+
+typedef struct _StreamProducer StreamProducer;
+
+struct _StreamProducer
+{
+    GtkWidget *plot;
+    const gdouble *x, *y, *z;
+    gsize n;
+    gint done;
+};
+
+static gpointer stream_producer (gpointer data)
+{
+    StreamProducer *producer = data;
+
+    ternary_plot_append_points (TERNARY_PLOT (producer->plot), producer->x,
+                                producer->y, producer->z, producer->n);
+    g_atomic_int_set (&producer->done, 1);
+
+    return NULL;
+}
+
+/* A producer thread pushes three queue lengths at once under the block
+ * policy, which only returns if the main loop keeps draining. FALSE
+ * when it did not return in time. */
+static gboolean bench_stream_block (GtkWidget *plot, const gdouble *x,
+    const gdouble *y, const gdouble *z, gdouble *ms)
+{
+    StreamProducer producer;
+    GThread *thread;
+    gint64 start, deadline;
+    guint capacity;
+
+    capacity = ternary_plot_get_stream_capacity (TERNARY_PLOT (plot));
+    ternary_plot_set_points (TERNARY_PLOT (plot), NULL, NULL, NULL, 0);
+    ternary_plot_set_stream_capacity (TERNARY_PLOT (plot),
+                                      STREAM_BLOCK_CAPACITY);
+    ternary_plot_set_overflow_policy (TERNARY_PLOT (plot),
+                                      TERNARY_PLOT_OVERFLOW_BLOCK);
+
+    producer.plot = plot;
+    producer.x = x;
+    producer.y = y;
+    producer.z = z;
+    producer.n = 3 * STREAM_BLOCK_CAPACITY;
+    producer.done = 0;
+
+    start = g_get_monotonic_time ();
+    deadline = start + STREAM_BLOCK_TIMEOUT * G_USEC_PER_SEC;
+    thread = g_thread_new ("producer", stream_producer, &producer);
+    while ((!g_atomic_int_get (&producer.done) ||
+            ternary_plot_get_n_points (TERNARY_PLOT (plot)) < producer.n) &&
+           g_get_monotonic_time () < deadline)
+        if (!g_main_context_iteration (NULL, FALSE))
+            g_usleep (1000);
+    if (!g_atomic_int_get (&producer.done))
+    {
+        /* the producer is stuck and cannot be joined */
+        g_printerr ("stream-block: append did not return within %d s\n",
+                    STREAM_BLOCK_TIMEOUT);
+        return FALSE;
+    }
+    g_thread_join (thread);
+    ms[0] = (g_get_monotonic_time () - start) / 1000.0;
+
+    if (ternary_plot_get_n_points (TERNARY_PLOT (plot)) != producer.n)
+    {
+        g_printerr ("stream-block: %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT
+                    " points arrived\n",
+                    ternary_plot_get_n_points (TERNARY_PLOT (plot)),
+                    producer.n);
+        return FALSE;
+    }
+
+    ternary_plot_set_overflow_policy (TERNARY_PLOT (plot),
+                                      TERNARY_PLOT_OVERFLOW_DROP_OLDEST);
+    ternary_plot_set_stream_capacity (TERNARY_PLOT (plot), capacity);
+    ternary_plot_set_points (TERNARY_PLOT (plot), NULL, NULL, NULL, 0);
+    report ("stream-block", producer.n, ms, 1);
+
+    return TRUE;
+}
+
+/* log-ratio centre and spread of all n points from scratch, the cost a
+ * streamed data set avoids by summarizing only what is appended */
+static void bench_summary (gdouble *x, gdouble *y, gsize n, gdouble *ms)
+{
+    TernaryComposition *composition;
+    gint i;
+
+    composition = ternary_composition_new ();
+    for (i = 0; i < frames; i++)
+    {
+        gint64 start = g_get_monotonic_time ();
+
+        ternary_composition_reset (composition);
+        ternary_composition_update (composition, x, y, NULL, n);
+        ms[i] = (g_get_monotonic_time () - start) / 1000.0;
+    }
+    ternary_composition_free (composition);
+
+    report ("summary", n, ms, frames);
+}
+
+/* Time until the data layer of points just set is drawn, then full
+ * window exposes with it and the other caches warm. */
+static gboolean bench_expose (GtkWidget *plot, gsize n, gdouble *ms)
+{
+    gint64 start, deadline;
+    gint i;
+
+    start = g_get_monotonic_time ();
+    deadline = start + LAYER_TIMEOUT * G_USEC_PER_SEC;
+    flush_frame (plot);
+    while (!ternary_plot_get_layer_ready (TERNARY_PLOT (plot)))
+    {
+        if (g_get_monotonic_time () > deadline)
+        {
+            g_printerr ("layer: %" G_GSIZE_FORMAT " points not drawn"
+                        " within %d s\n", n, LAYER_TIMEOUT);
+            return FALSE;
+        }
+        g_usleep (1000);
+        flush_frame (plot);
+    }
+    ms[0] = (g_get_monotonic_time () - start) / 1000.0;
+    report ("layer", n, ms, 1);
+
+    for (i = 0; i < frames; i++)
+    {
+        start = g_get_monotonic_time ();
+        gdk_window_invalidate_rect (plot->window, NULL, FALSE);
+        flush_frame (plot);
+        ms[i] = (g_get_monotonic_time () - start) / 1000.0;
+    }
+
+    report ("expose", n, ms, frames);
+
+    return TRUE;
+}
+
+/* samples [start, start + n) of a slow closed curve through the field */
+static void trajectory_samples (gsize start, gsize n, gdouble *x, gdouble *y,
+    gdouble *z)
+{
+    gsize i;
+
+    for (i = 0; i < n; i++)
+    {
+        gdouble t = (start + i) * 1e-3;
+
+        x[i] = 1.0 / 3 + 0.2 * cos (t);
+        y[i] = 1.0 / 3 + 0.2 * sin (1.3 * t);
+        z[i] = 1.0 - x[i] - y[i];
+    }
+}
+
+/* a frame's worth of samples appended to a trajectory of n already */
+static void bench_trajectory (GtkWidget *plot, gsize n, gdouble *ms)
+{
+    gdouble x[TRAJECTORY_STEP], y[TRAJECTORY_STEP], z[TRAJECTORY_STEP];
+    gsize i;
+    gint f;
+
+    ternary_plot_clear_trajectory (TERNARY_PLOT (plot));
+    for (i = 0; i < n; i += TRAJECTORY_STEP)
+    {
+        trajectory_samples (i, TRAJECTORY_STEP, x, y, z);
+        ternary_plot_append_trajectory (TERNARY_PLOT (plot), x, y, z,
+                                        MIN (TRAJECTORY_STEP, n - i));
+    }
+    flush_frame (plot);
+
+    for (f = 0; f < frames; f++)
+    {
+        gint64 start;
+
+        trajectory_samples (n + f * TRAJECTORY_STEP, TRAJECTORY_STEP,
+                            x, y, z);
+        start = g_get_monotonic_time ();
+        ternary_plot_append_trajectory (TERNARY_PLOT (plot), x, y, z,
+                                        TRAJECTORY_STEP);
+        flush_frame (plot);
+        ms[f] = (g_get_monotonic_time () - start) / 1000.0;
+    }
+
+    ternary_plot_clear_trajectory (TERNARY_PLOT (plot));
+    report ("trajectory", n, ms, frames);
+}
+
+/* synthetic drag of the pointer across the field, one motion per frame */
+static void bench_drag (GtkWidget *plot, const gchar *name, gsize n,
+    gdouble *ms)
+{
+    GdkEvent event;
+    gdouble x = 0.1, y = 0.3, px, py;
+    gint i;
+
+    ternary_plot_set_point (TERNARY_PLOT (plot), x, y, 1.0 - x - y);
+    ternary_plot_ternary_to_pixels (TERNARY_PLOT (plot), &x, &y, &px, &py, 1);
+    flush_frame (plot);
+
+    memset (&event, 0, sizeof (event));
+    event.button.type = GDK_BUTTON_PRESS;
+    event.button.window = plot->window;
+    event.button.button = 1;
+    event.button.x = px;
+    event.button.y = py;
+    gtk_widget_event (plot, &event);
+
+    for (i = 0; i < frames; i++)
+    {
+        gint64 start;
+
+        /* zigzag between x = 10% and x = 70% */
+        x = 0.1 + 0.6 * (i % 20 < 10 ? i % 10 : 10 - i % 10) / 10.0;
+        ternary_plot_ternary_to_pixels (TERNARY_PLOT (plot), &x, &y, &px, &py, 1);
+
+        memset (&event, 0, sizeof (event));
+        event.motion.type = GDK_MOTION_NOTIFY;
+        event.motion.window = plot->window;
+        event.motion.x = px;
+        event.motion.y = py;
+
+        start = g_get_monotonic_time ();
+        gtk_widget_event (plot, &event);
+        flush_frame (plot);
+        ms[i] = (g_get_monotonic_time () - start) / 1000.0;
+    }
+
+    memset (&event, 0, sizeof (event));
+    event.button.type = GDK_BUTTON_RELEASE;
+    event.button.window = plot->window;
+    event.button.button = 1;
+    event.button.x = px;
+    event.button.y = py;
+    gtk_widget_event (plot, &event);
+    flush_frame (plot);
+
+    report (name, n, ms, frames);
+}
+
+int main (int argc, char *argv[])
+{
+    GOptionContext *context;
+    GError *error = NULL;
+    GtkWidget *window = NULL, *plot = NULL;
+    gdouble *x, *y, *z, *ms;
+    gsize n;
+
+    context = g_option_context_new ("- ternary plot benchmarks");
+    g_option_context_add_main_entries (context, entries, NULL);
+    g_option_context_add_group (context, gtk_get_option_group (FALSE));
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        g_option_context_free (context);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    if (frames <= 0 || width <= 0 || height <= 0 || max_points < 0 ||
+        (format && g_ascii_strcasecmp (format, "csv") != 0 &&
+                   g_ascii_strcasecmp (format, "json") != 0))
+    {
+        g_printerr ("Invalid arguments\n");
+        return 1;
+    }
+    csv = format && g_ascii_strcasecmp (format, "csv") == 0;
+
+    /* the widget cases need a display; the renderer ones do not */
+    if (gtk_init_check (&argc, &argv))
+    {
+#if GTK_CHECK_VERSION (2, 20, 0)
+        window = gtk_offscreen_window_new ();
+#else
+        window = gtk_window_new (GTK_WINDOW_POPUP);
+        gtk_window_move (GTK_WINDOW (window), -2 * width, -2 * height);
+#endif
+        plot = ternary_plot_new ();
+        ternary_plot_set_xlabel (TERNARY_PLOT (plot), "Tax");
+        ternary_plot_set_ylabel (TERNARY_PLOT (plot), "Luxury");
+        ternary_plot_set_zlabel (TERNARY_PLOT (plot), "Science");
+        ternary_plot_set_drag_rate (TERNARY_PLOT (plot), 0);
+        gtk_widget_set_size_request (plot, width, height);
+        gtk_container_add (GTK_CONTAINER (window), plot);
+        gtk_widget_show_all (window);
+        flush_frame (plot);
+    }
+    else
+        g_printerr ("No display, skipping expose and drag cases\n");
+
+    ms = g_new (gdouble, frames);
+    x = g_new (gdouble, MAX (max_points, 1));
+    y = g_new (gdouble, MAX (max_points, 1));
+    z = g_new (gdouble, MAX (max_points, 1));
+    g_random_set_seed (42);
+    random_points (x, y, z, max_points);
+
+    bench_labels (ms);
+    if (plot && max_points >= 3 * STREAM_BLOCK_CAPACITY &&
+        !bench_stream_block (plot, x, y, z, ms))
+        return 1;
+
+    for (n = 1000; n <= (gsize) max_points; n *= 10)
+    {
+        bench_render ("render", x, y, z, n, FALSE, FALSE, ms);
+        bench_render ("render-lod", x, y, z, n, TRUE, FALSE, ms);
+        bench_render ("render-mapped", x, y, z, n, FALSE, TRUE, ms);
+        if (n <= CSV_MAX_POINTS)
+            bench_load_csv (x, y, z, n, ms);
+        bench_summary (x, y, n, ms);
+        if (plot)
+        {
+            ternary_plot_set_points (TERNARY_PLOT (plot), x, y, z, n);
+            if (!bench_expose (plot, n, ms))
+                return 1;
+            bench_drag (plot, "drag", n, ms);
+            /* again while the data layer is redrawn behind the pointer */
+            ternary_plot_set_points (TERNARY_PLOT (plot), x, y, z, n);
+            bench_drag (plot, "drag-redraw", n, ms);
+            bench_trajectory (plot, n, ms);
+        }
+    }
+
+    if (!csv)
+        printf ("\n]\n");
+
+    if (window)
+        gtk_widget_destroy (window);
+    g_free (x);
+    g_free (y);
+    g_free (z);
+    g_free (ms);
+
+    return 0;
+}
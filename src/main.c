@@ -18,12 +18,35 @@
  */
 
 #include <gtk/gtk.h>
-#include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "ternaryplot.h"
+#include "ternaryplot-csv.h"
+#include "ternaryplot-datafile.h"
+#include "ternaryplot-kernels.h"
+#include "ternaryplot-render.h"
 
 #define UNUSED(x) (void)(x)
 
+static gchar *output = NULL;
+static gchar *size = NULL;
+static gboolean contours = FALSE;
+static gboolean summary = FALSE;
+
+static GOptionEntry entries[] =
+{
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+      "Render to FILE (.png, .svg or .pdf) without opening a window", "FILE" },
+    { "size", 's', 0, G_OPTION_ARG_STRING, &size,
+      "Output size, 600x600 by default", "WxH" },
+    { "contours", 'c', 0, G_OPTION_ARG_NONE, &contours,
+      "Draw density contours of the data set", NULL },
+    { "summary", 'm', 0, G_OPTION_ARG_NONE, &summary,
+      "Draw the compositional centre and 95% ellipse of the data set", NULL },
+    { NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
 void destroyed_cb (GtkWidget *widget, gpointer data)
 {
     UNUSED(widget);
@@ -33,67 +56,180 @@ void destroyed_cb (GtkWidget *widget, gpointer data)
     gtk_main_quit ();
 }
 
-gboolean validator (gdouble *x, gdouble *y, gdouble *z)
+/* comma or tab separated text rather than a binary data set */
+static gboolean is_text (const gchar *filename)
+{
+    return g_str_has_suffix (filename, ".csv") ||
+           g_str_has_suffix (filename, ".tsv") ||
+           g_str_has_suffix (filename, ".txt");
+}
+
+static void report_skipped (const gchar *filename, gsize n_skipped)
 {
-    double r;
+    if (n_skipped > 0)
+        g_printerr ("%s: skipped %" G_GSIZE_FORMAT
+                    " rows with a zero sum, NaNs or fewer than three numbers\n",
+                    filename, n_skipped);
+}
 
-    if (*x > 0.8)
+/* renders the demo plot, with the points of a data set if given, straight
+ * to a file, no display needed */
+static int render_to_file (const gchar *filename, const gchar *dimensions,
+    const gchar *dataset)
+{
+    TernaryRenderState state;
+    TernaryRenderFormat format;
+    TernaryDataFile *data = NULL;
+    TernaryCsv *csv = NULL;
+    gdouble *columns = NULL;
+    GError *error = NULL;
+    int status = 0;
+    gint width = 600, height = 600;
+
+    if (dimensions && (sscanf (dimensions, "%dx%d", &width, &height) != 2 ||
+                       width <= 0 || height <= 0))
     {
-        *y += (*x - 0.8)/2;
-        *z += (*x - 0.8)/2;
-        *x = 0.8;
-        g_print ("Point: %.1f,%.1f,%.1f\n",*x,*y,*z);
-        r = fmod (*y, 0.1);
-        r = r < 0.05 ? -r : r; 
-        *y += r;
-        *z += -r;
-        g_print ("Updated point: %.1f,%.1f,%.1f\n",*x,*y,*z);
-        return FALSE;
+        g_printerr ("Invalid size '%s', expected WxH\n", dimensions);
+        return 1;
     }
-    if (*y > 0.8)
+
+    if (g_str_has_suffix (filename, ".svg"))
+        format = TERNARY_RENDER_SVG;
+    else if (g_str_has_suffix (filename, ".pdf"))
+        format = TERNARY_RENDER_PDF;
+    else if (g_str_has_suffix (filename, ".png"))
+        format = TERNARY_RENDER_PNG;
+    else
     {
-        *x += (*y - 0.8)/2;
-        *z += (*y - 0.8)/2;
-        *y = 0.8;
-        g_print ("Point: %.1f,%.1f,%.1f\n",*x,*y,*z);
-        r = fmod (*x, 0.1);
-        r = r < 0.05 ? -r : r; 
-        *x += r;
-        *z += -r;
-        g_print ("Updated point: %.1f,%.1f,%.1f\n",*x,*y,*z);
-        return FALSE;
+        g_printerr ("Unknown output format for '%s'\n", filename);
+        return 1;
     }
-    if (*z > 0.8)
+
+    ternary_render_state_init (&state);
+    state.xlabel = "Tax";
+    state.ylabel = "Luxury";
+    state.zlabel = "Science";
+    state.x = 0.1;
+    state.y = 0.3;
+    state.z = 0.6;
+
+    if (dataset && is_text (dataset))
     {
-        *x += (*z - 0.8)/2;
-        *y += (*z - 0.8)/2;
-        *z = 0.8;
-        g_print ("Point: %.1f,%.1f,%.1f\n",*x,*y,*z);
-        r = fmod (*x, 0.1);
-        r = r < 0.05 ? -r : r; 
-        *x += r;
-        *y += -r;
-        g_print ("Updated point: %.1f,%.1f,%.1f\n",*x,*y,*z);
-        return FALSE;
+        csv = ternary_csv_load (dataset, &error);
+        if (csv == NULL)
+        {
+            g_printerr ("%s\n", error->message);
+            g_error_free (error);
+            return 1;
+        }
+        report_skipped (dataset, csv->n_malformed + csv->n_degenerate);
+
+        state.xs = csv->x;
+        state.ys = csv->y;
+        state.zs = csv->z;
+        state.n_points = csv->n_points;
+        if (csv->labels[0])
+            state.xlabel = csv->labels[0];
+        if (csv->labels[1])
+            state.ylabel = csv->labels[1];
+        if (csv->labels[2])
+            state.zlabel = csv->labels[2];
     }
-    return TRUE;
-}
+    else if (dataset)
+    {
+        data = ternary_data_file_open (dataset, &error);
+        if (data)
+            state.pyramid = ternary_data_file_new_pyramid (data, &error);
+        if (error)
+        {
+            g_printerr ("%s\n", error->message);
+            g_error_free (error);
+            if (data)
+                ternary_data_file_unref (data);
+            return 1;
+        }
 
-void point_changed_cb (TernaryPlot *plot, gdouble x, gdouble y, gdouble z,
-    gpointer data)
-{
-    UNUSED(data);
+        state.xs = (gdouble *) data->x;
+        state.ys = (gdouble *) data->y;
+        state.zs = (gdouble *) data->z;
+        state.n_points = data->n_points;
+        /* the mapping is read only, closed copies are drawn instead */
+        if (!data->closed)
+        {
+            columns = g_new (gdouble, MAX (3 * data->n_points, 1));
+            state.xs = columns;
+            state.ys = columns + data->n_points;
+            state.zs = columns + 2 * data->n_points;
+            ternary_kernels_closure (data->x, data->y, data->z, state.xs,
+                state.ys, state.zs, data->n_points);
+        }
+        if (data->labels[0])
+            state.xlabel = (gchar *) data->labels[0];
+        if (data->labels[1])
+            state.ylabel = (gchar *) data->labels[1];
+        if (data->labels[2])
+            state.zlabel = (gchar *) data->labels[2];
+    }
 
-    gdouble new_x = x, new_y = y, new_z = z;
-    if (!validator (&new_x, &new_y, &new_z))
+    /* no main loop to refine on, so the finest pass right away */
+    if (contours && state.n_points > 0)
+        state.contours = ternary_contour_set_new (state.xs, state.ys,
+            state.zs, state.n_points, 0.05, TERNARY_CONTOURS_RESOLUTION);
+    if (summary)
     {
-        ternary_plot_set_point (plot, new_x, new_y, new_z);
+        state.composition = ternary_composition_new ();
+        ternary_composition_update (state.composition, state.xs, state.ys,
+            NULL, state.n_points);
     }
+
+    if (!ternary_render_to_file (&state, format, filename,
+                                 width, height, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        status = 1;
+    }
+
+    if (data)
+    {
+        ternary_pyramid_free (state.pyramid);
+        ternary_data_file_unref (data);
+    }
+    g_free (columns);
+    ternary_csv_free (csv);
+    ternary_contour_set_free (state.contours);
+    ternary_composition_free (state.composition);
+
+    return status;
 }
 
 int main (int argc,char *argv[])
 {
     GtkWidget *window, *plot;
+    GOptionContext *context;
+    GError *error = NULL;
+
+    /* parse options, without opening the display yet */
+    context = g_option_context_new ("[FILE] - ternary plot demo");
+    g_option_context_add_main_entries (context, entries, NULL);
+    g_option_context_add_group (context, gtk_get_option_group (FALSE));
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        g_option_context_free (context);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    if (argc > 2)
+    {
+        g_printerr ("Only one data set can be shown\n");
+        return 1;
+    }
+
+    if (output)
+        return render_to_file (output, size, argc > 1 ? argv[1] : NULL);
 
     /* initilaize GTK */
     gtk_init (&argc, &argv);
@@ -103,8 +239,30 @@ int main (int argc,char *argv[])
     ternary_plot_set_xlabel ((TernaryPlot*) plot, "Tax");
     ternary_plot_set_ylabel ((TernaryPlot*) plot, "Luxury");
     ternary_plot_set_zlabel ((TernaryPlot*) plot, "Science");
-    g_signal_connect (TERNARY_PLOT (plot), "point-changed",
-                      G_CALLBACK (point_changed_cb), NULL);
+    /* no component may exceed 80% */
+    ternary_plot_set_bounds ((TernaryPlot*) plot, 0.0, 0.8, 0.0, 0.8, 0.0, 0.8);
+    ternary_plot_set_contours ((TernaryPlot*) plot, contours);
+    ternary_plot_set_summary ((TernaryPlot*) plot, summary);
+    if (argc > 1 && is_text (argv[1]))
+    {
+        gsize n_skipped;
+
+        if (!ternary_plot_load_csv ((TernaryPlot*) plot, argv[1], &n_skipped,
+                                    &error))
+        {
+            g_printerr ("%s\n", error->message);
+            g_error_free (error);
+            return 1;
+        }
+        report_skipped (argv[1], n_skipped);
+    }
+    else if (argc > 1 && !ternary_plot_load_data ((TernaryPlot*) plot, argv[1],
+                                                  &error))
+    {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        return 1;
+    }
 
     /* create window */
     window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "ternaryplot-colormap.h"
+
+typedef struct _ColormapInfo ColormapInfo;
+
+struct _ColormapInfo
+{
+    const gchar *name;
+    gboolean discrete; /* stops are bands rather than interpolated */
+    guint n_stops;
+    const guint32 *stops; /* RGB, low values first */
+};
+
+static const guint32 viridis_stops[] =
+{
+    0x440154, 0x472d7b, 0x3b528b, 0x2c728e, 0x21918c,
+    0x28ae80, 0x5ec962, 0xaddc30, 0xfde725
+};
+
+static const guint32 inferno_stops[] =
+{
+    0x000004, 0x1b0c41, 0x4a0c6b, 0x781c6d, 0xa52c60,
+    0xcf4446, 0xed6925, 0xfb9b06, 0xfcffa4
+};
+
+static const guint32 coolwarm_stops[] =
+{
+    0x3b4cc0, 0x8db0fe, 0xdddddd, 0xf49a7b, 0xb40426
+};
+
+/* stops short of white, which would vanish on the background */
+static const guint32 gray_stops[] =
+{
+    0x000000, 0xd0d0d0
+};
+
+static const guint32 category_stops[] =
+{
+    0x1f77b4, 0xff7f0e, 0x2ca02c, 0xd62728, 0x9467bd,
+    0x8c564b, 0xe377c2, 0x7f7f7f, 0xbcbd22, 0x17becf
+};
+
+static const ColormapInfo colormaps[TERNARY_COLORMAP_N] =
+{
+    { "viridis", FALSE, G_N_ELEMENTS (viridis_stops), viridis_stops },
+    { "inferno", FALSE, G_N_ELEMENTS (inferno_stops), inferno_stops },
+    { "coolwarm", FALSE, G_N_ELEMENTS (coolwarm_stops), coolwarm_stops },
+    { "gray", FALSE, G_N_ELEMENTS (gray_stops), gray_stops },
+    { "category", TRUE, G_N_ELEMENTS (category_stops), category_stops }
+};
+
+static guint32 luts[TERNARY_COLORMAP_N][TERNARY_COLORMAP_SIZE];
+static gsize lut_ready[TERNARY_COLORMAP_N];
+
+static inline guint32 mix_channel (guint32 a, guint32 b, guint shift,
+    gdouble f)
+{
+    gdouble ca = (a >> shift) & 0xff, cb = (b >> shift) & 0xff;
+
+    return (guint32) (ca + f * (cb - ca) + 0.5) << shift;
+}
+
+static void colormap_fill (const ColormapInfo *info, guint32 *lut)
+{
+    guint i;
+
+    for (i = 0; i < TERNARY_COLORMAP_SIZE; i++)
+    {
+        guint32 a, b;
+        gdouble t, f;
+        guint k;
+
+        if (info->discrete)
+        {
+            k = MIN (i * info->n_stops / TERNARY_COLORMAP_SIZE,
+                     info->n_stops - 1);
+            lut[i] = 0xff000000 | info->stops[k];
+            continue;
+        }
+
+        t = (gdouble) i / (TERNARY_COLORMAP_SIZE - 1) * (info->n_stops - 1);
+        k = MIN ((guint) t, info->n_stops - 2);
+        f = t - k;
+        a = info->stops[k];
+        b = info->stops[k + 1];
+        lut[i] = 0xff000000 | mix_channel (a, b, 16, f) |
+                 mix_channel (a, b, 8, f) | mix_channel (a, b, 0, f);
+    }
+}
+
+/* TERNARY_COLORMAP_SIZE opaque ARGB32 entries, low values first. Built
+ * on the first call from any thread and never freed. */
+const guint32 *ternary_colormap_get_lut (TernaryColormap colormap)
+{
+    g_return_val_if_fail (colormap < TERNARY_COLORMAP_N, NULL);
+
+    if (g_once_init_enter (&lut_ready[colormap]))
+    {
+        colormap_fill (&colormaps[colormap], luts[colormap]);
+        g_once_init_leave (&lut_ready[colormap], 1);
+    }
+
+    return luts[colormap];
+}
+
+const gchar *ternary_colormap_get_name (TernaryColormap colormap)
+{
+    g_return_val_if_fail (colormap < TERNARY_COLORMAP_N, NULL);
+    return colormaps[colormap].name;
+}
+
+gboolean ternary_colormap_from_name (const gchar *name,
+    TernaryColormap *colormap)
+{
+    guint i;
+
+    g_return_val_if_fail (name != NULL, FALSE);
+
+    for (i = 0; i < TERNARY_COLORMAP_N; i++)
+        if (strcmp (name, colormaps[i].name) == 0)
+        {
+            if (colormap)
+                *colormap = i;
+            return TRUE;
+        }
+
+    return FALSE;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_COLORMAP_H__
+#define __TERNARY_PLOT_COLORMAP_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define TERNARY_COLORMAP_SIZE 256 /* entries per lookup table */
+
+/* Built-in colormaps for per-point values. The continuous ones are
+ * interpolated between a few stops; CATEGORY has ten distinct colours,
+ * one per tenth of the value range, for ids 0 to 9 over a range of 0
+ * to 9. */
+typedef enum
+{
+    TERNARY_COLORMAP_VIRIDIS,
+    TERNARY_COLORMAP_INFERNO,
+    TERNARY_COLORMAP_COOLWARM,
+    TERNARY_COLORMAP_GRAY,
+    TERNARY_COLORMAP_CATEGORY,
+    TERNARY_COLORMAP_N
+} TernaryColormap;
+
+const guint32 *ternary_colormap_get_lut (TernaryColormap colormap);
+const gchar *ternary_colormap_get_name (TernaryColormap colormap);
+gboolean ternary_colormap_from_name (const gchar *name,
+    TernaryColormap *colormap);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,286 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "ternaryplot-composition.h"
+#include "ternaryplot-kernels.h"
+#include "ternaryplot-parallel.h"
+
+#define COMPOSITION_GRAIN 65536 /* rows summarized per worker at least */
+#define COMPOSITION_BLOCK 1024 /* rows transformed together */
+
+typedef struct _Moments Moments;
+
+/* count, mean and co-moments about the mean of (u, v) */
+struct _Moments
+{
+    gdouble n;
+    gdouble u, v;
+    gdouble uu, uv, vv;
+};
+
+struct _TernaryComposition
+{
+    Moments total;
+    gsize n_seen; /* rows scanned, counted or not */
+};
+
+typedef struct _CompositionJob CompositionJob;
+
+struct _CompositionJob
+{
+    const gdouble *xs, *ys;
+    const TernaryFixed *fixed; /* instead of xs and ys when set */
+    gsize start;
+    Moments *partial; /* per worker */
+};
+
+TernaryComposition *ternary_composition_new (void)
+{
+    return g_new0 (TernaryComposition, 1);
+}
+
+void ternary_composition_free (TernaryComposition *composition)
+{
+    g_free (composition);
+}
+
+void ternary_composition_reset (TernaryComposition *composition)
+{
+    g_return_if_fail (composition != NULL);
+
+    memset (&composition->total, 0, sizeof (Moments));
+    composition->n_seen = 0;
+}
+
+/* Pools b into a, exactly as if a had seen b's rows too (Chan et al.),
+ * which keeps the sums well conditioned however many are merged. */
+static void moments_merge (Moments *a, const Moments *b)
+{
+    gdouble n, du, dv, k;
+
+    if (b->n == 0)
+        return;
+
+    n = a->n + b->n;
+    du = b->u - a->u;
+    dv = b->v - a->v;
+    k = a->n * b->n / n;
+    a->u += du * b->n / n;
+    a->v += dv * b->n / n;
+    a->uu += b->uu + du * du * k;
+    a->uv += b->uv + du * dv * k;
+    a->vv += b->vv + dv * dv * k;
+    a->n = n;
+}
+
+/* two passes over a block that stays in cache */
+static void moments_block (Moments *m, const gdouble *u, const gdouble *v,
+    gsize n)
+{
+    gdouble su = 0, sv = 0, count = 0;
+    gsize i;
+
+    memset (m, 0, sizeof (Moments));
+
+    for (i = 0; i < n; i++)
+    {
+        gboolean valid = isfinite (u[i]) && isfinite (v[i]);
+
+        su += valid ? u[i] : 0.0;
+        sv += valid ? v[i] : 0.0;
+        count += valid;
+    }
+    if (count == 0)
+        return;
+
+    m->n = count;
+    m->u = su / count;
+    m->v = sv / count;
+    for (i = 0; i < n; i++)
+    {
+        gboolean valid = isfinite (u[i]) && isfinite (v[i]);
+        gdouble du = valid ? u[i] - m->u : 0.0;
+        gdouble dv = valid ? v[i] - m->v : 0.0;
+
+        m->uu += du * du;
+        m->uv += du * dv;
+        m->vv += dv * dv;
+    }
+}
+
+static void summarize_range (gsize start, gsize end, guint worker,
+    gpointer data)
+{
+    CompositionJob *job = data;
+    gdouble x[COMPOSITION_BLOCK], y[COMPOSITION_BLOCK], z[COMPOSITION_BLOCK];
+    gdouble u[COMPOSITION_BLOCK], v[COMPOSITION_BLOCK];
+    Moments block;
+    gsize i, m;
+
+    for (i = job->start + start; i < job->start + end; i += m)
+    {
+        m = MIN (COMPOSITION_BLOCK, job->start + end - i);
+
+        if (job->fixed)
+        {
+            ternary_fixed_decode (job->fixed, i, m, x, y, z);
+            ternary_kernels_ilr (x, y, z, u, v, m);
+        }
+        else
+            ternary_kernels_ilr (job->xs + i, job->ys + i, NULL, u, v, m);
+
+        moments_block (&block, u, v, m);
+        moments_merge (&job->partial[worker], &block);
+    }
+}
+
+/* Adds the rows from the last one seen up to n_points, on all
+ * processors. */
+void ternary_composition_update (TernaryComposition *composition,
+    const gdouble *xs, const gdouble *ys, const TernaryFixed *fixed,
+    gsize n_points)
+{
+    CompositionJob job;
+    guint n_workers, w;
+    gsize n;
+
+    g_return_if_fail (composition != NULL);
+    g_return_if_fail (n_points <= composition->n_seen || fixed != NULL ||
+                      (xs != NULL && ys != NULL));
+
+    if (n_points <= composition->n_seen)
+        return;
+
+    n = n_points - composition->n_seen;
+    n_workers = ternary_parallel_n_workers (n, COMPOSITION_GRAIN);
+    job.xs = xs;
+    job.ys = ys;
+    job.fixed = fixed;
+    job.start = composition->n_seen;
+    job.partial = g_new0 (Moments, n_workers);
+
+    ternary_parallel_for (n, COMPOSITION_GRAIN, summarize_range, &job);
+
+    for (w = 0; w < n_workers; w++)
+        moments_merge (&composition->total, &job.partial[w]);
+    g_free (job.partial);
+
+    composition->n_seen = n_points;
+}
+
+gsize ternary_composition_get_n_seen (TernaryComposition *composition)
+{
+    g_return_val_if_fail (composition != NULL, 0);
+    return composition->n_seen;
+}
+
+/* rows that entered the summary */
+gsize ternary_composition_get_count (TernaryComposition *composition)
+{
+    g_return_val_if_fail (composition != NULL, 0);
+    return composition->total.n;
+}
+
+/* Closed geometric mean of the rows, FALSE while there are none. */
+gboolean ternary_composition_get_centre (TernaryComposition *composition,
+    gdouble *x, gdouble *y, gdouble *z)
+{
+    gdouble cx, cy, cz;
+
+    g_return_val_if_fail (composition != NULL, FALSE);
+
+    if (composition->total.n == 0)
+        return FALSE;
+
+    ternary_kernels_ilr_inverse (&composition->total.u, &composition->total.v,
+                                 &cx, &cy, &cz, 1);
+    if (x)
+        *x = cx;
+    if (y)
+        *y = cy;
+    if (z)
+        *z = cz;
+
+    return TRUE;
+}
+
+/* Trace of the clr covariance, the same as that of the ilr one. */
+gdouble ternary_composition_get_total_variance (
+    TernaryComposition *composition)
+{
+    const Moments *m;
+
+    g_return_val_if_fail (composition != NULL, 0.0);
+
+    m = &composition->total;
+    if (m->n < 2)
+        return 0.0;
+    return (m->uu + m->vv) / (m->n - 1);
+}
+
+/* Fills n points of the ellipse that holds a fraction level of a normal
+ * distribution with the mean and covariance of the rows, drawn in ilr
+ * coordinates and mapped back onto the simplex, where it is no longer
+ * an ellipse. FALSE with fewer than two rows. */
+gboolean ternary_composition_ellipse (TernaryComposition *composition,
+    gdouble level, gdouble *x, gdouble *y, guint n)
+{
+    const Moments *m;
+    gdouble su, sv, suv, r, l11, l21, l22;
+    gdouble *u, *v, *z;
+    guint i;
+
+    g_return_val_if_fail (composition != NULL, FALSE);
+    g_return_val_if_fail (level > 0.0 && level < 1.0, FALSE);
+    g_return_val_if_fail (n == 0 || (x != NULL && y != NULL), FALSE);
+
+    m = &composition->total;
+    if (m->n < 2)
+        return FALSE;
+
+    su = m->uu / (m->n - 1);
+    suv = m->uv / (m->n - 1);
+    sv = m->vv / (m->n - 1);
+
+    /* radius from the chi-square quantile with two degrees of freedom,
+     * shape from the Cholesky factor of the covariance */
+    r = sqrt (-2.0 * log (1.0 - level));
+    l11 = sqrt (su);
+    l21 = l11 > 0 ? suv / l11 : 0.0;
+    l22 = sqrt (MAX (sv - l21 * l21, 0.0));
+
+    u = g_new (gdouble, 3 * n);
+    v = u + n;
+    z = v + n;
+    for (i = 0; i < n; i++)
+    {
+        gdouble t = 2 * G_PI * i / n, c = r * cos (t), s = r * sin (t);
+
+        u[i] = m->u + l11 * c;
+        v[i] = m->v + l21 * c + l22 * s;
+    }
+    ternary_kernels_ilr_inverse (u, v, x, y, z, n);
+    g_free (u);
+
+    return TRUE;
+}
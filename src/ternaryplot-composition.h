@@ -0,0 +1,52 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_COMPOSITION_H__
+#define __TERNARY_PLOT_COMPOSITION_H__
+
+#include <glib.h>
+
+#include "ternaryplot-fixed.h"
+
+G_BEGIN_DECLS
+
+/* Running summary of points in ilr coordinates: their count, mean and
+ * covariance. Points are only ever added, so a summary follows a growing
+ * data set by scanning just the rows it has not seen. Rows with a zero
+ * part have no log-ratios and are passed over. */
+typedef struct _TernaryComposition TernaryComposition;
+
+TernaryComposition *ternary_composition_new (void);
+void ternary_composition_free (TernaryComposition *composition);
+void ternary_composition_reset (TernaryComposition *composition);
+void ternary_composition_update (TernaryComposition *composition,
+    const gdouble *xs, const gdouble *ys, const TernaryFixed *fixed,
+    gsize n_points);
+gsize ternary_composition_get_n_seen (TernaryComposition *composition);
+gsize ternary_composition_get_count (TernaryComposition *composition);
+gboolean ternary_composition_get_centre (TernaryComposition *composition,
+    gdouble *x, gdouble *y, gdouble *z);
+gdouble ternary_composition_get_total_variance (
+    TernaryComposition *composition);
+gboolean ternary_composition_ellipse (TernaryComposition *composition,
+    gdouble level, gdouble *x, gdouble *y, guint n);
+
+G_END_DECLS
+
+#endif
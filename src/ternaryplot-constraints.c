@@ -0,0 +1,310 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "ternaryplot-constraints.h"
+
+#define SQRT3 1.7320508075688772
+#define EPSILON 1e-12
+
+/* The polygon lives on an equilateral triangle with z at (0, 0), y at
+ * (1, 0) and x at (1/2, sqrt (3) / 2), so nearest points there are
+ * nearest on screen as well. */
+typedef struct _Vertex Vertex;
+typedef struct _HalfPlane HalfPlane;
+
+struct _Vertex
+{
+    gdouble u, v;
+};
+
+/* nu * u + nv * v <= offset */
+struct _HalfPlane
+{
+    gdouble nu, nv, offset;
+};
+
+struct _TernaryConstraints
+{
+    gdouble min[3], max[3]; /* bounds of x, y and z */
+    GArray *inequalities; /* HalfPlane, general constraints */
+    Vertex *vertices; /* feasible polygon, counter-clockwise */
+    guint n_vertices; /* 0 when nothing is feasible */
+    Vertex *edges; /* from each vertex to the next */
+    gdouble *inv_lengths; /* squared inverse edge lengths, 0 if degenerate */
+};
+
+/* a x + b y + c z <= d, with x = 2v / sqrt (3), y = u - v / sqrt (3)
+ * and z = 1 - x - y */
+static HalfPlane half_plane (gdouble a, gdouble b, gdouble c, gdouble d)
+{
+    HalfPlane h;
+
+    h.nu = b - c;
+    h.nv = (2 * a - b - c) / SQRT3;
+    h.offset = d - c;
+
+    return h;
+}
+
+/* Sutherland-Hodgman against one half-plane, which keeps a convex
+ * polygon convex and its vertices in order */
+static guint clip (const Vertex *in, guint n, HalfPlane h, Vertex *out)
+{
+    guint i, m = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        const Vertex *p = &in[i], *q = &in[(i + 1) % n];
+        gdouble fp, fq;
+
+        fp = h.nu * p->u + h.nv * p->v - h.offset;
+        fq = h.nu * q->u + h.nv * q->v - h.offset;
+
+        if (fp <= EPSILON)
+            out[m++] = *p;
+        if ((fp <= EPSILON) != (fq <= EPSILON) && fabs (fp - fq) > 0)
+        {
+            gdouble t = fp / (fp - fq);
+
+            out[m].u = p->u + t * (q->u - p->u);
+            out[m].v = p->v + t * (q->v - p->v);
+            m++;
+        }
+    }
+
+    return m;
+}
+
+/* each cut adds at most one vertex */
+static guint polygon_capacity (TernaryConstraints *constraints)
+{
+    return 2 * (constraints->inequalities->len + 10);
+}
+
+/* Cuts the simplex with every constraint into vertices, which must have
+ * room for all of them plus the three corners. Returns the number of
+ * vertices left, merging those that coincide. */
+static guint build_polygon (TernaryConstraints *constraints,
+    const HalfPlane *extra, Vertex *vertices)
+{
+    Vertex *scratch;
+    guint n, i, k;
+
+    scratch = g_new (Vertex, polygon_capacity (constraints));
+
+    vertices[0].u = 0.0; vertices[0].v = 0.0;
+    vertices[1].u = 1.0; vertices[1].v = 0.0;
+    vertices[2].u = 0.5; vertices[2].v = SQRT3 / 2;
+    n = 3;
+
+    for (k = 0; k < 3 && n > 0; k++)
+    {
+        gdouble a[3] = { 0.0, 0.0, 0.0 };
+
+        a[k] = -1.0;
+        n = clip (vertices, n, half_plane (a[0], a[1], a[2],
+                  -constraints->min[k]), scratch);
+        a[k] = 1.0;
+        n = clip (scratch, n, half_plane (a[0], a[1], a[2],
+                  constraints->max[k]), vertices);
+    }
+    for (i = 0; i < constraints->inequalities->len && n > 0; i++)
+    {
+        n = clip (vertices, n, g_array_index (constraints->inequalities,
+                  HalfPlane, i), scratch);
+        memcpy (vertices, scratch, n * sizeof (Vertex));
+    }
+    if (extra && n > 0)
+    {
+        n = clip (vertices, n, *extra, scratch);
+        memcpy (vertices, scratch, n * sizeof (Vertex));
+    }
+
+    g_free (scratch);
+
+    /* cuts through a vertex duplicate it */
+    for (i = 0, k = 0; i < n; i++)
+        if (k == 0 || fabs (vertices[i].u - vertices[k - 1].u) > EPSILON ||
+            fabs (vertices[i].v - vertices[k - 1].v) > EPSILON)
+            vertices[k++] = vertices[i];
+    while (k > 1 && fabs (vertices[k - 1].u - vertices[0].u) <= EPSILON &&
+           fabs (vertices[k - 1].v - vertices[0].v) <= EPSILON)
+        k--;
+
+    return k;
+}
+
+/* Rebuilds the polygon with extra added, or leaves everything as it was
+ * and returns FALSE if nothing would be feasible. */
+static gboolean update (TernaryConstraints *constraints,
+    const HalfPlane *extra)
+{
+    Vertex *vertices;
+    guint n, i;
+
+    vertices = g_new (Vertex, polygon_capacity (constraints));
+    n = build_polygon (constraints, extra, vertices);
+    if (n == 0)
+    {
+        g_free (vertices);
+        return FALSE;
+    }
+
+    if (extra)
+        g_array_append_val (constraints->inequalities, *extra);
+
+    g_free (constraints->vertices);
+    g_free (constraints->edges);
+    g_free (constraints->inv_lengths);
+    constraints->vertices = vertices;
+    constraints->n_vertices = n;
+    constraints->edges = g_new (Vertex, n);
+    constraints->inv_lengths = g_new (gdouble, n);
+    for (i = 0; i < n; i++)
+    {
+        Vertex *e = &constraints->edges[i];
+        gdouble length;
+
+        e->u = vertices[(i + 1) % n].u - vertices[i].u;
+        e->v = vertices[(i + 1) % n].v - vertices[i].v;
+        length = e->u * e->u + e->v * e->v;
+        constraints->inv_lengths[i] = length > 0 ? 1.0 / length : 0.0;
+    }
+
+    return TRUE;
+}
+
+TernaryConstraints *ternary_constraints_new (void)
+{
+    TernaryConstraints *constraints;
+
+    constraints = g_new0 (TernaryConstraints, 1);
+    constraints->inequalities = g_array_new (FALSE, FALSE, sizeof (HalfPlane));
+    ternary_constraints_clear (constraints);
+
+    return constraints;
+}
+
+void ternary_constraints_free (TernaryConstraints *constraints)
+{
+    if (constraints == NULL)
+        return;
+
+    g_array_free (constraints->inequalities, TRUE);
+    g_free (constraints->vertices);
+    g_free (constraints->edges);
+    g_free (constraints->inv_lengths);
+    g_free (constraints);
+}
+
+/* Replaces the bounds of the components, min[i] <= x_i <= max[i]. Bounds
+ * leaving nothing feasible are refused and FALSE is returned. */
+gboolean ternary_constraints_set_bounds (TernaryConstraints *constraints,
+    const gdouble *min, const gdouble *max)
+{
+    gdouble old_min[3], old_max[3];
+
+    memcpy (old_min, constraints->min, sizeof (old_min));
+    memcpy (old_max, constraints->max, sizeof (old_max));
+    memcpy (constraints->min, min, sizeof (old_min));
+    memcpy (constraints->max, max, sizeof (old_max));
+
+    if (update (constraints, NULL))
+        return TRUE;
+
+    memcpy (constraints->min, old_min, sizeof (old_min));
+    memcpy (constraints->max, old_max, sizeof (old_max));
+    return FALSE;
+}
+
+/* Adds a x + b y + c z <= d, unless it leaves nothing feasible. */
+gboolean ternary_constraints_add (TernaryConstraints *constraints,
+    gdouble a, gdouble b, gdouble c, gdouble d)
+{
+    HalfPlane h = half_plane (a, b, c, d);
+
+    return update (constraints, &h);
+}
+
+/* back to the whole simplex */
+void ternary_constraints_clear (TernaryConstraints *constraints)
+{
+    guint k;
+
+    for (k = 0; k < 3; k++)
+    {
+        constraints->min[k] = 0.0;
+        constraints->max[k] = 1.0;
+    }
+    g_array_set_size (constraints->inequalities, 0);
+    update (constraints, NULL);
+}
+
+/* Moves (x, y, z) to the nearest feasible point, measured on screen.
+ * Returns TRUE if it had to be moved. */
+gboolean ternary_constraints_project (TernaryConstraints *constraints,
+    gdouble *x, gdouble *y, gdouble *z)
+{
+    const Vertex *vertices = constraints->vertices;
+    const Vertex *edges = constraints->edges;
+    gdouble u, v, best_u = 0.0, best_v = 0.0, best = G_MAXDOUBLE;
+    gboolean inside = TRUE;
+    guint i;
+
+    u = *y + *x / 2;
+    v = *x * SQRT3 / 2;
+
+    /* inside is left of every edge */
+    for (i = 0; i < constraints->n_vertices && inside; i++)
+        inside = edges[i].u * (v - vertices[i].v) -
+                 edges[i].v * (u - vertices[i].u) >= -EPSILON;
+    if (inside && constraints->n_vertices > 2)
+        return FALSE;
+
+    for (i = 0; i < constraints->n_vertices; i++)
+    {
+        gdouble t, pu, pv, d;
+
+        t = ((u - vertices[i].u) * edges[i].u +
+             (v - vertices[i].v) * edges[i].v) * constraints->inv_lengths[i];
+        t = CLAMP (t, 0.0, 1.0);
+        pu = vertices[i].u + t * edges[i].u;
+        pv = vertices[i].v + t * edges[i].v;
+        d = (u - pu) * (u - pu) + (v - pv) * (v - pv);
+        if (d < best)
+        {
+            best = d;
+            best_u = pu;
+            best_v = pv;
+        }
+    }
+
+    if (best <= EPSILON * EPSILON)
+        return FALSE;
+
+    *x = 2 * best_v / SQRT3;
+    *y = best_u - best_v / SQRT3;
+    *z = 1.0 - *x - *y;
+
+    return TRUE;
+}
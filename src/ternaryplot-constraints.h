@@ -0,0 +1,45 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_CONSTRAINTS_H__
+#define __TERNARY_PLOT_CONSTRAINTS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Convex feasible region of the simplex, cut by per-component bounds and
+ * linear inequalities. The region is kept as a polygon with its edges
+ * precomputed, so projecting a point costs a pass over a handful of
+ * edges. */
+typedef struct _TernaryConstraints TernaryConstraints;
+
+TernaryConstraints *ternary_constraints_new (void);
+void ternary_constraints_free (TernaryConstraints *constraints);
+gboolean ternary_constraints_set_bounds (TernaryConstraints *constraints,
+    const gdouble *min, const gdouble *max);
+gboolean ternary_constraints_add (TernaryConstraints *constraints,
+    gdouble a, gdouble b, gdouble c, gdouble d);
+void ternary_constraints_clear (TernaryConstraints *constraints);
+gboolean ternary_constraints_project (TernaryConstraints *constraints,
+    gdouble *x, gdouble *y, gdouble *z);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,601 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ternaryplot-contours.h"
+#include "ternaryplot-parallel.h"
+
+#define CONTOUR_COARSE 32 /* first pass lattice */
+#define CONTOUR_GRAIN 65536 /* points binned per worker at least */
+#define CONTOUR_CHECK 16384 /* points binned between cancellation checks */
+#define SQRT3_2 0.86602540378443864676
+
+typedef struct _ContourGrid ContourGrid;
+typedef struct _ContourBin ContourBin;
+typedef struct _ContourJob ContourJob;
+
+/* Cartesian grid over the simplex at X = y + x/2, Y = x * sqrt(3)/2,
+ * spacing 1/resolution, so the kernel is round on screen */
+struct _ContourGrid
+{
+    gint nx, ny;
+    gdouble *cells;
+};
+
+struct _ContourBin
+{
+    const gdouble *x, *y;
+    const TernaryFixed *fixed; /* instead of x and y when set */
+    guint resolution;
+    ContourGrid *grids; /* per worker */
+    volatile gint *generation; /* cancelled once it differs from expected */
+    gint expected;
+};
+
+struct _ContourJob
+{
+    gint generation;
+    const gdouble *x, *y, *z;
+    const TernaryFixed *fixed;
+    gsize n;
+    gdouble bandwidth;
+};
+
+struct _TernaryContours
+{
+    GRWLock data_lock; /* read while binning from the plot data */
+    GMutex lock; /* guards the fields below */
+    volatile gint generation; /* bumped on cancellation */
+    GThreadPool *pool; /* one worker, passes run in order */
+    TernaryContourSet *pending; /* latest pass not handed over yet */
+    guint ready_id; /* pending ready notification */
+    TernaryContoursReadyFunc ready;
+    gpointer data;
+};
+
+static const gdouble contour_fractions[TERNARY_CONTOURS_N_LEVELS] =
+{
+    0.95, 0.75, 0.5, 0.25
+};
+
+static inline gboolean contour_cancelled (volatile gint *generation,
+    gint expected)
+{
+    return generation && g_atomic_int_get (generation) != expected;
+}
+
+static void contour_grid_init (ContourGrid *grid, guint resolution)
+{
+    grid->nx = resolution + 2;
+    grid->ny = (gint) ceil (SQRT3_2 * resolution) + 2;
+    grid->cells = g_new0 (gdouble, grid->nx * grid->ny);
+}
+
+/* spreads every point over the 4 grid nodes around it */
+static void contour_bin_range (gsize start, gsize end, guint worker,
+    gpointer data)
+{
+    ContourBin *bin = data;
+    ContourGrid *grid = &bin->grids[worker];
+    gdouble r = bin->resolution;
+    gsize i;
+
+    contour_grid_init (grid, bin->resolution);
+
+    for (i = start; i < end; i++)
+    {
+        gdouble x, y, z, gx, gy, fx, fy;
+        gdouble *cell;
+        gint ix, iy;
+
+        if ((i - start) % CONTOUR_CHECK == 0 &&
+            contour_cancelled (bin->generation, bin->expected))
+            return;
+
+        if (bin->fixed)
+            ternary_fixed_get (bin->fixed, i, &x, &y, &z);
+        else
+        {
+            x = bin->x[i];
+            y = bin->y[i];
+        }
+
+        /* also rejects NaNs */
+        if (!(x >= 0 && y >= 0 && x + y <= 1))
+            continue;
+
+        gx = (y + 0.5 * x) * r;
+        gy = x * SQRT3_2 * r;
+        ix = MIN ((gint) gx, grid->nx - 2);
+        iy = MIN ((gint) gy, grid->ny - 2);
+        fx = gx - ix;
+        fy = gy - iy;
+
+        cell = grid->cells + iy * grid->nx + ix;
+        cell[0] += (1 - fx) * (1 - fy);
+        cell[1] += fx * (1 - fy);
+        cell[grid->nx] += (1 - fx) * fy;
+        cell[grid->nx + 1] += fx * fy;
+    }
+}
+
+/* Bins the points on all processors into grid. Returns FALSE when
+ * cancelled on the way. */
+static gboolean contour_bin (ContourGrid *grid, const gdouble *x,
+    const gdouble *y, const TernaryFixed *fixed, gsize n, guint resolution,
+    volatile gint *generation, gint expected)
+{
+    ContourBin bin;
+    guint n_workers, w;
+    gint c;
+
+    n_workers = ternary_parallel_n_workers (n, CONTOUR_GRAIN);
+    bin.x = x;
+    bin.y = y;
+    bin.fixed = fixed;
+    bin.resolution = resolution;
+    bin.grids = g_new0 (ContourGrid, n_workers);
+    bin.generation = generation;
+    bin.expected = expected;
+
+    if (n > 0)
+        ternary_parallel_for (n, CONTOUR_GRAIN, contour_bin_range, &bin);
+    else
+        contour_grid_init (&bin.grids[0], resolution);
+
+    *grid = bin.grids[0];
+    for (w = 1; w < n_workers; w++)
+    {
+        for (c = 0; c < grid->nx * grid->ny; c++)
+            grid->cells[c] += bin.grids[w].cells[c];
+        g_free (bin.grids[w].cells);
+    }
+    g_free (bin.grids);
+
+    return !contour_cancelled (generation, expected);
+}
+
+/* separable Gaussian blur, sigma in grid cells */
+static void contour_blur (ContourGrid *grid, gdouble sigma)
+{
+    gdouble *kernel, *rows, sum = 0.0;
+    gint radius, d, i, j;
+
+    radius = (gint) ceil (3 * sigma);
+    if (radius < 1)
+        return;
+
+    kernel = g_new (gdouble, 2 * radius + 1);
+    for (d = -radius; d <= radius; d++)
+        sum += kernel[d + radius] = exp (-0.5 * d * d / (sigma * sigma));
+    for (d = 0; d <= 2 * radius; d++)
+        kernel[d] /= sum;
+
+    /* along X into rows, then along Y back into the grid */
+    rows = g_new0 (gdouble, grid->nx * grid->ny);
+    for (j = 0; j < grid->ny; j++)
+        for (i = 0; i < grid->nx; i++)
+        {
+            gdouble value = grid->cells[j * grid->nx + i];
+
+            if (value == 0)
+                continue;
+            for (d = MAX (-radius, -i); d <= MIN (radius, grid->nx - 1 - i); d++)
+                rows[j * grid->nx + i + d] += value * kernel[d + radius];
+        }
+
+    memset (grid->cells, 0, grid->nx * grid->ny * sizeof (gdouble));
+    for (j = 0; j < grid->ny; j++)
+        for (d = MAX (-radius, -j); d <= MIN (radius, grid->ny - 1 - j); d++)
+        {
+            const gdouble *src = rows + j * grid->nx;
+            gdouble *dst = grid->cells + (j + d) * grid->nx;
+            gdouble k = kernel[d + radius];
+
+            for (i = 0; i < grid->nx; i++)
+                dst[i] += k * src[i];
+        }
+
+    g_free (rows);
+    g_free (kernel);
+}
+
+/* lattice node (i, j) is at x = i/r, y = j/r; rows shrink as x grows */
+static inline gsize contour_node (guint resolution, guint i, guint j)
+{
+    return (gsize) i * (resolution + 1) - (gsize) i * (i - 1) / 2 + j;
+}
+
+/* bilinear sample of the grid at every lattice node */
+static gdouble *contour_sample (ContourGrid *grid, guint resolution)
+{
+    gdouble *values;
+    guint i, j;
+
+    values = g_new (gdouble, contour_node (resolution, resolution, 0) + 1);
+    for (i = 0; i <= resolution; i++)
+        for (j = 0; j <= resolution - i; j++)
+        {
+            gdouble gx = j + 0.5 * i, gy = i * SQRT3_2, fx, fy;
+            const gdouble *cell;
+            gint ix, iy;
+
+            ix = MIN ((gint) gx, grid->nx - 2);
+            iy = MIN ((gint) gy, grid->ny - 2);
+            fx = gx - ix;
+            fy = gy - iy;
+            cell = grid->cells + iy * grid->nx + ix;
+            values[contour_node (resolution, i, j)] =
+                (1 - fy) * ((1 - fx) * cell[0] + fx * cell[1]) +
+                fy * ((1 - fx) * cell[grid->nx] + fx * cell[grid->nx + 1]);
+        }
+
+    return values;
+}
+
+static int compare_descending (const void *a, const void *b)
+{
+    gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+
+    return x > y ? -1 : x < y;
+}
+
+/* densities whose superlevel sets hold the wanted fractions of mass */
+static void contour_levels (TernaryContourSet *set, const gdouble *values,
+    gsize n_values)
+{
+    gdouble *sorted, total = 0.0, sum = 0.0;
+    gsize k = 0;
+    guint l;
+
+    sorted = g_new (gdouble, n_values);
+    memcpy (sorted, values, n_values * sizeof (gdouble));
+    qsort (sorted, n_values, sizeof (gdouble), compare_descending);
+    for (k = 0; k < n_values; k++)
+        total += sorted[k];
+
+    /* fractions shrink, so walk from the innermost level out */
+    k = 0;
+    for (l = TERNARY_CONTOURS_N_LEVELS; l-- > 0;)
+    {
+        set->fractions[l] = contour_fractions[l];
+        while (k < n_values && sum < contour_fractions[l] * total)
+            sum += sorted[k++];
+        set->levels[l] = k > 0 ? sorted[k - 1] : 0.0;
+    }
+
+    g_free (sorted);
+}
+
+static void path_append (GArray *data, cairo_path_data_type_t type,
+    gdouble x, gdouble y)
+{
+    cairo_path_data_t item;
+
+    item.header.type = type;
+    item.header.length = 2;
+    g_array_append_val (data, item);
+    item.point.x = x;
+    item.point.y = y;
+    g_array_append_val (data, item);
+}
+
+/* crossing of the level on the edge from node a to node b */
+static inline void contour_cross (gdouble level, const gdouble *pa,
+    gdouble fa, const gdouble *pb, gdouble fb, gdouble *point)
+{
+    gdouble t = (level - fa) / (fb - fa);
+
+    point[0] = pa[0] + t * (pb[0] - pa[0]);
+    point[1] = pa[1] + t * (pb[1] - pa[1]);
+}
+
+/* one segment where the level crosses a lattice triangle */
+static void contour_triangle (GArray *data, gdouble level,
+    const gdouble p[3][2], const gdouble f[3])
+{
+    gdouble ends[2][2];
+    guint a, n = 0;
+
+    for (a = 0; a < 3; a++)
+    {
+        guint b = (a + 1) % 3;
+
+        if ((f[a] >= level) != (f[b] >= level))
+            contour_cross (level, p[a], f[a], p[b], f[b], ends[n++]);
+    }
+
+    if (n == 2)
+    {
+        path_append (data, CAIRO_PATH_MOVE_TO, ends[0][0], ends[0][1]);
+        path_append (data, CAIRO_PATH_LINE_TO, ends[1][0], ends[1][1]);
+    }
+}
+
+/* Marching triangles over the lattice, upward and downward cells. The
+ * path is built by hand so the coordinates keep full precision. */
+static cairo_path_t *contour_path (const gdouble *values, guint resolution,
+    gdouble level)
+{
+    cairo_path_t *path;
+    GArray *data;
+    gdouble r = resolution;
+    guint i, j;
+
+    data = g_array_new (FALSE, FALSE, sizeof (cairo_path_data_t));
+    for (i = 0; i < resolution; i++)
+        for (j = 0; j < resolution - i; j++)
+        {
+            gdouble p[3][2], f[3];
+
+            p[0][0] = i / r;
+            p[0][1] = j / r;
+            p[1][0] = (i + 1) / r;
+            p[1][1] = j / r;
+            p[2][0] = i / r;
+            p[2][1] = (j + 1) / r;
+            f[0] = values[contour_node (resolution, i, j)];
+            f[1] = values[contour_node (resolution, i + 1, j)];
+            f[2] = values[contour_node (resolution, i, j + 1)];
+            contour_triangle (data, level, p, f);
+
+            if (i + j + 2 > resolution)
+                continue;
+
+            p[0][0] = (i + 1) / r;
+            p[0][1] = (j + 1) / r;
+            f[0] = values[contour_node (resolution, i + 1, j + 1)];
+            contour_triangle (data, level, p, f);
+        }
+
+    path = g_new (cairo_path_t, 1);
+    path->status = CAIRO_STATUS_SUCCESS;
+    path->num_data = data->len;
+    path->data = (cairo_path_data_t *) g_array_free (data, FALSE);
+
+    return path;
+}
+
+/* smoothing, levels and isolines of a binned pass */
+static TernaryContourSet *contour_set_from_grid (ContourGrid *grid,
+    gdouble bandwidth, guint resolution)
+{
+    TernaryContourSet *set;
+    gdouble *values;
+    guint l;
+
+    set = g_new0 (TernaryContourSet, 1);
+    set->resolution = resolution;
+    set->bandwidth = bandwidth;
+
+    contour_blur (grid, bandwidth * resolution);
+    values = contour_sample (grid, resolution);
+    contour_levels (set, values, contour_node (resolution, resolution, 0) + 1);
+    for (l = 0; l < TERNARY_CONTOURS_N_LEVELS; l++)
+        if (set->levels[l] > 0)
+            set->paths[l] = contour_path (values, resolution, set->levels[l]);
+
+    g_free (values);
+
+    return set;
+}
+
+/* Estimates the contours of n closed compositions in one go, blocking,
+ * for renders that cannot wait. */
+TernaryContourSet *ternary_contour_set_new (const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, gdouble bandwidth,
+    guint resolution)
+{
+    TernaryContourSet *set;
+    ContourGrid grid;
+
+    g_return_val_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL),
+                          NULL);
+    g_return_val_if_fail (resolution > 0, NULL);
+
+    contour_bin (&grid, x, y, NULL, n, resolution, NULL, 0);
+    set = contour_set_from_grid (&grid, bandwidth, resolution);
+    g_free (grid.cells);
+
+    return set;
+}
+
+void ternary_contour_set_free (TernaryContourSet *set)
+{
+    guint l;
+
+    if (set == NULL)
+        return;
+
+    for (l = 0; l < TERNARY_CONTOURS_N_LEVELS; l++)
+        if (set->paths[l])
+        {
+            g_free (set->paths[l]->data);
+            g_free (set->paths[l]);
+        }
+    g_free (set);
+}
+
+static gboolean contours_ready (gpointer data)
+{
+    TernaryContours *contours = data;
+    TernaryContourSet *set;
+
+    g_mutex_lock (&contours->lock);
+    set = contours->pending;
+    contours->pending = NULL;
+    contours->ready_id = 0;
+    g_mutex_unlock (&contours->lock);
+
+    if (set)
+        contours->ready (set, contours->data);
+
+    return FALSE;
+}
+
+/* queues a finished pass for the main loop unless it is stale */
+static void contours_deliver (TernaryContours *contours,
+    TernaryContourSet *set, gint generation)
+{
+    g_mutex_lock (&contours->lock);
+    if (generation == g_atomic_int_get (&contours->generation))
+    {
+        ternary_contour_set_free (contours->pending);
+        contours->pending = set;
+        set = NULL;
+        if (contours->ready_id == 0)
+            contours->ready_id = g_idle_add (contours_ready, contours);
+    }
+    g_mutex_unlock (&contours->lock);
+
+    ternary_contour_set_free (set);
+}
+
+/* Runs the passes of one update, doubling the lattice resolution each
+ * time. Only binning reads the plot data; it checks for cancellation
+ * often so a new update never waits long. */
+static void contours_run (gpointer data, gpointer user_data)
+{
+    ContourJob *job = data;
+    TernaryContours *contours = user_data;
+    guint resolution;
+
+    for (resolution = CONTOUR_COARSE;
+         resolution <= TERNARY_CONTOURS_RESOLUTION; resolution *= 2)
+    {
+        TernaryContourSet *set;
+        ContourGrid grid;
+        gboolean binned;
+
+        grid.cells = NULL;
+        g_rw_lock_reader_lock (&contours->data_lock);
+        binned = !contour_cancelled (&contours->generation, job->generation) &&
+                 contour_bin (&grid, job->x, job->y, job->fixed, job->n,
+                              resolution, &contours->generation,
+                              job->generation);
+        g_rw_lock_reader_unlock (&contours->data_lock);
+
+        if (!binned)
+        {
+            g_free (grid.cells);
+            break;
+        }
+
+        set = contour_set_from_grid (&grid, job->bandwidth, resolution);
+        g_free (grid.cells);
+        contours_deliver (contours, set, job->generation);
+    }
+
+    g_free (job);
+}
+
+TernaryContours *ternary_contours_new (TernaryContoursReadyFunc ready,
+    gpointer data)
+{
+    TernaryContours *contours;
+
+    contours = g_new0 (TernaryContours, 1);
+    g_rw_lock_init (&contours->data_lock);
+    g_mutex_init (&contours->lock);
+    contours->pool = g_thread_pool_new (contours_run, contours, 1, FALSE,
+                                        NULL);
+    contours->ready = ready;
+    contours->data = data;
+
+    return contours;
+}
+
+void ternary_contours_free (TernaryContours *contours)
+{
+    if (contours == NULL)
+        return;
+
+    /* queued and running jobs are stale now and finish at once */
+    ternary_contours_cancel (contours);
+    g_thread_pool_free (contours->pool, FALSE, TRUE);
+
+    if (contours->ready_id)
+        g_source_remove (contours->ready_id);
+    ternary_contour_set_free (contours->pending);
+    g_mutex_clear (&contours->lock);
+    g_rw_lock_clear (&contours->data_lock);
+    g_free (contours);
+}
+
+/* Drops the work in flight and any pass not handed over yet. Returns
+ * once no worker reads the plot data any more, so the caller may change
+ * or free it afterwards; binning notices within a few thousand points. */
+void ternary_contours_cancel (TernaryContours *contours)
+{
+    g_atomic_int_inc (&contours->generation);
+
+    g_rw_lock_writer_lock (&contours->data_lock);
+    g_rw_lock_writer_unlock (&contours->data_lock);
+
+    g_mutex_lock (&contours->lock);
+    ternary_contour_set_free (contours->pending);
+    contours->pending = NULL;
+    g_mutex_unlock (&contours->lock);
+}
+
+/* Starts over for n closed compositions, which must stay unchanged until
+ * the next update or cancellation. */
+void ternary_contours_update (TernaryContours *contours, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, gdouble bandwidth)
+{
+    ContourJob *job;
+
+    g_return_if_fail (contours != NULL);
+    g_return_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL));
+
+    ternary_contours_cancel (contours);
+
+    job = g_new (ContourJob, 1);
+    job->generation = g_atomic_int_get (&contours->generation);
+    job->x = x;
+    job->y = y;
+    job->z = z;
+    job->fixed = NULL;
+    job->n = n;
+    job->bandwidth = bandwidth;
+    g_thread_pool_push (contours->pool, job, NULL);
+}
+
+/* The same over quantized points, under the same terms. */
+void ternary_contours_update_fixed (TernaryContours *contours,
+    const TernaryFixed *fixed, gdouble bandwidth)
+{
+    ContourJob *job;
+
+    g_return_if_fail (contours != NULL);
+    g_return_if_fail (fixed != NULL);
+
+    ternary_contours_cancel (contours);
+
+    job = g_new0 (ContourJob, 1);
+    job->generation = g_atomic_int_get (&contours->generation);
+    job->fixed = fixed;
+    job->n = fixed->n_points;
+    job->bandwidth = bandwidth;
+    g_thread_pool_push (contours->pool, job, NULL);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_CONTOURS_H__
+#define __TERNARY_PLOT_CONTOURS_H__
+
+#include <glib.h>
+#include <cairo.h>
+
+#include "ternaryplot-fixed.h"
+
+G_BEGIN_DECLS
+
+#define TERNARY_CONTOURS_N_LEVELS 4
+#define TERNARY_CONTOURS_RESOLUTION 256 /* finest lattice, nodes per side - 1 */
+
+/* Isolines of a Gaussian kernel density estimate, sampled on the
+ * triangular lattice that splits every side into resolution parts. The
+ * levels bound the densest regions holding 95, 75, 50 and 25 % of the
+ * points. Paths are in (x, y) coordinates and meant to be drawn through
+ * the plot transform. */
+typedef struct _TernaryContourSet TernaryContourSet;
+
+struct _TernaryContourSet
+{
+    guint resolution; /* lattice parts per side */
+    gdouble bandwidth; /* kernel standard deviation in sides */
+    gdouble fractions[TERNARY_CONTOURS_N_LEVELS]; /* enclosed mass */
+    gdouble levels[TERNARY_CONTOURS_N_LEVELS]; /* density of each isoline */
+    cairo_path_t *paths[TERNARY_CONTOURS_N_LEVELS]; /* outermost first */
+};
+
+TernaryContourSet *ternary_contour_set_new (const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, gdouble bandwidth,
+    guint resolution);
+void ternary_contour_set_free (TernaryContourSet *set);
+
+/* Background estimator. Every update cancels the work in flight and
+ * computes the contours again on a worker thread, on a coarse lattice
+ * first and then on finer ones, handing each pass to ready on the main
+ * loop as soon as it is done. */
+typedef struct _TernaryContours TernaryContours;
+
+/* Called on the main loop with a pass the callee now owns. */
+typedef void (*TernaryContoursReadyFunc) (TernaryContourSet *set,
+    gpointer data);
+
+TernaryContours *ternary_contours_new (TernaryContoursReadyFunc ready,
+    gpointer data);
+void ternary_contours_free (TernaryContours *contours);
+void ternary_contours_cancel (TernaryContours *contours);
+void ternary_contours_update (TernaryContours *contours, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, gdouble bandwidth);
+void ternary_contours_update_fixed (TernaryContours *contours,
+    const TernaryFixed *fixed, gdouble bandwidth);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,432 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "ternaryplot-csv.h"
+#include "ternaryplot-kernels.h"
+#include "ternaryplot-parallel.h"
+
+#define CSV_GRAIN (4 << 20) /* bytes parsed per worker at least */
+#define CSV_FIELD 64 /* longest number handed to g_ascii_strtod */
+#define CSV_MAX_DIGITS 19 /* significant digits that fit a guint64 */
+
+typedef struct _CsvJob CsvJob;
+
+struct _CsvJob
+{
+    const gchar *data;
+    gsize length;
+    gchar delimiter;
+    gsize *n_lines; /* per worker, lines found by the first pass */
+    gsize *first; /* per worker, first row it writes */
+    gsize *n_good, *n_malformed, *n_degenerate; /* per worker */
+    gdouble *x, *y, *z;
+};
+
+/* powers of ten that are exact doubles */
+static const gdouble csv_powers[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* start of the first line beginning at or after offset */
+static gsize csv_line_start (const gchar *data, gsize length, gsize offset)
+{
+    const gchar *newline;
+
+    if (offset == 0 || offset >= length)
+        return MIN (offset, length);
+    if (data[offset - 1] == '\n')
+        return offset;
+
+    newline = memchr (data + offset, '\n', length - offset);
+
+    return newline ? (gsize) (newline - data) + 1 : length;
+}
+
+/* the bytes [start, end) of the data whose lines a worker handles */
+static void csv_worker_lines (CsvJob *job, gsize start, gsize end,
+    const gchar **begin, const gchar **finish)
+{
+    *begin = job->data + csv_line_start (job->data, job->length, start);
+    *finish = job->data + csv_line_start (job->data, job->length, end);
+}
+
+static void csv_count_range (gsize start, gsize end, guint worker,
+    gpointer data)
+{
+    CsvJob *job = data;
+    const gchar *p, *finish;
+    gsize n = 0;
+
+    csv_worker_lines (job, start, end, &p, &finish);
+    while (p < finish)
+    {
+        const gchar *newline = memchr (p, '\n', finish - p);
+
+        n++;
+        p = newline ? newline + 1 : finish;
+    }
+
+    job->n_lines[worker] = n;
+}
+
+/* Parses a decimal number. Numbers with up to 19 significant digits and
+ * small exponents are exact in double arithmetic; anything else, NaN
+ * and infinities included, goes through g_ascii_strtod. Neither depends
+ * on the locale. */
+static gboolean csv_parse_double (const gchar **cursor, const gchar *end,
+    gdouble *value)
+{
+    const gchar *p = *cursor, *digits;
+    guint64 mantissa = 0;
+    gint n_digits = 0, exponent = 0;
+    gboolean negative = FALSE;
+
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    digits = p;
+    while (p < end && *p == '0')
+        p++;
+    for (; p < end && g_ascii_isdigit (*p); p++)
+    {
+        if (n_digits < CSV_MAX_DIGITS)
+            mantissa = 10 * mantissa + (*p - '0');
+        else
+            exponent++;
+        n_digits++;
+    }
+    if (p < end && *p == '.')
+    {
+        const gchar *point = p++;
+
+        if (mantissa == 0)
+            while (p < end && *p == '0')
+            {
+                exponent--;
+                p++;
+            }
+        for (; p < end && g_ascii_isdigit (*p); p++)
+        {
+            if (n_digits < CSV_MAX_DIGITS)
+            {
+                mantissa = 10 * mantissa + (*p - '0');
+                exponent--;
+            }
+            n_digits++;
+        }
+        if (p == point + 1 && point == digits)
+            return FALSE; /* a lone point */
+    }
+    else if (p == digits)
+    {
+        gchar field[CSV_FIELD];
+        gchar *parsed;
+        gsize length;
+
+        /* nan, inf and friends */
+        length = MIN ((gsize) (end - *cursor), CSV_FIELD - 1);
+        memcpy (field, *cursor, length);
+        field[length] = '\0';
+        *value = g_ascii_strtod (field, &parsed);
+        if (parsed == field)
+            return FALSE;
+        *cursor += parsed - field;
+        return TRUE;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const gchar *mark = p++;
+        gboolean minus = FALSE;
+        gint e = 0;
+
+        if (p < end && (*p == '-' || *p == '+'))
+            minus = *p++ == '-';
+        if (p < end && g_ascii_isdigit (*p))
+        {
+            for (; p < end && g_ascii_isdigit (*p); p++)
+                e = MIN (10 * e + (*p - '0'), 100000);
+            exponent += minus ? -e : e;
+        }
+        else
+            p = mark; /* not an exponent after all */
+    }
+
+    if (n_digits > CSV_MAX_DIGITS || mantissa > ((guint64) 1 << 53) ||
+        exponent < -22 || exponent > 22)
+    {
+        gchar field[CSV_FIELD];
+        gsize length = p - *cursor;
+
+        if (length >= CSV_FIELD)
+            return FALSE;
+        memcpy (field, *cursor, length);
+        field[length] = '\0';
+        *value = g_ascii_strtod (field, NULL);
+    }
+    else
+    {
+        *value = exponent < 0 ? mantissa / csv_powers[-exponent]
+                              : mantissa * csv_powers[exponent];
+        if (negative)
+            *value = -*value;
+    }
+
+    *cursor = p;
+
+    return TRUE;
+}
+
+/* spaces and quotes around a field, but not a tab delimiter */
+static inline const gchar *csv_skip_blanks (const gchar *p, const gchar *end)
+{
+    while (p < end && (*p == ' ' || *p == '"'))
+        p++;
+
+    return p;
+}
+
+/* the first three numbers of a line; the rest is ignored */
+static gboolean csv_parse_row (const gchar *p, const gchar *end,
+    gchar delimiter, gdouble *values)
+{
+    guint i;
+
+    for (i = 0; i < 3; i++)
+    {
+        p = csv_skip_blanks (p, end);
+        if (!csv_parse_double (&p, end, &values[i]))
+            return FALSE;
+        while (p < end && (*p == ' ' || *p == '"' || *p == '\r'))
+            p++;
+        if (i < 2)
+        {
+            if (p == end || *p != delimiter)
+                return FALSE;
+            p++;
+        }
+        else if (p < end && *p != delimiter)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static inline gboolean csv_is_blank (const gchar *p, const gchar *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+    return p == end || *p == '\r' || *p == '#';
+}
+
+/* Parses a worker's lines into its rows, closes them in one batch and
+ * drops the ones closure turned into NaN. */
+static void csv_parse_range (gsize start, gsize end, guint worker,
+    gpointer data)
+{
+    CsvJob *job = data;
+    const gchar *p, *finish;
+    gdouble *x, *y, *z;
+    gsize n = 0, good = 0, malformed = 0, i;
+
+    x = job->x + job->first[worker];
+    y = job->y + job->first[worker];
+    z = job->z + job->first[worker];
+
+    csv_worker_lines (job, start, end, &p, &finish);
+    while (p < finish)
+    {
+        const gchar *newline, *eol;
+        gdouble values[3];
+
+        newline = memchr (p, '\n', finish - p);
+        eol = newline ? newline : finish;
+
+        if (csv_is_blank (p, eol))
+            ;
+        else if (csv_parse_row (p, eol, job->delimiter, values))
+        {
+            x[n] = values[0];
+            y[n] = values[1];
+            z[n] = values[2];
+            n++;
+        }
+        else
+            malformed++;
+
+        p = newline ? newline + 1 : finish;
+    }
+
+    ternary_kernels_closure (x, y, z, x, y, z, n);
+
+    for (i = 0; i < n; i++)
+    {
+        /* a zero sum spreads NaN to all three, an infinite component
+         * only to itself, so one test on the sum covers both */
+        if (isnan (x[i] + y[i] + z[i]))
+            continue;
+        x[good] = x[i];
+        y[good] = y[i];
+        z[good] = z[i];
+        good++;
+    }
+
+    job->n_good[worker] = good;
+    job->n_malformed[worker] = malformed;
+    job->n_degenerate[worker] = n - good;
+}
+
+/* Looks at the first line for the delimiter and, if it does not start
+ * with a number, the vertex labels. Returns where the data starts. */
+static gsize csv_header (TernaryCsv *csv, const gchar *data, gsize length,
+    gchar *delimiter)
+{
+    const gchar *newline, *eol, *p;
+    gdouble value;
+    guint i;
+
+    newline = memchr (data, '\n', length);
+    eol = newline ? newline : data + length;
+
+    *delimiter = memchr (data, '\t', eol - data) ? '\t' : ',';
+
+    /* a header unless the first field is a number */
+    if (csv_is_blank (data, eol))
+        return 0;
+    p = csv_skip_blanks (data, eol);
+    if (csv_parse_double (&p, eol, &value))
+    {
+        p = csv_skip_blanks (p, eol);
+        if (p == eol || *p == *delimiter || *p == '\r')
+            return 0;
+    }
+
+    p = data;
+    for (i = 0; i < 3 && p <= eol; i++)
+    {
+        const gchar *field_end, *q;
+
+        field_end = memchr (p, *delimiter, eol - p);
+        if (field_end == NULL)
+            field_end = eol;
+
+        q = field_end;
+        p = csv_skip_blanks (p, field_end);
+        while (q > p && (q[-1] == ' ' || q[-1] == '"' || q[-1] == '\r'))
+            q--;
+        if (q > p)
+            csv->labels[i] = g_strndup (p, q - p);
+        p = field_end + 1;
+    }
+
+    return newline ? (gsize) (newline - data) + 1 : length;
+}
+
+/* Reads a CSV or TSV file on all processors. The input is split at line
+ * boundaries; a first pass counts the lines of every worker so a second
+ * one can parse straight into the final columns. */
+TernaryCsv *ternary_csv_load (const gchar *filename, GError **error)
+{
+    TernaryCsv *csv;
+    GMappedFile *file;
+    CsvJob job;
+    gsize offset, capacity, n, i;
+    guint n_workers, w;
+
+    g_return_val_if_fail (filename != NULL, NULL);
+
+    file = g_mapped_file_new (filename, FALSE, error);
+    if (file == NULL)
+        return NULL;
+
+    csv = g_new0 (TernaryCsv, 1);
+
+    job.data = g_mapped_file_get_contents (file);
+    job.length = g_mapped_file_get_length (file);
+    offset = csv_header (csv, job.data, job.length, &job.delimiter);
+    job.data += offset;
+    job.length -= offset;
+
+    n_workers = ternary_parallel_n_workers (job.length, CSV_GRAIN);
+    job.n_lines = g_new0 (gsize, n_workers);
+    job.first = g_new0 (gsize, n_workers);
+    job.n_good = g_new0 (gsize, n_workers);
+    job.n_malformed = g_new0 (gsize, n_workers);
+    job.n_degenerate = g_new0 (gsize, n_workers);
+
+    ternary_parallel_for (job.length, CSV_GRAIN, csv_count_range, &job);
+
+    capacity = 0;
+    for (w = 0; w < n_workers; w++)
+    {
+        job.first[w] = capacity;
+        capacity += job.n_lines[w];
+    }
+
+    job.x = g_new (gdouble, MAX (3 * capacity, 1));
+    job.y = job.x + capacity;
+    job.z = job.y + capacity;
+    ternary_parallel_for (job.length, CSV_GRAIN, csv_parse_range, &job);
+
+    /* close the gaps left by skipped lines */
+    n = 0;
+    for (w = 0; w < n_workers; w++)
+    {
+        i = job.first[w];
+        memmove (job.x + n, job.x + i, job.n_good[w] * sizeof (gdouble));
+        memmove (job.y + n, job.y + i, job.n_good[w] * sizeof (gdouble));
+        memmove (job.z + n, job.z + i, job.n_good[w] * sizeof (gdouble));
+        n += job.n_good[w];
+        csv->n_malformed += job.n_malformed[w];
+        csv->n_degenerate += job.n_degenerate[w];
+    }
+
+    csv->n_points = n;
+    csv->x = job.x;
+    csv->y = job.y;
+    csv->z = job.z;
+
+    g_free (job.n_lines);
+    g_free (job.first);
+    g_free (job.n_good);
+    g_free (job.n_malformed);
+    g_free (job.n_degenerate);
+    g_mapped_file_unref (file);
+
+    return csv;
+}
+
+void ternary_csv_free (TernaryCsv *csv)
+{
+    if (csv == NULL)
+        return;
+
+    g_free (csv->x);
+    g_free (csv->labels[0]);
+    g_free (csv->labels[1]);
+    g_free (csv->labels[2]);
+    g_free (csv);
+}
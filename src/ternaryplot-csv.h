@@ -0,0 +1,47 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_CSV_H__
+#define __TERNARY_PLOT_CSV_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Compositions read from comma or tab separated text. The first three
+ * fields of every row are a composition, further fields are ignored.
+ * An optional header row names the vertices; blank lines and lines
+ * starting with '#' are skipped. */
+typedef struct _TernaryCsv TernaryCsv;
+
+struct _TernaryCsv
+{
+    gsize n_points;
+    gdouble *x, *y, *z; /* closed columns, one allocation starting at x */
+    gchar *labels[3]; /* header names or NULL */
+    gsize n_malformed; /* rows without three numbers, skipped */
+    gsize n_degenerate; /* rows with a zero sum, NaN or infinity, skipped */
+};
+
+TernaryCsv *ternary_csv_load (const gchar *filename, GError **error);
+void ternary_csv_free (TernaryCsv *csv);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,455 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "ternaryplot.h"
+#include "ternaryplot-datafile.h"
+#include "ternaryplot-kernels.h"
+
+#define DATA_MAGIC 0x53445054 /* "TPDS" little-endian */
+#define DATA_VERSION 2 /* 1 stored pyramids without their order */
+#define DATA_HEADER 64
+#define DATA_ALIGN 64 /* column alignment, a cache line */
+#define DATA_CLOSED 1 /* flag: rows sum to one */
+#define DATA_CHUNK 65536 /* rows closed per write */
+
+/* header layout, as little-endian words */
+typedef struct _DataHeader DataHeader;
+
+struct _DataHeader
+{
+    guint32 magic;
+    guint32 version;
+    guint32 flags;
+    guint32 reserved;
+    guint64 n_points;
+    guint64 columns_offset;
+    guint64 labels_offset, labels_size;
+    guint64 index_offset, index_size;
+};
+
+G_STATIC_ASSERT (sizeof (DataHeader) == DATA_HEADER);
+
+static inline guint64 align_up (guint64 offset, guint64 align)
+{
+    return (offset + align - 1) / align * align;
+}
+
+static gboolean data_invalid (const gchar *filename, const gchar *reason,
+    GError **error)
+{
+    g_set_error (error, TERNARY_PLOT_ERROR, TERNARY_PLOT_ERROR_INVALID,
+                 "'%s' is not a ternary data set: %s", filename, reason);
+    return FALSE;
+}
+
+/* splits the labels block into its strings */
+static gboolean data_labels (TernaryDataFile *data, const gchar *block,
+    gsize size)
+{
+    const gchar *end = block + size;
+    guint i;
+
+    for (i = 0; i < 3; i++)
+    {
+        const gchar *nul = memchr (block, '\0', end - block);
+
+        if (nul == NULL || !g_utf8_validate (block, nul - block, NULL))
+            return FALSE;
+        data->labels[i] = *block ? block : NULL;
+        block = nul + 1;
+    }
+
+    if (block < end)
+    {
+        if (end[-1] != '\0' || !g_utf8_validate (block, end - block - 1, NULL))
+            return FALSE;
+        data->metadata = block;
+    }
+
+    return TRUE;
+}
+
+/* Maps a data set. Opening only checks the header, the columns are
+ * paged in by whoever reads them, so the cost does not depend on the
+ * size of the file. */
+TernaryDataFile *ternary_data_file_open (const gchar *filename,
+    GError **error)
+{
+    TernaryDataFile *data;
+    GMappedFile *file;
+    const gchar *contents;
+    DataHeader header;
+    guint64 length, n;
+
+    g_return_val_if_fail (filename != NULL, NULL);
+
+    file = g_mapped_file_new (filename, FALSE, error);
+    if (file == NULL)
+        return NULL;
+
+    contents = g_mapped_file_get_contents (file);
+    length = g_mapped_file_get_length (file);
+
+    if (length < DATA_HEADER)
+    {
+        data_invalid (filename, "header is truncated", error);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    memcpy (&header, contents, sizeof (header));
+    header.magic = GUINT32_FROM_LE (header.magic);
+    header.version = GUINT32_FROM_LE (header.version);
+    header.flags = GUINT32_FROM_LE (header.flags);
+    n = GUINT64_FROM_LE (header.n_points);
+    header.columns_offset = GUINT64_FROM_LE (header.columns_offset);
+    header.labels_offset = GUINT64_FROM_LE (header.labels_offset);
+    header.labels_size = GUINT64_FROM_LE (header.labels_size);
+    header.index_offset = GUINT64_FROM_LE (header.index_offset);
+    header.index_size = GUINT64_FROM_LE (header.index_size);
+
+    if (header.magic != DATA_MAGIC || header.version < 1 ||
+        header.version > DATA_VERSION ||
+        (header.flags & ~DATA_CLOSED))
+    {
+        data_invalid (filename, "unknown format or version", error);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    /* every section must lie inside the file, compared without
+     * overflowing */
+    if (header.columns_offset % sizeof (gdouble) ||
+        header.columns_offset > length ||
+        n > (length - header.columns_offset) / (3 * sizeof (gdouble)) ||
+        header.labels_offset > length ||
+        header.labels_size > length - header.labels_offset ||
+        header.index_offset % sizeof (guint32) ||
+        header.index_offset > length ||
+        header.index_size > length - header.index_offset)
+    {
+        data_invalid (filename, "sections are out of bounds", error);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    data = g_new0 (TernaryDataFile, 1);
+    data->ref_count = 1;
+    data->file = file;
+    data->n_points = n;
+    data->closed = (header.flags & DATA_CLOSED) != 0;
+    data->index_offset = header.index_offset;
+    data->index_size = header.index_size;
+
+    if (header.labels_size > 0 &&
+        !data_labels (data, contents + header.labels_offset,
+                      header.labels_size))
+    {
+        data_invalid (filename, "labels are not UTF-8 strings", error);
+        ternary_data_file_unref (data);
+        return NULL;
+    }
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+    data->x = (const gdouble *) (contents + header.columns_offset);
+#else
+    {
+        const guint64 *words;
+        guint64 *swapped;
+        gsize i;
+
+        /* nothing to map in place, one conversion pass instead */
+        words = (const guint64 *) (contents + header.columns_offset);
+        swapped = (guint64 *) g_new (gdouble, MAX (3 * n, 1));
+        for (i = 0; i < 3 * n; i++)
+            swapped[i] = GUINT64_FROM_LE (words[i]);
+        data->swapped = (gdouble *) swapped;
+        data->x = data->swapped;
+    }
+#endif
+    data->y = data->x + n;
+    data->z = data->y + n;
+
+    return data;
+}
+
+TernaryDataFile *ternary_data_file_ref (TernaryDataFile *data)
+{
+    g_return_val_if_fail (data != NULL, NULL);
+
+    g_atomic_int_inc (&data->ref_count);
+
+    return data;
+}
+
+void ternary_data_file_unref (TernaryDataFile *data)
+{
+    g_return_if_fail (data != NULL);
+
+    if (!g_atomic_int_dec_and_test (&data->ref_count))
+        return;
+
+    g_free (data->swapped);
+    g_mapped_file_unref (data->file);
+    g_free (data);
+}
+
+/* The precomputed pyramid, read in place, or NULL if the file has none
+ * or it is invalid, in which case error is set. */
+TernaryPyramid *ternary_data_file_new_pyramid (TernaryDataFile *data,
+    GError **error)
+{
+    TernaryPyramid *pyramid;
+
+    g_return_val_if_fail (data != NULL, NULL);
+
+    if (data->index_size == 0)
+        return NULL;
+
+    pyramid = ternary_pyramid_new_from_mapping (data->file,
+        data->index_offset, data->index_size, error);
+    if (pyramid != NULL && pyramid->n_points != data->n_points)
+    {
+        g_set_error (error, TERNARY_PLOT_ERROR, TERNARY_PLOT_ERROR_INVALID,
+                     "Index was built for %" G_GUINT64_FORMAT
+                     " points, not %" G_GSIZE_FORMAT,
+                     pyramid->n_points, data->n_points);
+        ternary_pyramid_free (pyramid);
+        return NULL;
+    }
+
+    return pyramid;
+}
+
+/* sets error from errno, as "Could not <what> '<filename>'" */
+static gboolean data_failed (const gchar *what, const gchar *filename,
+    GError **error)
+{
+    gint saved_errno = errno;
+
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                 "Could not %s '%s': %s", what, filename,
+                 g_strerror (saved_errno));
+
+    return FALSE;
+}
+
+static gboolean data_write (FILE *stream, gconstpointer buffer, gsize size,
+    const gchar *filename, GError **error)
+{
+    if (size == 0 || fwrite (buffer, size, 1, stream) == 1)
+        return TRUE;
+
+    return data_failed ("write", filename, error);
+}
+
+/* zeroes up to the next section */
+static gboolean data_pad (FILE *stream, guint64 *offset, guint64 to,
+    const gchar *filename, GError **error)
+{
+    static const gchar zeros[DATA_ALIGN] = { 0 };
+
+    g_assert (to - *offset <= DATA_ALIGN);
+
+    if (!data_write (stream, zeros, to - *offset, filename, error))
+        return FALSE;
+    *offset = to;
+
+    return TRUE;
+}
+
+#ifdef G_OS_WIN32
+#define data_seek _fseeki64
+#else
+#define data_seek fseeko
+#endif
+
+/* closes the columns chunk by chunk, each chunk once, and writes its
+ * three columns at their places in the column block at offset */
+static gboolean data_write_columns (FILE *stream, guint64 offset,
+    const gdouble *x, const gdouble *y, const gdouble *z, gsize n,
+    const gchar *filename, GError **error)
+{
+    gdouble *buffer;
+    gsize start;
+    guint column;
+    gboolean ok = TRUE;
+
+    buffer = g_new (gdouble, 3 * DATA_CHUNK);
+    for (start = 0; ok && start < n; start += DATA_CHUNK)
+    {
+        gsize count = MIN (n - start, DATA_CHUNK);
+
+        ternary_kernels_closure (x + start, y + start, z + start, buffer,
+            buffer + DATA_CHUNK, buffer + 2 * DATA_CHUNK, count);
+#if G_BYTE_ORDER != G_LITTLE_ENDIAN
+        {
+            guint64 *words = (guint64 *) buffer;
+            gsize i;
+
+            for (column = 0; column < 3; column++)
+                for (i = 0; i < count; i++)
+                    words[column * DATA_CHUNK + i] =
+                        GUINT64_TO_LE (words[column * DATA_CHUNK + i]);
+        }
+#endif
+        for (column = 0; ok && column < 3; column++)
+        {
+            guint64 at = offset + ((guint64) column * n + start) *
+                         sizeof (gdouble);
+
+            if (data_seek (stream, at, SEEK_SET) != 0)
+                ok = data_failed ("write", filename, error);
+            else
+                ok = data_write (stream, buffer + column * DATA_CHUNK,
+                                 count * sizeof (gdouble), filename, error);
+        }
+    }
+    g_free (buffer);
+
+    /* back to the end of the block */
+    if (ok && n > 0 &&
+        data_seek (stream, offset + 3 * (guint64) n * sizeof (gdouble),
+                   SEEK_SET) != 0)
+        ok = data_failed ("write", filename, error);
+
+    return ok;
+}
+
+/* Writes n compositions, closed on the way, with optional labels (an
+ * array of three, any of them NULL), metadata text and a pyramid built
+ * from the same points. The file is written next to filename under a
+ * temporary name and renamed over it once complete, so a failed write
+ * leaves the old file alone, and the columns may be a mapping of that
+ * very file. */
+gboolean ternary_data_file_write (const gchar *filename, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, const gchar *const *labels,
+    const gchar *metadata, TernaryPyramid *pyramid, GError **error)
+{
+    DataHeader header;
+    GString *block;
+    guint32 *index = NULL;
+    gsize index_size = 0;
+    guint64 offset;
+    gchar *tmpname;
+    FILE *stream;
+    gboolean ok;
+    gint fd;
+    guint i;
+
+    g_return_val_if_fail (filename != NULL, FALSE);
+    g_return_val_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL),
+                          FALSE);
+    g_return_val_if_fail (pyramid == NULL || pyramid->n_points == n, FALSE);
+
+    block = g_string_new (NULL);
+    if (labels != NULL || metadata != NULL)
+    {
+        for (i = 0; i < 3; i++)
+            g_string_append_len (block, labels && labels[i] ? labels[i] : "",
+                                 labels && labels[i] ? strlen (labels[i]) + 1 : 1);
+        if (metadata != NULL)
+            g_string_append_len (block, metadata, strlen (metadata) + 1);
+    }
+
+    if (pyramid != NULL)
+        index = ternary_pyramid_serialize (pyramid, &index_size);
+
+    memset (&header, 0, sizeof (header));
+    header.magic = GUINT32_TO_LE (DATA_MAGIC);
+    header.version = GUINT32_TO_LE (DATA_VERSION);
+    header.flags = GUINT32_TO_LE (DATA_CLOSED);
+    header.n_points = GUINT64_TO_LE (n);
+    header.columns_offset = GUINT64_TO_LE (align_up (DATA_HEADER, DATA_ALIGN));
+    offset = align_up (DATA_HEADER, DATA_ALIGN) + 3 * (guint64) n * sizeof (gdouble);
+    if (block->len > 0)
+    {
+        header.labels_offset = GUINT64_TO_LE (offset);
+        header.labels_size = GUINT64_TO_LE (block->len);
+        offset += block->len;
+    }
+    if (index != NULL)
+    {
+        offset = align_up (offset, sizeof (guint64));
+        header.index_offset = GUINT64_TO_LE (offset);
+        header.index_size = GUINT64_TO_LE (index_size);
+    }
+
+    tmpname = g_strconcat (filename, ".XXXXXX", NULL);
+    fd = g_mkstemp_full (tmpname, O_WRONLY, 0666);
+    stream = fd >= 0 ? fdopen (fd, "wb") : NULL;
+    if (stream == NULL)
+    {
+        data_failed ("create", tmpname, error);
+        if (fd >= 0)
+        {
+            g_close (fd, NULL);
+            g_unlink (tmpname);
+        }
+        g_free (tmpname);
+        g_string_free (block, TRUE);
+        g_free (index);
+        return FALSE;
+    }
+
+    offset = sizeof (header);
+    ok = data_write (stream, &header, sizeof (header), filename, error) &&
+         data_pad (stream, &offset, align_up (offset, DATA_ALIGN),
+                   filename, error);
+    if (ok)
+        ok = data_write_columns (stream, offset, x, y, z, n, filename, error);
+    offset += 3 * (guint64) n * sizeof (gdouble);
+    if (ok)
+        ok = data_write (stream, block->str, block->len, filename, error);
+    offset += block->len;
+    if (ok && index != NULL)
+        ok = data_pad (stream, &offset, align_up (offset, sizeof (guint64)),
+                       filename, error) &&
+             data_write (stream, index, index_size, filename, error);
+
+    /* on disk before it replaces anything */
+    if (ok && fflush (stream) != 0)
+        ok = data_failed ("write", filename, error);
+#ifdef G_OS_UNIX
+    if (ok && fsync (fileno (stream)) != 0)
+        ok = data_failed ("write", filename, error);
+#endif
+    if (fclose (stream) != 0 && ok)
+        ok = data_failed ("write", filename, error);
+    if (ok && g_rename (tmpname, filename) != 0)
+        ok = data_failed ("replace", filename, error);
+    if (!ok)
+        g_unlink (tmpname);
+
+    g_free (tmpname);
+    g_string_free (block, TRUE);
+    g_free (index);
+
+    return ok;
+}
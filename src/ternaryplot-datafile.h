@@ -0,0 +1,65 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_DATAFILE_H__
+#define __TERNARY_PLOT_DATAFILE_H__
+
+#include <glib.h>
+
+#include "ternaryplot-pyramid.h"
+
+G_BEGIN_DECLS
+
+/* Binary compositional data set, read in place through a memory mapping.
+ * All fields are little-endian:
+ *
+ *   header   64 bytes, see ternaryplot-datafile.c
+ *   columns  x, y and z, n_points doubles each, 64 byte aligned
+ *   labels   optional, three NUL-terminated vertex labels followed by
+ *            NUL-terminated free-form metadata text
+ *   index    optional, a serialized TernaryPyramid of the columns
+ */
+typedef struct _TernaryDataFile TernaryDataFile;
+
+struct _TernaryDataFile
+{
+    gint ref_count;
+    GMappedFile *file;
+    gsize n_points;
+    const gdouble *x, *y, *z; /* columns, in the mapping where possible */
+    gboolean closed; /* rows already sum to one */
+    const gchar *labels[3]; /* vertex labels or NULL */
+    const gchar *metadata; /* free-form text or NULL */
+    gsize index_offset, index_size; /* precomputed pyramid, 0 if none */
+    gdouble *swapped; /* host order copy on big-endian machines */
+};
+
+TernaryDataFile *ternary_data_file_open (const gchar *filename,
+    GError **error);
+TernaryDataFile *ternary_data_file_ref (TernaryDataFile *data);
+void ternary_data_file_unref (TernaryDataFile *data);
+TernaryPyramid *ternary_data_file_new_pyramid (TernaryDataFile *data,
+    GError **error);
+gboolean ternary_data_file_write (const gchar *filename, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, const gchar *const *labels,
+    const gchar *metadata, TernaryPyramid *pyramid, GError **error);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,506 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib-object.h>
+#include <math.h>
+
+#include "ternaryplot-dataset.h"
+#include "ternaryplot-kernels.h"
+
+#define DATASET_CHUNK 1024 /* quantized points decoded at a time */
+#define DATASET_INDEX (1 << 0) /* building flags */
+#define DATASET_PYRAMID (1 << 1)
+
+#define TERNARY_DATASET_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
+                                          TERNARY_TYPE_DATASET, TernaryDatasetPrivate))
+
+typedef struct _TernaryDatasetPrivate TernaryDatasetPrivate;
+
+struct _TernaryDatasetPrivate
+{
+    const gdouble *x, *y, *z; /* closed columns */
+    TernaryFixed *fixed; /* or quantized points instead */
+    gsize n_points;
+    GDestroyNotify destroy; /* releases the columns */
+    gpointer data; /* owner of the columns */
+    GMutex lock; /* guards everything below */
+    GCond built; /* broadcast when a build finishes */
+    guint building; /* DATASET_INDEX, DATASET_PYRAMID being built */
+    GSList *binning; /* resolutions of the histograms being binned */
+    TernaryIndex *index; /* nearest point lookup */
+    TernaryPyramid *pyramid; /* level of detail, also read without the lock */
+    GSList *densities; /* TernaryDensity, one per resolution asked for */
+    gboolean has_summary; /* bounds and mean are computed */
+    gdouble min[3], max[3], mean[3]; /* of the rows that are not NaN */
+};
+
+G_DEFINE_TYPE (TernaryDataset, ternary_dataset, G_TYPE_OBJECT);
+
+enum {
+    PROP_0,
+    PROP_N_POINTS
+};
+
+static void ternary_dataset_finalize (GObject *object);
+static void ternary_dataset_get_property (GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec);
+
+static void ternary_dataset_class_init (TernaryDatasetClass *class)
+{
+    GObjectClass *obj_class;
+
+    obj_class = G_OBJECT_CLASS (class);
+    obj_class->finalize = ternary_dataset_finalize;
+    obj_class->get_property = ternary_dataset_get_property;
+
+    g_object_class_install_property (obj_class,
+        PROP_N_POINTS,
+        g_param_spec_uint64 ("n-points",
+            "Number of points",
+            "Number of rows in the columns",
+            0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
+    g_type_class_add_private (obj_class, sizeof (TernaryDatasetPrivate));
+}
+
+static void ternary_dataset_init (TernaryDataset *dataset)
+{
+    TernaryDatasetPrivate *priv;
+
+    priv = TERNARY_DATASET_GET_PRIVATE (dataset);
+    g_mutex_init (&priv->lock);
+    g_cond_init (&priv->built);
+}
+
+static void ternary_dataset_finalize (GObject *object)
+{
+    TernaryDatasetPrivate *priv;
+    GSList *l;
+
+    priv = TERNARY_DATASET_GET_PRIVATE (object);
+
+    ternary_fixed_free (priv->fixed);
+    ternary_index_free (priv->index);
+    ternary_pyramid_free (priv->pyramid);
+    for (l = priv->densities; l; l = l->next)
+        ternary_density_free (l->data);
+    g_slist_free (priv->densities);
+    if (priv->destroy)
+        priv->destroy (priv->data);
+    g_cond_clear (&priv->built);
+    g_mutex_clear (&priv->lock);
+
+    G_OBJECT_CLASS (ternary_dataset_parent_class)->finalize (object);
+}
+
+static void ternary_dataset_get_property (GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec)
+{
+    TernaryDataset *dataset = TERNARY_DATASET (object);
+
+    switch (prop_id)
+    {
+    case PROP_N_POINTS:
+        g_value_set_uint64 (value, ternary_dataset_get_n_points (dataset));
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+/* Copies n points, closed to x + y + z = 1 like ternary_plot_set_points
+ * would, into a new data set. */
+TernaryDataset *ternary_dataset_new (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n)
+{
+    gdouble *columns;
+
+    g_return_val_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL), NULL);
+
+    columns = g_new (gdouble, 3 * n);
+    ternary_kernels_closure (x, y, z, columns, columns + n, columns + 2 * n, n);
+
+    return ternary_dataset_new_full (columns, columns + n, columns + 2 * n, n,
+                                     g_free, columns);
+}
+
+/* Wraps the caller's columns, which must already be closed and stay
+ * untouched until destroy is called with data. */
+TernaryDataset *ternary_dataset_new_full (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n, GDestroyNotify destroy, gpointer data)
+{
+    TernaryDataset *dataset;
+    TernaryDatasetPrivate *priv;
+
+    g_return_val_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL), NULL);
+
+    dataset = g_object_new (TERNARY_TYPE_DATASET, NULL);
+    priv = TERNARY_DATASET_GET_PRIVATE (dataset);
+    priv->x = x;
+    priv->y = y;
+    priv->z = z;
+    priv->n_points = n;
+    priv->destroy = destroy;
+    priv->data = data;
+
+    return dataset;
+}
+
+/* Closes n points and keeps them quantized to bits, 16 or 32, per
+ * component; see TernaryFixed for the precision. There are no columns
+ * then, and everything derived decodes the points as it goes. */
+TernaryDataset *ternary_dataset_new_fixed (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n, guint bits)
+{
+    TernaryDataset *dataset;
+    TernaryDatasetPrivate *priv;
+
+    g_return_val_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL), NULL);
+    g_return_val_if_fail (bits == 16 || bits == 32, NULL);
+
+    dataset = g_object_new (TERNARY_TYPE_DATASET, NULL);
+    priv = TERNARY_DATASET_GET_PRIVATE (dataset);
+    priv->fixed = ternary_fixed_new (x, y, z, n, bits);
+    priv->n_points = n;
+
+    return dataset;
+}
+
+gsize ternary_dataset_get_n_points (TernaryDataset *dataset)
+{
+    g_return_val_if_fail (TERNARY_IS_DATASET (dataset), 0);
+    return TERNARY_DATASET_GET_PRIVATE (dataset)->n_points;
+}
+
+void ternary_dataset_get_columns (TernaryDataset *dataset,
+    const gdouble **x, const gdouble **y, const gdouble **z)
+{
+    TernaryDatasetPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_DATASET (dataset));
+    priv = TERNARY_DATASET_GET_PRIVATE (dataset);
+
+    if (x)
+        *x = priv->x;
+    if (y)
+        *y = priv->y;
+    if (z)
+        *z = priv->z;
+}
+
+/* the quantized points, NULL when the data set has columns */
+const TernaryFixed *ternary_dataset_get_fixed (TernaryDataset *dataset)
+{
+    g_return_val_if_fail (TERNARY_IS_DATASET (dataset), NULL);
+    return TERNARY_DATASET_GET_PRIVATE (dataset)->fixed;
+}
+
+/* Everything derived is built on the first call that needs it, outside
+ * the lock so that the others are not held up. A build is flagged while
+ * it runs, and calls wanting the same wait for it on built instead of
+ * starting their own. */
+
+/* Nearest point lookup, built on the first call. */
+TernaryIndex *ternary_dataset_get_index (TernaryDataset *dataset)
+{
+    TernaryDatasetPrivate *priv;
+    TernaryIndex *index;
+
+    g_return_val_if_fail (TERNARY_IS_DATASET (dataset), NULL);
+    priv = TERNARY_DATASET_GET_PRIVATE (dataset);
+
+    g_mutex_lock (&priv->lock);
+    while (priv->index == NULL && (priv->building & DATASET_INDEX))
+        g_cond_wait (&priv->built, &priv->lock);
+    if (priv->index == NULL)
+    {
+        priv->building |= DATASET_INDEX;
+        g_mutex_unlock (&priv->lock);
+
+        if (priv->fixed)
+            index = ternary_index_new_fixed (priv->fixed);
+        else
+            index = ternary_index_new (priv->x, priv->y, priv->n_points);
+
+        g_mutex_lock (&priv->lock);
+        priv->index = index;
+        priv->building &= ~DATASET_INDEX;
+        g_cond_broadcast (&priv->built);
+    }
+    index = priv->index;
+    g_mutex_unlock (&priv->lock);
+
+    return index;
+}
+
+/* Level of detail pyramid, built on the first call. */
+TernaryPyramid *ternary_dataset_get_pyramid (TernaryDataset *dataset)
+{
+    TernaryDatasetPrivate *priv;
+    TernaryPyramid *pyramid;
+    guint depth;
+
+    g_return_val_if_fail (TERNARY_IS_DATASET (dataset), NULL);
+    priv = TERNARY_DATASET_GET_PRIVATE (dataset);
+
+    g_mutex_lock (&priv->lock);
+    while (priv->pyramid == NULL && (priv->building & DATASET_PYRAMID))
+        g_cond_wait (&priv->built, &priv->lock);
+    if (priv->pyramid == NULL)
+    {
+        priv->building |= DATASET_PYRAMID;
+        g_mutex_unlock (&priv->lock);
+
+        depth = ternary_pyramid_depth_for (priv->n_points);
+        if (priv->fixed)
+            pyramid = ternary_pyramid_new_fixed (priv->fixed, depth);
+        else
+            pyramid = ternary_pyramid_new (priv->x, priv->y, priv->z,
+                                           priv->n_points, depth);
+
+        g_mutex_lock (&priv->lock);
+        g_atomic_pointer_set (&priv->pyramid, pyramid);
+        priv->building &= ~DATASET_PYRAMID;
+        g_cond_broadcast (&priv->built);
+    }
+    pyramid = priv->pyramid;
+    g_mutex_unlock (&priv->lock);
+
+    return pyramid;
+}
+
+/* The pyramid if one was built already, NULL otherwise. Never waits, so
+ * it may be called from expose while a worker builds the pyramid. */
+TernaryPyramid *ternary_dataset_peek_pyramid (TernaryDataset *dataset)
+{
+    g_return_val_if_fail (TERNARY_IS_DATASET (dataset), NULL);
+    return g_atomic_pointer_get (&TERNARY_DATASET_GET_PRIVATE (dataset)->pyramid);
+}
+
+static void density_add_fixed (TernaryDensity *density,
+    const TernaryFixed *fixed)
+{
+    gdouble x[DATASET_CHUNK], y[DATASET_CHUNK], z[DATASET_CHUNK];
+    gsize start, n;
+
+    for (start = 0; start < fixed->n_points; start += n)
+    {
+        n = MIN (fixed->n_points - start, DATASET_CHUNK);
+        ternary_fixed_decode (fixed, start, n, x, y, z);
+        ternary_density_add (density, x, y, z, n);
+    }
+}
+
+/* histogram already binned at resolution, under the lock */
+static TernaryDensity *find_density (TernaryDatasetPrivate *priv,
+    guint resolution)
+{
+    GSList *l;
+
+    for (l = priv->densities; l; l = l->next)
+        if (((TernaryDensity *) l->data)->resolution == resolution)
+            return l->data;
+
+    return NULL;
+}
+
+/* Histogram with resolution cells per side, binned on the first call. */
+TernaryDensity *ternary_dataset_get_density (TernaryDataset *dataset,
+    guint resolution)
+{
+    TernaryDatasetPrivate *priv;
+    TernaryDensity *density;
+    gpointer key = GUINT_TO_POINTER (resolution);
+
+    g_return_val_if_fail (TERNARY_IS_DATASET (dataset), NULL);
+    g_return_val_if_fail (resolution > 0, NULL);
+    priv = TERNARY_DATASET_GET_PRIVATE (dataset);
+
+    g_mutex_lock (&priv->lock);
+    while ((density = find_density (priv, resolution)) == NULL &&
+           g_slist_find (priv->binning, key))
+        g_cond_wait (&priv->built, &priv->lock);
+    if (density == NULL)
+    {
+        priv->binning = g_slist_prepend (priv->binning, key);
+        g_mutex_unlock (&priv->lock);
+
+        density = ternary_density_new (resolution);
+        if (priv->fixed)
+            density_add_fixed (density, priv->fixed);
+        else
+            ternary_density_add (density, priv->x, priv->y, priv->z,
+                                 priv->n_points);
+
+        g_mutex_lock (&priv->lock);
+        priv->densities = g_slist_prepend (priv->densities, density);
+        priv->binning = g_slist_remove (priv->binning, key);
+        g_cond_broadcast (&priv->built);
+    }
+    g_mutex_unlock (&priv->lock);
+
+    return density;
+}
+
+/* The same from quantized points. The sums are kept in lattice steps,
+ * which is exact, so the mean does not depend on the order of the
+ * points. */
+static void summarize_fixed (TernaryDatasetPrivate *priv)
+{
+    const TernaryFixed *fixed = priv->fixed;
+    guint64 min[3], max[3];
+    guint64 sum[2] = { 0, 0 };
+    gsize i, n = 0;
+    guint k;
+
+    for (k = 0; k < 3; k++)
+    {
+        min[k] = fixed->scale;
+        max[k] = 0;
+    }
+
+    for (i = 0; i < fixed->n_points; i++)
+    {
+        guint64 v[3];
+
+        if (fixed->bits == 16)
+        {
+            v[0] = ((const guint16 *) fixed->a)[i];
+            v[1] = ((const guint16 *) fixed->b)[i];
+        }
+        else
+        {
+            v[0] = ((const guint32 *) fixed->a)[i];
+            v[1] = ((const guint32 *) fixed->b)[i];
+        }
+        if (v[0] + v[1] > fixed->scale)
+            continue;
+        v[2] = fixed->scale - v[0] - v[1];
+
+        for (k = 0; k < 3; k++)
+        {
+            min[k] = MIN (min[k], v[k]);
+            max[k] = MAX (max[k], v[k]);
+        }
+        sum[0] += v[0];
+        sum[1] += v[1];
+        n++;
+    }
+
+    for (k = 0; k < 3; k++)
+    {
+        priv->min[k] = (gdouble) min[k] / fixed->scale;
+        priv->max[k] = (gdouble) max[k] / fixed->scale;
+    }
+    if (n > 0)
+    {
+        /* z by difference, so the mean is closed too */
+        priv->mean[0] = (gdouble) sum[0] / fixed->scale / n;
+        priv->mean[1] = (gdouble) sum[1] / fixed->scale / n;
+        priv->mean[2] = (gdouble) ((guint64) n * fixed->scale - sum[0] -
+                                   sum[1]) / fixed->scale / n;
+    }
+    else
+        priv->mean[0] = priv->mean[1] = priv->mean[2] = NAN;
+}
+
+/* one pass for the bounds and the mean, under the lock */
+static void summarize (TernaryDatasetPrivate *priv)
+{
+    const gdouble *columns[3] = { priv->x, priv->y, priv->z };
+    gdouble sum[3] = { 0.0, 0.0, 0.0 };
+    gsize i, n = 0;
+    guint k;
+
+    if (priv->has_summary)
+        return;
+    if (priv->fixed)
+    {
+        summarize_fixed (priv);
+        priv->has_summary = TRUE;
+        return;
+    }
+
+    for (k = 0; k < 3; k++)
+    {
+        priv->min[k] = 1.0;
+        priv->max[k] = 0.0;
+    }
+
+    for (i = 0; i < priv->n_points; i++)
+    {
+        /* rows that failed closure, NaN in one column or all */
+        if (isnan (priv->x[i] + priv->y[i] + priv->z[i]))
+            continue;
+        for (k = 0; k < 3; k++)
+        {
+            gdouble v = columns[k][i];
+
+            priv->min[k] = MIN (priv->min[k], v);
+            priv->max[k] = MAX (priv->max[k], v);
+            sum[k] += v;
+        }
+        n++;
+    }
+
+    for (k = 0; k < 3; k++)
+        priv->mean[k] = n > 0 ? sum[k] / n : NAN;
+    priv->has_summary = TRUE;
+}
+
+/* Smallest and largest x, y and z into min[3] and max[3]. With no
+ * points min is 1 and max is 0. */
+void ternary_dataset_get_bounds (TernaryDataset *dataset,
+    gdouble *min, gdouble *max)
+{
+    TernaryDatasetPrivate *priv;
+    guint k;
+
+    g_return_if_fail (TERNARY_IS_DATASET (dataset));
+    priv = TERNARY_DATASET_GET_PRIVATE (dataset);
+
+    g_mutex_lock (&priv->lock);
+    summarize (priv);
+    for (k = 0; k < 3; k++)
+    {
+        if (min)
+            min[k] = priv->min[k];
+        if (max)
+            max[k] = priv->max[k];
+    }
+    g_mutex_unlock (&priv->lock);
+}
+
+/* arithmetic mean of x, y and z into mean[3], NaN with no points */
+void ternary_dataset_get_mean (TernaryDataset *dataset, gdouble *mean)
+{
+    TernaryDatasetPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_DATASET (dataset));
+    g_return_if_fail (mean != NULL);
+    priv = TERNARY_DATASET_GET_PRIVATE (dataset);
+
+    g_mutex_lock (&priv->lock);
+    summarize (priv);
+    mean[0] = priv->mean[0];
+    mean[1] = priv->mean[1];
+    mean[2] = priv->mean[2];
+    g_mutex_unlock (&priv->lock);
+}
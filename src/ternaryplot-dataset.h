@@ -0,0 +1,83 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_DATASET_H__
+#define __TERNARY_PLOT_DATASET_H__
+
+#include <glib-object.h>
+
+#include "ternaryplot-density.h"
+#include "ternaryplot-fixed.h"
+#include "ternaryplot-index.h"
+#include "ternaryplot-pyramid.h"
+
+G_BEGIN_DECLS
+
+#define TERNARY_TYPE_DATASET          (ternary_dataset_get_type ())
+#define TERNARY_DATASET(obj)          (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+                                       TERNARY_TYPE_DATASET, TernaryDataset))
+#define TERNARY_DATASET_CLASS(obj)    (G_TYPE_CHECK_CLASS_CAST ((obj), \
+                                       TERNARY_TYPE_DATASET, TernaryDatasetClass))
+#define TERNARY_IS_DATASET(obj)       (G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+                                       TERNARY_TYPE_DATASET))
+#define TERNARY_IS_DATASET_CLASS(obj) (G_TYPE_CHECK_CLASS_TYPE ((obj), \
+                                       TERNARY_TYPE_DATASET))
+
+/* Immutable points shown by any number of plots, together with the
+ * structures derived from them. Those are built on first use, once for
+ * every plot, and may be asked for from any thread. */
+typedef struct _TernaryDataset         TernaryDataset;
+typedef struct _TernaryDatasetClass    TernaryDatasetClass;
+
+struct _TernaryDataset
+{
+    GObject parent;
+
+    /* private */
+};
+
+struct _TernaryDatasetClass
+{
+    GObjectClass parent_class;
+};
+
+GType ternary_dataset_get_type (void);
+TernaryDataset *ternary_dataset_new (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n);
+TernaryDataset *ternary_dataset_new_full (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n, GDestroyNotify destroy, gpointer data);
+TernaryDataset *ternary_dataset_new_fixed (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n, guint bits);
+gsize ternary_dataset_get_n_points (TernaryDataset *dataset);
+void ternary_dataset_get_columns (TernaryDataset *dataset,
+    const gdouble **x, const gdouble **y, const gdouble **z);
+const TernaryFixed *ternary_dataset_get_fixed (TernaryDataset *dataset);
+
+TernaryIndex *ternary_dataset_get_index (TernaryDataset *dataset);
+TernaryPyramid *ternary_dataset_get_pyramid (TernaryDataset *dataset);
+TernaryPyramid *ternary_dataset_peek_pyramid (TernaryDataset *dataset);
+TernaryDensity *ternary_dataset_get_density (TernaryDataset *dataset,
+    guint resolution);
+void ternary_dataset_get_bounds (TernaryDataset *dataset,
+    gdouble *min, gdouble *max);
+void ternary_dataset_get_mean (TernaryDataset *dataset, gdouble *mean);
+
+G_END_DECLS
+
+#endif
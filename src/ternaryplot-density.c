@@ -0,0 +1,233 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "ternaryplot-density.h"
+#include "ternaryplot-parallel.h"
+
+#define DENSITY_GRAIN 65536 /* points binned per worker at least */
+#define DENSITY_LUT_SIZE 256
+
+typedef struct _DensityJob DensityJob;
+
+struct _DensityJob
+{
+    guint resolution;
+    const gdouble *x, *y, *z;
+    guint32 **bins; /* per worker */
+};
+
+/* white to dark blue, premultiplied ARGB32 */
+static const guint32 density_stops[] = {
+    0xffffffff, 0xffc6dbef, 0xff6baed6, 0xff2171b5, 0xff08306b
+};
+
+static const guint32 *density_lut (void)
+{
+    static guint32 lut[DENSITY_LUT_SIZE];
+    static gsize initialized = 0;
+
+    if (g_once_init_enter (&initialized))
+    {
+        guint i, n_stops;
+
+        n_stops = G_N_ELEMENTS (density_stops);
+        for (i = 0; i < DENSITY_LUT_SIZE; i++)
+        {
+            gdouble t, f;
+            guint s, c;
+            guint32 color;
+
+            t = (gdouble) i / (DENSITY_LUT_SIZE - 1) * (n_stops - 1);
+            s = MIN ((guint) t, n_stops - 2);
+            f = t - s;
+
+            color = 0xff000000;
+            for (c = 0; c < 24; c += 8)
+            {
+                guint lo, hi;
+
+                lo = (density_stops[s] >> c) & 0xff;
+                hi = (density_stops[s + 1] >> c) & 0xff;
+                color |= (guint32) (lo + (hi - (gdouble) lo) * f + 0.5) << c;
+            }
+            lut[i] = color;
+        }
+
+        g_once_init_leave (&initialized, 1);
+    }
+
+    return lut;
+}
+
+TernaryDensity *ternary_density_new (guint resolution)
+{
+    TernaryDensity *density;
+
+    g_return_val_if_fail (resolution > 0, NULL);
+
+    density = g_new0 (TernaryDensity, 1);
+    density->resolution = resolution;
+    density->counts = g_new0 (guint32, resolution * resolution);
+
+    return density;
+}
+
+void ternary_density_free (TernaryDensity *density)
+{
+    if (density == NULL)
+        return;
+
+    g_free (density->counts);
+    g_free (density);
+}
+
+/* a histogram of the same points that can be added to on its own */
+TernaryDensity *ternary_density_copy (const TernaryDensity *density)
+{
+    TernaryDensity *copy;
+
+    copy = g_new (TernaryDensity, 1);
+    *copy = *density;
+    copy->counts = g_memdup (density->counts,
+        density->resolution * density->resolution * sizeof (guint32));
+
+    return copy;
+}
+
+void ternary_density_clear (TernaryDensity *density)
+{
+    memset (density->counts, 0,
+            density->resolution * density->resolution * sizeof (guint32));
+    density->max_count = 0;
+    density->total = 0;
+}
+
+static void density_bin_range (gsize start, gsize end, guint worker,
+    gpointer data)
+{
+    DensityJob *job = data;
+    guint32 *bins;
+    gsize i;
+
+    bins = job->bins[worker];
+    for (i = start; i < end; i++)
+    {
+        guint cell;
+
+        cell = ternary_density_cell (job->resolution,
+            job->x[i], job->y[i], job->z[i]);
+        if (cell != G_MAXUINT)
+            bins[cell]++;
+    }
+}
+
+/* Adds n points to the histogram. Every worker bins its share of the
+ * points privately and the partial histograms are merged at the end, so
+ * there is no contention on hot cells. */
+void ternary_density_add (TernaryDensity *density,
+    const gdouble *x, const gdouble *y, const gdouble *z, gsize n)
+{
+    DensityJob job;
+    guint n_workers, n_cells, w, c;
+
+    if (n == 0)
+        return;
+
+    n_cells = density->resolution * density->resolution;
+    n_workers = ternary_parallel_n_workers (n, DENSITY_GRAIN);
+
+    job.resolution = density->resolution;
+    job.x = x;
+    job.y = y;
+    job.z = z;
+    job.bins = g_new (guint32 *, n_workers);
+    job.bins[0] = g_new0 (guint32, n_cells);
+    for (w = 1; w < n_workers; w++)
+        job.bins[w] = g_new0 (guint32, n_cells);
+
+    ternary_parallel_for (n, DENSITY_GRAIN, density_bin_range, &job);
+
+    for (c = 0; c < n_cells; c++)
+    {
+        guint32 added = 0;
+
+        for (w = 0; w < n_workers; w++)
+            added += job.bins[w][c];
+        density->counts[c] += added;
+        density->total += added;
+        density->max_count = MAX (density->max_count, density->counts[c]);
+    }
+
+    for (w = 0; w < n_workers; w++)
+        g_free (job.bins[w]);
+    g_free (job.bins);
+}
+
+/* Colour-maps the histogram into an ARGB32 image surface. Cells are
+ * coloured once on a log scale and every pixel then only looks up the
+ * cell under its centre; pixels outside the simplex stay transparent. */
+void ternary_density_render (TernaryDensity *density,
+    const TernaryAffine *inverse, cairo_surface_t *surface)
+{
+    const guint32 *lut;
+    guint32 *colors, *pixels;
+    guint n_cells, c;
+    gint width, height, stride, row, col;
+    gdouble scale;
+
+    lut = density_lut ();
+    n_cells = density->resolution * density->resolution;
+    colors = g_new (guint32, n_cells);
+    scale = density->max_count > 0 ?
+        (DENSITY_LUT_SIZE - 1) / log1p (density->max_count) : 0.0;
+    for (c = 0; c < n_cells; c++)
+        colors[c] = density->counts[c] == 0 ? 0 :
+            lut[(guint) (log1p (density->counts[c]) * scale)];
+
+    cairo_surface_flush (surface);
+    pixels = (guint32 *) cairo_image_surface_get_data (surface);
+    width = cairo_image_surface_get_width (surface);
+    height = cairo_image_surface_get_height (surface);
+    stride = cairo_image_surface_get_stride (surface) / sizeof (guint32);
+
+    for (row = 0; row < height; row++)
+    {
+        gdouble x, y;
+
+        /* barycentric coordinates of the first pixel centre in the row */
+        x = inverse->xx * 0.5 + inverse->xy * (row + 0.5) + inverse->x0;
+        y = inverse->yx * 0.5 + inverse->yy * (row + 0.5) + inverse->y0;
+        for (col = 0; col < width; col++)
+        {
+            guint cell;
+
+            cell = ternary_density_cell (density->resolution, x, y, 1.0 - x - y);
+            pixels[row * stride + col] = cell == G_MAXUINT ? 0 : colors[cell];
+            x += inverse->xx;
+            y += inverse->yx;
+        }
+    }
+
+    cairo_surface_mark_dirty (surface);
+    g_free (colors);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_DENSITY_H__
+#define __TERNARY_PLOT_DENSITY_H__
+
+#include <glib.h>
+#include <cairo.h>
+
+#include "ternaryplot-kernels.h"
+
+G_BEGIN_DECLS
+
+/* Histogram over the triangular lattice that splits every side of the
+ * simplex into resolution parts, the same cells the grid outlines.
+ * Row i holds the cells with i/resolution <= x < (i+1)/resolution,
+ * alternating upward and downward triangles, resolution^2 cells in all. */
+typedef struct _TernaryDensity TernaryDensity;
+
+struct _TernaryDensity
+{
+    guint resolution; /* cells per side */
+    guint32 *counts; /* resolution^2 cell counts */
+    guint32 max_count; /* largest cell count */
+    guint64 total; /* number of binned points */
+};
+
+TernaryDensity *ternary_density_new (guint resolution);
+void ternary_density_free (TernaryDensity *density);
+TernaryDensity *ternary_density_copy (const TernaryDensity *density);
+void ternary_density_clear (TernaryDensity *density);
+void ternary_density_add (TernaryDensity *density,
+    const gdouble *x, const gdouble *y, const gdouble *z, gsize n);
+void ternary_density_render (TernaryDensity *density,
+    const TernaryAffine *inverse, cairo_surface_t *surface);
+
+static inline guint ternary_density_cell (guint resolution,
+    gdouble x, gdouble y, gdouble z)
+{
+    gint n, i, j, k, down;
+
+    /* also rejects NaNs */
+    if (!(x >= 0 && y >= 0 && z >= 0))
+        return G_MAXUINT;
+
+    n = resolution;
+    i = MIN ((gint) (x * n), n - 1);
+    j = MIN ((gint) (y * n), n - 1 - i);
+    k = (gint) (z * n);
+
+    /* fractional parts sum to 1 in an upward cell and to 2 in a downward */
+    down = i + j + k < n - 1 && j < n - 1 - i;
+
+    return i * (2 * n - i) + 2 * j + down;
+}
+
+G_END_DECLS
+
+#endif
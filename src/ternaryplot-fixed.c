@@ -0,0 +1,144 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+
+#include "ternaryplot-fixed.h"
+
+#define FIXED_CHUNK 4096 /* points closed at a time */
+
+/* Nearest lattice point summing to scale: the components are rounded
+ * down, then the steps left over go to the largest remainders. */
+static void fixed_quantize (gdouble x, gdouble y, gdouble z, guint32 scale,
+    guint64 *a, guint64 *b)
+{
+    gdouble q[3], r[3];
+    guint64 s[3], sum;
+    gint k;
+
+    q[0] = CLAMP (x * scale, 0.0, (gdouble) scale);
+    q[1] = CLAMP (y * scale, 0.0, (gdouble) scale);
+    q[2] = CLAMP (z * scale, 0.0, (gdouble) scale);
+    for (k = 0; k < 3; k++)
+    {
+        s[k] = (guint64) q[k];
+        r[k] = q[k] - s[k];
+    }
+
+    for (sum = s[0] + s[1] + s[2]; sum < scale; sum++)
+    {
+        k = r[0] >= r[1] && r[0] >= r[2] ? 0 : r[1] >= r[2] ? 1 : 2;
+        s[k]++;
+        r[k] = -1.0;
+    }
+
+    *a = s[0];
+    *b = s[1];
+}
+
+/* Closes n points like ternary_plot_set_points and stores them with bits
+ * per component, 16 or 32. */
+TernaryFixed *ternary_fixed_new (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n, guint bits)
+{
+    TernaryFixed *fixed;
+    gdouble cx[FIXED_CHUNK], cy[FIXED_CHUNK], cz[FIXED_CHUNK];
+    gsize start, i;
+
+    g_return_val_if_fail (bits == 16 || bits == 32, NULL);
+    g_return_val_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL), NULL);
+
+    fixed = g_new (TernaryFixed, 1);
+    fixed->bits = bits;
+    fixed->scale = bits == 16 ? G_MAXUINT16 : G_MAXUINT32;
+    fixed->n_points = n;
+    fixed->a = g_malloc_n (MAX (n, 1), bits / 8);
+    fixed->b = g_malloc_n (MAX (n, 1), bits / 8);
+
+    for (start = 0; start < n; start += FIXED_CHUNK)
+    {
+        gsize m = MIN (FIXED_CHUNK, n - start);
+
+        ternary_kernels_closure (x + start, y + start, z + start,
+                                 cx, cy, cz, m);
+        for (i = 0; i < m; i++)
+        {
+            guint64 a, b;
+
+            /* zero sums and infinities stay apart, off the lattice */
+            if (isnan (cx[i] + cy[i] + cz[i]))
+                a = b = fixed->scale;
+            else
+                fixed_quantize (cx[i], cy[i], cz[i], fixed->scale, &a, &b);
+
+            if (bits == 16)
+            {
+                ((guint16 *) fixed->a)[start + i] = a;
+                ((guint16 *) fixed->b)[start + i] = b;
+            }
+            else
+            {
+                ((guint32 *) fixed->a)[start + i] = a;
+                ((guint32 *) fixed->b)[start + i] = b;
+            }
+        }
+    }
+
+    return fixed;
+}
+
+void ternary_fixed_free (TernaryFixed *fixed)
+{
+    if (fixed == NULL)
+        return;
+
+    g_free (fixed->a);
+    g_free (fixed->b);
+    g_free (fixed);
+}
+
+/* points [start, start + n) as doubles, z may be NULL */
+void ternary_fixed_decode (const TernaryFixed *fixed, gsize start, gsize n,
+    gdouble *x, gdouble *y, gdouble *z)
+{
+    gsize i;
+
+    for (i = 0; i < n; i++)
+    {
+        gdouble w;
+
+        ternary_fixed_get (fixed, start + i, &x[i], &y[i], z ? &z[i] : &w);
+    }
+}
+
+/* ternary_kernels_affine for points [start, start + n), decoded on the
+ * way */
+void ternary_fixed_affine (const TernaryFixed *fixed, const TernaryAffine *m,
+    gsize start, gsize n, gdouble *x, gdouble *y)
+{
+    if (fixed->bits == 16)
+        ternary_kernels_affine_fixed16 (m, fixed->scale,
+            (const guint16 *) fixed->a + start,
+            (const guint16 *) fixed->b + start, x, y, n);
+    else
+        ternary_kernels_affine_fixed32 (m, fixed->scale,
+            (const guint32 *) fixed->a + start,
+            (const guint32 *) fixed->b + start, x, y, n);
+}
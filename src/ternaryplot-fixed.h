@@ -0,0 +1,88 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_FIXED_H__
+#define __TERNARY_PLOT_FIXED_H__
+
+#include <glib.h>
+#include <math.h>
+
+#include "ternaryplot-kernels.h"
+
+G_BEGIN_DECLS
+
+/* Compositions stored as x and y on a fixed-point lattice of scale steps
+ * per unit, z being whatever is left, so every stored point sums to
+ * exactly one. Each component lies within one step of the closed input:
+ *
+ *   bits  bytes per point  step
+ *   16    4                1.5e-5
+ *   32    8                2.3e-10
+ *
+ * against 24 bytes for three doubles. */
+typedef struct _TernaryFixed TernaryFixed;
+
+struct _TernaryFixed
+{
+    guint bits; /* 16 or 32 per stored component */
+    guint32 scale; /* lattice steps per unit */
+    gsize n_points;
+    gpointer a, b; /* x and y in steps, guint16 or guint32 */
+};
+
+TernaryFixed *ternary_fixed_new (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n, guint bits);
+void ternary_fixed_free (TernaryFixed *fixed);
+void ternary_fixed_decode (const TernaryFixed *fixed, gsize start, gsize n,
+    gdouble *x, gdouble *y, gdouble *z);
+void ternary_fixed_affine (const TernaryFixed *fixed, const TernaryAffine *m,
+    gsize start, gsize n, gdouble *x, gdouble *y);
+
+/* Point i as doubles. Rows that failed closure come out NaN, like they
+ * are in double columns. */
+static inline void ternary_fixed_get (const TernaryFixed *fixed, gsize i,
+    gdouble *x, gdouble *y, gdouble *z)
+{
+    guint64 a, b;
+
+    if (fixed->bits == 16)
+    {
+        a = ((const guint16 *) fixed->a)[i];
+        b = ((const guint16 *) fixed->b)[i];
+    }
+    else
+    {
+        a = ((const guint32 *) fixed->a)[i];
+        b = ((const guint32 *) fixed->b)[i];
+    }
+
+    if (a + b > fixed->scale)
+    {
+        *x = *y = *z = NAN;
+        return;
+    }
+
+    *x = (gdouble) a / fixed->scale;
+    *y = (gdouble) b / fixed->scale;
+    *z = (gdouble) (fixed->scale - a - b) / fixed->scale;
+}
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <cairo.h>
+
+#include "ternaryplot-glyphs.h"
+
+#define FONT_FAMILY "Nimbus Sans L"
+#define FONT_SIZE 12
+
+static void shape (TernaryGlyphs *glyphs, TernaryGlyphRun *run,
+    const gchar *text)
+{
+    cairo_glyph_free (run->glyphs);
+    run->glyphs = NULL;
+    run->n_glyphs = 0;
+
+    if (text == NULL || cairo_scaled_font_text_to_glyphs (glyphs->font,
+            0, 0, text, -1, &run->glyphs, &run->n_glyphs,
+            NULL, NULL, NULL) != CAIRO_STATUS_SUCCESS)
+    {
+        run->glyphs = NULL;
+        run->n_glyphs = 0;
+    }
+
+    cairo_scaled_font_glyph_extents (glyphs->font, run->glyphs,
+        run->n_glyphs, &run->extents);
+}
+
+TernaryGlyphs *ternary_glyphs_new (void)
+{
+    TernaryGlyphs *glyphs;
+    cairo_font_face_t *face;
+    cairo_font_options_t *options;
+    cairo_matrix_t font_matrix, ctm;
+    gchar percent[12]; /* : 100.0% */
+    gint i;
+
+    glyphs = g_new0 (TernaryGlyphs, 1);
+
+    face = cairo_toy_font_face_create (FONT_FAMILY,
+        CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    options = cairo_font_options_create ();
+    cairo_matrix_init_scale (&font_matrix, FONT_SIZE, FONT_SIZE);
+    cairo_matrix_init_identity (&ctm);
+    glyphs->font = cairo_scaled_font_create (face, &font_matrix, &ctm, options);
+    cairo_font_options_destroy (options);
+    cairo_font_face_destroy (face);
+
+    cairo_scaled_font_extents (glyphs->font, &glyphs->font_extents);
+
+    glyphs->percents = g_new0 (TernaryGlyphRun, TERNARY_GLYPHS_N_PERCENTS);
+    for (i = 0; i < TERNARY_GLYPHS_N_PERCENTS; i++)
+    {
+        g_snprintf (percent, sizeof (percent), ": %.1f%%", i / 10.0);
+        shape (glyphs, &glyphs->percents[i], percent);
+        glyphs->percent_width = MAX (glyphs->percent_width,
+            glyphs->percents[i].extents.width);
+    }
+
+    for (i = 0; i < 3; i++)
+        shape (glyphs, &glyphs->labels[i], NULL);
+
+    return glyphs;
+}
+
+void ternary_glyphs_free (TernaryGlyphs *glyphs)
+{
+    gint i;
+
+    if (glyphs == NULL)
+        return;
+
+    for (i = 0; i < TERNARY_GLYPHS_N_PERCENTS; i++)
+        cairo_glyph_free (glyphs->percents[i].glyphs);
+    for (i = 0; i < 3; i++)
+        cairo_glyph_free (glyphs->labels[i].glyphs);
+    g_free (glyphs->percents);
+    cairo_scaled_font_destroy (glyphs->font);
+    g_free (glyphs);
+}
+
+void ternary_glyphs_set_label (TernaryGlyphs *glyphs, guint axis,
+    const gchar *label)
+{
+    g_return_if_fail (glyphs != NULL);
+    g_return_if_fail (axis < 3);
+
+    shape (glyphs, &glyphs->labels[axis], label);
+}
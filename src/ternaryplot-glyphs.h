@@ -0,0 +1,69 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_GLYPHS_H__
+#define __TERNARY_PLOT_GLYPHS_H__
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+#define TERNARY_GLYPHS_N_PERCENTS 1001 /* ": 0.0%" ... ": 100.0%" */
+
+typedef struct _TernaryGlyphRun TernaryGlyphRun;
+typedef struct _TernaryGlyphs TernaryGlyphs;
+
+/* A string shaped at the origin, ready for cairo_show_glyphs. */
+struct _TernaryGlyphRun
+{
+    cairo_glyph_t *glyphs;
+    gint n_glyphs;
+    cairo_text_extents_t extents;
+};
+
+/* Label font with the axis labels and every percentage string it can
+ * show already shaped, so drawing needs no font lookup or shaping. */
+struct _TernaryGlyphs
+{
+    cairo_scaled_font_t *font;
+    cairo_font_extents_t font_extents;
+    TernaryGlyphRun labels[3]; /* x-,y-,z-labels */
+    TernaryGlyphRun *percents; /* indexed by tenths of a percent */
+    gdouble percent_width; /* widest percentage string */
+};
+
+TernaryGlyphs *ternary_glyphs_new (void);
+void ternary_glyphs_free (TernaryGlyphs *glyphs);
+void ternary_glyphs_set_label (TernaryGlyphs *glyphs, guint axis,
+    const gchar *label);
+
+/* run for a fraction in [0, 1], as formatted by ": %.1f%%" */
+static inline const TernaryGlyphRun *
+ternary_glyphs_percent (const TernaryGlyphs *glyphs, gdouble fraction)
+{
+    gint tenths;
+
+    tenths = (gint) (fraction * 1000.0 + 0.5);
+    return &glyphs->percents[CLAMP (tenths, 0, TERNARY_GLYPHS_N_PERCENTS - 1)];
+}
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "ternaryplot-index.h"
+
+#define INDEX_MAX_SIDE 4096
+#define INDEX_POINTS_PER_CELL 2
+#define INDEX_NONE G_MAXUINT32 /* end of a cell's inserted points */
+
+typedef struct _IndexEntry IndexEntry;
+
+struct _IndexEntry
+{
+    guint32 id;
+    guint32 next; /* next inserted point of the cell, or INDEX_NONE */
+};
+
+struct _TernaryIndex
+{
+    guint side; /* cells per side of the unit square */
+    guint32 *cell_start; /* side^2 + 1 offsets into ids */
+    guint32 *ids; /* point indices grouped by cell */
+    gsize n_built; /* points sorted into ids */
+    guint32 *inserted_head; /* side^2 first inserted entries, or NULL */
+    GArray *inserted; /* IndexEntry of points added after the build */
+};
+
+static inline gint index_cell_coord (TernaryIndex *index, gdouble t)
+{
+    return CLAMP ((gint) (t * index->side), 0, (gint) index->side - 1);
+}
+
+/* point i, from whichever columns there are */
+static inline void index_point (const gdouble *xs, const gdouble *ys,
+    const TernaryFixed *fixed, gsize i, gdouble *x, gdouble *y)
+{
+    gdouble z;
+
+    if (fixed)
+        ternary_fixed_get (fixed, i, x, y, &z);
+    else
+    {
+        *x = xs[i];
+        *y = ys[i];
+    }
+}
+
+static TernaryIndex *index_build (const gdouble *xs, const gdouble *ys,
+    const TernaryFixed *fixed, gsize n)
+{
+    TernaryIndex *index;
+    guint n_cells, c;
+    guint32 *fill;
+    gsize i;
+
+    g_return_val_if_fail (n <= G_MAXUINT32, NULL);
+
+    index = g_new0 (TernaryIndex, 1);
+    index->side = CLAMP ((guint) sqrt ((gdouble) n / INDEX_POINTS_PER_CELL),
+                         1, INDEX_MAX_SIDE);
+    n_cells = index->side * index->side;
+    index->cell_start = g_new0 (guint32, n_cells + 1);
+    index->ids = g_new (guint32, n);
+    index->n_built = n;
+
+    /* counting sort of the points by cell: count, prefix sum, scatter */
+    for (i = 0; i < n; i++)
+    {
+        gdouble x, y, u, v;
+
+        index_point (xs, ys, fixed, i, &x, &y);
+        if (!(x >= 0 && y >= 0))
+            continue;
+        ternary_index_project (x, y, &u, &v);
+        index->cell_start[index_cell_coord (index, v) * index->side +
+                          index_cell_coord (index, u) + 1]++;
+    }
+
+    for (c = 0; c < n_cells; c++)
+        index->cell_start[c + 1] += index->cell_start[c];
+
+    fill = g_memdup (index->cell_start, n_cells * sizeof (guint32));
+    for (i = 0; i < n; i++)
+    {
+        gdouble x, y, u, v;
+
+        index_point (xs, ys, fixed, i, &x, &y);
+        if (!(x >= 0 && y >= 0))
+            continue;
+        ternary_index_project (x, y, &u, &v);
+        index->ids[fill[index_cell_coord (index, v) * index->side +
+                        index_cell_coord (index, u)]++] = i;
+    }
+    g_free (fill);
+
+    return index;
+}
+
+TernaryIndex *ternary_index_new (const gdouble *x, const gdouble *y, gsize n)
+{
+    return index_build (x, y, NULL, n);
+}
+
+/* the same over quantized points, which must outlive the index */
+TernaryIndex *ternary_index_new_fixed (const TernaryFixed *fixed)
+{
+    g_return_val_if_fail (fixed != NULL, NULL);
+    return index_build (NULL, NULL, fixed, fixed->n_points);
+}
+
+void ternary_index_free (TernaryIndex *index)
+{
+    if (index == NULL)
+        return;
+
+    g_free (index->cell_start);
+    g_free (index->ids);
+    g_free (index->inserted_head);
+    if (index->inserted)
+        g_array_free (index->inserted, TRUE);
+    g_free (index);
+}
+
+static inline guint index_cell (TernaryIndex *index, gdouble x, gdouble y)
+{
+    gdouble u, v;
+
+    ternary_index_project (x, y, &u, &v);
+    return index_cell_coord (index, v) * index->side +
+           index_cell_coord (index, u);
+}
+
+/* Adds points [start, end) of the columns the index was built on, which
+ * may have moved since, without sorting the others again. Returns FALSE
+ * and adds nothing once more points would be added than were built on,
+ * as the grid is then too coarse; the index should be built anew. */
+gboolean ternary_index_insert (TernaryIndex *index, const gdouble *xs,
+    const gdouble *ys, gsize start, gsize end)
+{
+    guint n_cells;
+    gsize i;
+
+    g_return_val_if_fail (index != NULL, FALSE);
+    g_return_val_if_fail (start <= end, FALSE);
+
+    n_cells = index->side * index->side;
+
+    if (end > G_MAXUINT32 ||
+        (index->inserted ? index->inserted->len : 0) + (end - start) >
+        index->n_built)
+        return FALSE;
+
+    if (index->inserted == NULL)
+    {
+        index->inserted = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+        index->inserted_head = g_new (guint32, n_cells);
+        memset (index->inserted_head, 0xff, n_cells * sizeof (guint32));
+    }
+
+    for (i = start; i < end; i++)
+    {
+        IndexEntry entry;
+        guint c;
+
+        if (!(xs[i] >= 0 && ys[i] >= 0))
+            continue;
+        c = index_cell (index, xs[i], ys[i]);
+        entry.id = i;
+        entry.next = index->inserted_head[c];
+        index->inserted_head[c] = index->inserted->len;
+        g_array_append_val (index->inserted, entry);
+    }
+
+    return TRUE;
+}
+
+static inline void index_visit (const gdouble *xs, const gdouble *ys,
+    const TernaryFixed *fixed, guint32 id, gdouble u, gdouble v,
+    gdouble *best, gssize *nearest)
+{
+    gdouble px, py, pu, pv, d;
+
+    index_point (xs, ys, fixed, id, &px, &py);
+    ternary_index_project (px, py, &pu, &pv);
+    d = (pu - u) * (pu - u) + (pv - v) * (pv - v);
+    if (d <= *best)
+    {
+        *best = d;
+        *nearest = id;
+    }
+}
+
+/* Only the cells overlapping the search square are visited, so the
+ * cost does not depend on n. */
+static gssize index_search (TernaryIndex *index, const gdouble *xs,
+    const gdouble *ys, const TernaryFixed *fixed,
+    gdouble x, gdouble y, gdouble radius)
+{
+    gdouble u, v, best;
+    gint u0, u1, v0, v1, cu, cv;
+    gssize nearest = -1;
+
+    ternary_index_project (x, y, &u, &v);
+    u0 = index_cell_coord (index, u - radius);
+    u1 = index_cell_coord (index, u + radius);
+    v0 = index_cell_coord (index, v - radius);
+    v1 = index_cell_coord (index, v + radius);
+
+    best = radius * radius;
+    for (cv = v0; cv <= v1; cv++)
+        for (cu = u0; cu <= u1; cu++)
+        {
+            guint c;
+            guint32 k;
+
+            c = cv * index->side + cu;
+            for (k = index->cell_start[c]; k < index->cell_start[c + 1]; k++)
+                index_visit (xs, ys, fixed, index->ids[k], u, v, &best,
+                             &nearest);
+            if (index->inserted_head == NULL)
+                continue;
+            for (k = index->inserted_head[c]; k != INDEX_NONE;
+                 k = g_array_index (index->inserted, IndexEntry, k).next)
+                index_visit (xs, ys, fixed,
+                             g_array_index (index->inserted, IndexEntry, k).id,
+                             u, v, &best, &nearest);
+        }
+
+    return nearest;
+}
+
+/* Returns the point closest to (x, y) within radius, measured in the
+ * unit triangle, or -1 when there is none. */
+gssize ternary_index_nearest (TernaryIndex *index,
+    const gdouble *xs, const gdouble *ys,
+    gdouble x, gdouble y, gdouble radius)
+{
+    return index_search (index, xs, ys, NULL, x, y, radius);
+}
+
+gssize ternary_index_nearest_fixed (TernaryIndex *index,
+    const TernaryFixed *fixed, gdouble x, gdouble y, gdouble radius)
+{
+    return index_search (index, NULL, NULL, fixed, x, y, radius);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_INDEX_H__
+#define __TERNARY_PLOT_INDEX_H__
+
+#include <glib.h>
+
+#include "ternaryplot-fixed.h"
+
+G_BEGIN_DECLS
+
+/* Uniform grid over the simplex for nearest point queries. Points are
+ * bucketed by their position in an equilateral unit triangle, where
+ * distances are proportional to on-screen distances. The index refers
+ * to the caller's x and y columns and does not copy them. */
+typedef struct _TernaryIndex TernaryIndex;
+
+TernaryIndex *ternary_index_new (const gdouble *x, const gdouble *y, gsize n);
+TernaryIndex *ternary_index_new_fixed (const TernaryFixed *fixed);
+void ternary_index_free (TernaryIndex *index);
+gboolean ternary_index_insert (TernaryIndex *index, const gdouble *xs,
+    const gdouble *ys, gsize start, gsize end);
+gssize ternary_index_nearest (TernaryIndex *index,
+    const gdouble *xs, const gdouble *ys,
+    gdouble x, gdouble y, gdouble radius);
+gssize ternary_index_nearest_fixed (TernaryIndex *index,
+    const TernaryFixed *fixed, gdouble x, gdouble y, gdouble radius);
+
+/* position in the equilateral unit triangle with the x-vertex on top */
+static inline void ternary_index_project (gdouble x, gdouble y,
+    gdouble *u, gdouble *v)
+{
+    *u = y + x / 2;
+    *v = x * 0.86602540378443864676; /* sqrt (3) / 2 */
+}
+
+G_END_DECLS
+
+#endif
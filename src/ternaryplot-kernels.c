@@ -0,0 +1,327 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+
+#include "ternaryplot-kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+typedef void (*TernaryAffineKernel) (const TernaryAffine *m,
+    const gdouble *u, const gdouble *v,
+    gdouble *x, gdouble *y, gdouble *w, gsize n);
+
+gboolean ternary_affine_invert (const TernaryAffine *m, TernaryAffine *inverse)
+{
+    gdouble det;
+
+    det = m->xx * m->yy - m->xy * m->yx;
+    if (det == 0.0)
+        return FALSE;
+
+    inverse->xx = m->yy / det;
+    inverse->xy = -m->xy / det;
+    inverse->yx = -m->yx / det;
+    inverse->yy = m->xx / det;
+    inverse->x0 = -(inverse->xx * m->x0 + inverse->xy * m->y0);
+    inverse->y0 = -(inverse->yx * m->x0 + inverse->yy * m->y0);
+
+    return TRUE;
+}
+
+static void affine_scalar (const TernaryAffine *m,
+    const gdouble *u, const gdouble *v,
+    gdouble *x, gdouble *y, gdouble *w, gsize n)
+{
+    gsize i;
+
+    for (i = 0; i < n; i++)
+    {
+        gdouble tx, ty;
+
+        tx = m->xx * u[i] + m->xy * v[i] + m->x0;
+        ty = m->yx * u[i] + m->yy * v[i] + m->y0;
+        x[i] = tx;
+        y[i] = ty;
+        if (w)
+            w[i] = 1.0 - tx - ty;
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__ ((target ("sse2")))
+static void affine_sse2 (const TernaryAffine *m,
+    const gdouble *u, const gdouble *v,
+    gdouble *x, gdouble *y, gdouble *w, gsize n)
+{
+    __m128d xx, xy, x0, yx, yy, y0, one;
+    gsize i;
+
+    xx = _mm_set1_pd (m->xx);
+    xy = _mm_set1_pd (m->xy);
+    x0 = _mm_set1_pd (m->x0);
+    yx = _mm_set1_pd (m->yx);
+    yy = _mm_set1_pd (m->yy);
+    y0 = _mm_set1_pd (m->y0);
+    one = _mm_set1_pd (1.0);
+
+    for (i = 0; i + 2 <= n; i += 2)
+    {
+        __m128d vu, vv, tx, ty;
+
+        vu = _mm_loadu_pd (u + i);
+        vv = _mm_loadu_pd (v + i);
+        tx = _mm_add_pd (_mm_add_pd (_mm_mul_pd (xx, vu), _mm_mul_pd (xy, vv)), x0);
+        ty = _mm_add_pd (_mm_add_pd (_mm_mul_pd (yx, vu), _mm_mul_pd (yy, vv)), y0);
+        _mm_storeu_pd (x + i, tx);
+        _mm_storeu_pd (y + i, ty);
+        if (w)
+            _mm_storeu_pd (w + i, _mm_sub_pd (_mm_sub_pd (one, tx), ty));
+    }
+
+    affine_scalar (m, u + i, v + i, x + i, y + i, w ? w + i : NULL, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void affine_avx2 (const TernaryAffine *m,
+    const gdouble *u, const gdouble *v,
+    gdouble *x, gdouble *y, gdouble *w, gsize n)
+{
+    __m256d xx, xy, x0, yx, yy, y0, one;
+    gsize i;
+
+    xx = _mm256_set1_pd (m->xx);
+    xy = _mm256_set1_pd (m->xy);
+    x0 = _mm256_set1_pd (m->x0);
+    yx = _mm256_set1_pd (m->yx);
+    yy = _mm256_set1_pd (m->yy);
+    y0 = _mm256_set1_pd (m->y0);
+    one = _mm256_set1_pd (1.0);
+
+    /* no FMA, so results match the scalar and SSE2 paths bit for bit */
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m256d vu, vv, tx, ty;
+
+        vu = _mm256_loadu_pd (u + i);
+        vv = _mm256_loadu_pd (v + i);
+        tx = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (xx, vu), _mm256_mul_pd (xy, vv)), x0);
+        ty = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (yx, vu), _mm256_mul_pd (yy, vv)), y0);
+        _mm256_storeu_pd (x + i, tx);
+        _mm256_storeu_pd (y + i, ty);
+        if (w)
+            _mm256_storeu_pd (w + i, _mm256_sub_pd (_mm256_sub_pd (one, tx), ty));
+    }
+
+    affine_scalar (m, u + i, v + i, x + i, y + i, w ? w + i : NULL, n - i);
+}
+#endif
+
+static TernaryAffineKernel affine_kernel_select (void)
+{
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+        return affine_avx2;
+    if (__builtin_cpu_supports ("sse2"))
+        return affine_sse2;
+#endif
+    return affine_scalar;
+}
+
+void ternary_kernels_affine (const TernaryAffine *m,
+    const gdouble *u, const gdouble *v,
+    gdouble *x, gdouble *y, gdouble *w, gsize n)
+{
+    static TernaryAffineKernel kernel = NULL;
+
+    /* racing threads pick the same kernel, so a plain store is fine */
+    if (G_UNLIKELY (kernel == NULL))
+        kernel = affine_kernel_select ();
+
+    kernel (m, u, v, x, y, w, n);
+}
+
+/* Maps fixed-point (a, b) = (x, y) * scale to (x, y). The scale is
+ * folded into the matrix, so decoding costs nothing; points with
+ * a + b > scale mark rows that failed closure and come out NaN. */
+void ternary_kernels_affine_fixed16 (const TernaryAffine *m, guint32 scale,
+    const guint16 *a, const guint16 *b, gdouble *x, gdouble *y, gsize n)
+{
+    gdouble s = 1.0 / scale;
+    gdouble xx = m->xx * s, xy = m->xy * s, yx = m->yx * s, yy = m->yy * s;
+    gsize i;
+
+    for (i = 0; i < n; i++)
+    {
+        gdouble u = a[i], v = b[i];
+        gboolean valid = (guint32) a[i] + b[i] <= scale;
+
+        x[i] = valid ? xx * u + xy * v + m->x0 : NAN;
+        y[i] = valid ? yx * u + yy * v + m->y0 : NAN;
+    }
+}
+
+void ternary_kernels_affine_fixed32 (const TernaryAffine *m, guint32 scale,
+    const guint32 *a, const guint32 *b, gdouble *x, gdouble *y, gsize n)
+{
+    gdouble s = 1.0 / scale;
+    gdouble xx = m->xx * s, xy = m->xy * s, yx = m->yx * s, yy = m->yy * s;
+    gsize i;
+
+    for (i = 0; i < n; i++)
+    {
+        gdouble u = a[i], v = b[i];
+        gboolean valid = (guint64) a[i] + b[i] <= scale;
+
+        x[i] = valid ? xx * u + xy * v + m->x0 : NAN;
+        y[i] = valid ? yx * u + yy * v + m->y0 : NAN;
+    }
+}
+
+void ternary_kernels_closure (const gdouble *x, const gdouble *y,
+    const gdouble *z, gdouble *cx, gdouble *cy, gdouble *cz, gsize n)
+{
+    gsize i;
+
+    for (i = 0; i < n; i++)
+    {
+        gdouble ax, ay, az, inv;
+
+        ax = fabs (x[i]);
+        ay = fabs (y[i]);
+        az = fabs (z[i]);
+        inv = 1.0 / (ax + ay + az);
+        cx[i] = ax * inv;
+        cy[i] = ay * inv;
+        cz[i] = az * inv;
+    }
+}
+
+void ternary_kernels_clr (const gdouble *x, const gdouble *y,
+    const gdouble *z, gdouble *a, gdouble *b, gdouble *c, gsize n)
+{
+    gsize i;
+
+    for (i = 0; i < n; i++)
+    {
+        gdouble lx, ly, lz, g;
+
+        lx = log (x[i]);
+        ly = log (y[i]);
+        lz = log (z ? z[i] : 1.0 - x[i] - y[i]);
+        g = (lx + ly + lz) / 3;
+        a[i] = lx - g;
+        b[i] = ly - g;
+        c[i] = lz - g;
+    }
+}
+
+void ternary_kernels_clr_inverse (const gdouble *a, const gdouble *b,
+    const gdouble *c, gdouble *x, gdouble *y, gdouble *z, gsize n)
+{
+    gsize i;
+
+    /* shifted by the largest part so exp cannot overflow */
+    for (i = 0; i < n; i++)
+    {
+        gdouble m, ex, ey, ez, inv;
+
+        m = MAX (a[i], MAX (b[i], c[i]));
+        ex = exp (a[i] - m);
+        ey = exp (b[i] - m);
+        ez = exp (c[i] - m);
+        inv = 1.0 / (ex + ey + ez);
+        x[i] = ex * inv;
+        y[i] = ey * inv;
+        z[i] = ez * inv;
+    }
+}
+
+void ternary_kernels_ilr (const gdouble *x, const gdouble *y,
+    const gdouble *z, gdouble *u, gdouble *v, gsize n)
+{
+    const gdouble ku = sqrt (2.0 / 3.0), kv = sqrt (0.5);
+    gsize i;
+
+    for (i = 0; i < n; i++)
+    {
+        gdouble lx, ly, lz;
+
+        lx = log (x[i]);
+        ly = log (y[i]);
+        lz = log (z ? z[i] : 1.0 - x[i] - y[i]);
+        u[i] = ku * (lx - 0.5 * (ly + lz));
+        v[i] = kv * (ly - lz);
+    }
+}
+
+void ternary_kernels_ilr_inverse (const gdouble *u, const gdouble *v,
+    gdouble *x, gdouble *y, gdouble *z, gsize n)
+{
+    const gdouble ka = sqrt (2.0 / 3.0), kb = sqrt (1.0 / 6.0);
+    const gdouble kv = sqrt (0.5);
+    gsize i;
+
+    /* through the centred logs of the orthonormal basis, shifted by the
+     * largest so exp cannot overflow */
+    for (i = 0; i < n; i++)
+    {
+        gdouble a, b, c, m, ex, ey, ez, inv;
+
+        a = ka * u[i];
+        b = kv * v[i] - kb * u[i];
+        c = -kv * v[i] - kb * u[i];
+        m = MAX (a, MAX (b, c));
+        ex = exp (a - m);
+        ey = exp (b - m);
+        ez = exp (c - m);
+        inv = 1.0 / (ex + ey + ez);
+        x[i] = ex * inv;
+        y[i] = ey * inv;
+        z[i] = ez * inv;
+    }
+}
+
+void ternary_kernels_lookup (const guint32 *lut, guint size,
+    gdouble min, gdouble max, const gdouble *values, guint32 *colors,
+    guint32 missing, gsize n)
+{
+    gdouble last = size - 1;
+    gdouble k = max > min ? last / (max - min) : 0.0;
+    gsize i;
+
+    /* indices first, in a loop the compiler vectorizes, then the
+     * gather; NaNs are parked at entry 0 and patched afterwards */
+    for (i = 0; i < n; i++)
+    {
+        gdouble t = (values[i] - min) * k;
+
+        t = t >= 0.0 ? t : 0.0;
+        t = t <= last ? t : last;
+        colors[i] = (guint32) (t + 0.5);
+    }
+
+    for (i = 0; i < n; i++)
+        colors[i] = values[i] == values[i] ? lut[colors[i]] : missing;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_KERNELS_H__
+#define __TERNARY_PLOT_KERNELS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* 2x3 affine map: x' = xx*u + xy*v + x0, y' = yx*u + yy*v + y0 */
+typedef struct _TernaryAffine TernaryAffine;
+
+struct _TernaryAffine
+{
+    gdouble xx, xy, x0;
+    gdouble yx, yy, y0;
+};
+
+gboolean ternary_affine_invert (const TernaryAffine *m, TernaryAffine *inverse);
+
+/* Applies m to n (u, v) pairs. When w is not NULL it also receives
+ * 1 - x' - y', the implicit third barycentric coordinate. Outputs may
+ * alias the inputs. */
+void ternary_kernels_affine (const TernaryAffine *m,
+    const gdouble *u, const gdouble *v,
+    gdouble *x, gdouble *y, gdouble *w, gsize n);
+
+/* The same for n fixed-point (x, y) pairs in steps of 1 / scale. */
+void ternary_kernels_affine_fixed16 (const TernaryAffine *m, guint32 scale,
+    const guint16 *a, const guint16 *b, gdouble *x, gdouble *y, gsize n);
+void ternary_kernels_affine_fixed32 (const TernaryAffine *m, guint32 scale,
+    const guint32 *a, const guint32 *b, gdouble *x, gdouble *y, gsize n);
+
+/* Closes n compositions to |x| + |y| + |z| = 1. Outputs may alias the
+ * inputs; zero-sum rows come out as NaN. */
+void ternary_kernels_closure (const gdouble *x, const gdouble *y,
+    const gdouble *z, gdouble *cx, gdouble *cy, gdouble *cz, gsize n);
+
+/* Log-ratio coordinates of n closed compositions with positive parts.
+ * clr gives the logs centred on their mean, ilr the orthonormal pivot
+ * coordinates u = sqrt (2/3) ln (x / sqrt (y z)), v = sqrt (1/2) ln (y / z).
+ * When z is NULL it is the implicit 1 - x - y. Rows with a zero part
+ * come out non-finite. The inverses return closed compositions. */
+void ternary_kernels_clr (const gdouble *x, const gdouble *y,
+    const gdouble *z, gdouble *a, gdouble *b, gdouble *c, gsize n);
+void ternary_kernels_clr_inverse (const gdouble *a, const gdouble *b,
+    const gdouble *c, gdouble *x, gdouble *y, gdouble *z, gsize n);
+void ternary_kernels_ilr (const gdouble *x, const gdouble *y,
+    const gdouble *z, gdouble *u, gdouble *v, gsize n);
+void ternary_kernels_ilr_inverse (const gdouble *u, const gdouble *v,
+    gdouble *x, gdouble *y, gdouble *z, gsize n);
+
+/* Maps n values linearly from [min, max] onto the size entries of lut,
+ * clamping at both ends, into packed colours. NaNs get missing. */
+void ternary_kernels_lookup (const guint32 *lut, guint size,
+    gdouble min, gdouble max, const gdouble *values, guint32 *colors,
+    guint32 missing, gsize n);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+
+#include "ternaryplot-parallel.h"
+
+typedef struct _TernaryRange TernaryRange;
+
+struct _TernaryRange
+{
+    TernaryRangeFunc func;
+    gpointer data;
+    gsize start, end;
+    guint worker;
+};
+
+static gpointer ternary_parallel_worker (gpointer data)
+{
+    TernaryRange *range = data;
+
+    range->func (range->start, range->end, range->worker, range->data);
+
+    return NULL;
+}
+
+/* Number of workers ternary_parallel_for will use for the same n and
+ * grain, so callers can allocate per-worker state up front. */
+guint ternary_parallel_n_workers (gsize n, gsize grain)
+{
+    gsize chunks;
+
+    chunks = (n + MAX (grain, 1) - 1) / MAX (grain, 1);
+    return CLAMP (chunks, 1, g_get_num_processors ());
+}
+
+/* Splits [0, n) into contiguous ranges of at least grain items, runs
+ * them on one thread per processor and returns when all are done. The
+ * calling thread handles the first range. */
+void ternary_parallel_for (gsize n, gsize grain, TernaryRangeFunc func,
+    gpointer data)
+{
+    TernaryRange *ranges;
+    GThread **threads;
+    guint n_workers, i;
+
+    if (n == 0)
+        return;
+
+    n_workers = ternary_parallel_n_workers (n, grain);
+    if (n_workers == 1)
+    {
+        func (0, n, 0, data);
+        return;
+    }
+
+    ranges = g_new (TernaryRange, n_workers);
+    threads = g_new0 (GThread *, n_workers);
+
+    for (i = 0; i < n_workers; i++)
+    {
+        ranges[i].func = func;
+        ranges[i].data = data;
+        ranges[i].start = n / n_workers * i;
+        ranges[i].end = i + 1 == n_workers ? n : n / n_workers * (i + 1);
+        ranges[i].worker = i;
+        if (i > 0)
+            threads[i] = g_thread_new ("ternaryplot", ternary_parallel_worker,
+                                       &ranges[i]);
+    }
+
+    ternary_parallel_worker (&ranges[0]);
+    for (i = 1; i < n_workers; i++)
+        g_thread_join (threads[i]);
+
+    g_free (threads);
+    g_free (ranges);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_PARALLEL_H__
+#define __TERNARY_PLOT_PARALLEL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Processes [start, end) of a larger range on worker number worker. */
+typedef void (*TernaryRangeFunc) (gsize start, gsize end, guint worker,
+    gpointer data);
+
+guint ternary_parallel_n_workers (gsize n, gsize grain);
+void ternary_parallel_for (gsize n, gsize grain, TernaryRangeFunc func,
+    gpointer data);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,499 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "ternaryplot.h"
+#include "ternaryplot-density.h"
+#include "ternaryplot-parallel.h"
+#include "ternaryplot-pyramid.h"
+
+#define PYRAMID_GRAIN 65536 /* points classified per worker at least */
+#define PYRAMID_CHECK 16384 /* points classified between cancellation checks */
+#define PYRAMID_MAGIC 0x52595054 /* "TPYR" little-endian */
+#define PYRAMID_VERSION 2 /* 1 had no point order */
+#define PYRAMID_HEADER 4 /* magic, version, depth, flags, then n_points */
+#define PYRAMID_SORTED 1 /* flag: offsets and order follow the levels */
+
+typedef struct _PyramidJob PyramidJob;
+
+struct _PyramidJob
+{
+    guint resolution;
+    const gdouble *x, *y, *z;
+    const TernaryFixed *fixed; /* read instead of x, y and z if set */
+    guint32 *cells; /* leaf per point */
+    volatile gint *generation; /* cancelled once it differs from expected */
+    gint expected;
+};
+
+static inline gboolean pyramid_cancelled (PyramidJob *job)
+{
+    return job->generation &&
+           g_atomic_int_get (job->generation) != job->expected;
+}
+
+static inline gsize level_size (guint level)
+{
+    return (gsize) 1 << (2 * level);
+}
+
+static TernaryPyramid *pyramid_alloc (guint depth)
+{
+    TernaryPyramid *pyramid;
+    guint l;
+
+    pyramid = g_new0 (TernaryPyramid, 1);
+    pyramid->depth = depth;
+    pyramid->counts = g_new (guint32 *, depth + 1);
+    pyramid->samples = g_new (guint32 *, depth + 1);
+    for (l = 0; l <= depth; l++)
+    {
+        pyramid->counts[l] = g_new0 (guint32, level_size (l));
+        pyramid->samples[l] = g_new (guint32, level_size (l));
+        memset (pyramid->samples[l], 0xff, level_size (l) * sizeof (guint32));
+    }
+
+    return pyramid;
+}
+
+void ternary_pyramid_free (TernaryPyramid *pyramid)
+{
+    guint l;
+
+    if (pyramid == NULL)
+        return;
+
+    /* mapped levels and order belong to the file */
+    if (pyramid->file != NULL)
+        g_mapped_file_unref (pyramid->file);
+    else
+    {
+        for (l = 0; l <= pyramid->depth; l++)
+        {
+            g_free (pyramid->counts[l]);
+            g_free (pyramid->samples[l]);
+        }
+        g_free (pyramid->order);
+        g_free (pyramid->offsets);
+    }
+    g_free (pyramid->counts);
+    g_free (pyramid->samples);
+    g_free (pyramid);
+}
+
+static void pyramid_classify_range (gsize start, gsize end, guint worker,
+    gpointer data)
+{
+    PyramidJob *job = data;
+    gsize i, stop;
+
+    (void) worker;
+
+    for (; start < end; start = stop)
+    {
+        if (pyramid_cancelled (job))
+            return;
+
+        stop = MIN (start + PYRAMID_CHECK, end);
+        if (job->fixed)
+            for (i = start; i < stop; i++)
+            {
+                gdouble x, y, z;
+
+                ternary_fixed_get (job->fixed, i, &x, &y, &z);
+                job->cells[i] = ternary_density_cell (job->resolution,
+                                                      x, y, z);
+            }
+        else
+            for (i = start; i < stop; i++)
+                job->cells[i] = ternary_density_cell (job->resolution,
+                    job->x[i], job->y[i], job->z[i]);
+    }
+}
+
+/* parent of every node of a level, found from the node centroid */
+static void pyramid_parents (guint level, guint32 *parents)
+{
+    guint n, i, o;
+    gsize cell = 0;
+
+    n = 1 << level;
+    for (i = 0; i < n; i++)
+        for (o = 0; o < 2 * (n - i) - 1; o++, cell++)
+        {
+            gdouble x, y, third;
+
+            third = o % 2 ? 2.0 / 3 : 1.0 / 3;
+            x = (i + third) / n;
+            y = (o / 2 + third) / n;
+            parents[cell] = ternary_density_cell (n / 2, x, y, 1.0 - x - y);
+        }
+}
+
+/* Placing the points in their leaves runs on all processors; the
+ * levels above are summed from the leaves, which only costs time
+ * proportional to the number of nodes. Returns NULL when cancelled
+ * while the points were read. */
+static TernaryPyramid *pyramid_build (PyramidJob *job, gsize n, guint depth)
+{
+    TernaryPyramid *pyramid;
+    guint32 *parents;
+    gsize i, c, m;
+    guint l;
+
+    job->resolution = 1 << depth;
+    job->cells = g_new (guint32, MAX (n, 1));
+    ternary_parallel_for (n, PYRAMID_GRAIN, pyramid_classify_range, job);
+    if (pyramid_cancelled (job))
+    {
+        g_free (job->cells);
+        return NULL;
+    }
+
+    pyramid = pyramid_alloc (depth);
+    pyramid->n_points = n;
+
+    /* the first point of a leaf represents it */
+    for (i = 0; i < n; i++)
+    {
+        guint32 cell = job->cells[i];
+
+        if (cell == G_MAXUINT32)
+            continue;
+        if (pyramid->counts[depth][cell]++ == 0)
+            pyramid->samples[depth][cell] = i;
+    }
+
+    /* Sort the points by leaf so views deeper than the leaves can visit
+     * just the leaves they show: every offset is first summed up to the
+     * end of its leaf, then walked back to its start as the points are
+     * placed. */
+    pyramid->offsets = g_new (guint32, level_size (depth) + 1);
+    for (c = 0, m = 0; c < level_size (depth); c++)
+        pyramid->offsets[c] = m += pyramid->counts[depth][c];
+    pyramid->offsets[c] = m;
+    pyramid->order = g_new (guint32, MAX (m, 1));
+    for (i = n; i-- > 0;)
+        if (job->cells[i] != G_MAXUINT32)
+            pyramid->order[--pyramid->offsets[job->cells[i]]] = i;
+    g_free (job->cells);
+
+    parents = g_new (guint32, level_size (depth));
+    for (l = depth; l > 0; l--)
+    {
+        guint32 *counts = pyramid->counts[l], *samples = pyramid->samples[l];
+        guint32 *up_counts = pyramid->counts[l - 1];
+        guint32 *up_samples = pyramid->samples[l - 1];
+        guint32 *best;
+
+        /* largest child count seen per parent */
+        best = g_new0 (guint32, level_size (l - 1));
+        pyramid_parents (l, parents);
+        for (c = 0; c < level_size (l); c++)
+        {
+            guint32 p = parents[c];
+
+            up_counts[p] += counts[c];
+            if (counts[c] > best[p])
+            {
+                best[p] = counts[c];
+                up_samples[p] = samples[c];
+            }
+        }
+        g_free (best);
+    }
+    g_free (parents);
+
+    return pyramid;
+}
+
+/* Builds a pyramid depth levels deep. */
+TernaryPyramid *ternary_pyramid_new (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n, guint depth)
+{
+    return ternary_pyramid_new_cancellable (x, y, z, n, depth, NULL, 0);
+}
+
+/* The same for background workers: the points are only read while
+ * generation holds expected, and NULL is returned once it moves on. */
+TernaryPyramid *ternary_pyramid_new_cancellable (const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, guint depth,
+    volatile gint *generation, gint expected)
+{
+    PyramidJob job;
+
+    g_return_val_if_fail (depth <= TERNARY_PYRAMID_MAX_DEPTH, NULL);
+    g_return_val_if_fail (n < G_MAXUINT32, NULL);
+
+    job.x = x;
+    job.y = y;
+    job.z = z;
+    job.fixed = NULL;
+    job.generation = generation;
+    job.expected = expected;
+
+    return pyramid_build (&job, n, depth);
+}
+
+/* the same for quantized points */
+TernaryPyramid *ternary_pyramid_new_fixed (const TernaryFixed *fixed,
+    guint depth)
+{
+    PyramidJob job;
+
+    g_return_val_if_fail (fixed != NULL, NULL);
+    g_return_val_if_fail (depth <= TERNARY_PYRAMID_MAX_DEPTH, NULL);
+    g_return_val_if_fail (fixed->n_points < G_MAXUINT32, NULL);
+
+    job.x = job.y = job.z = NULL;
+    job.fixed = fixed;
+    job.generation = NULL;
+    job.expected = 0;
+
+    return pyramid_build (&job, fixed->n_points, depth);
+}
+
+/* Deepest level worth building for n points, about one point per leaf. */
+guint ternary_pyramid_depth_for (gsize n)
+{
+    guint depth = 0;
+
+    while (depth < TERNARY_PYRAMID_MAX_DEPTH && level_size (depth + 1) <= n)
+        depth++;
+
+    return depth;
+}
+
+/* Shallowest level whose nodes are no larger than a marker on a triangle
+ * side pixels long, or -1 when even the leaves are too coarse. */
+gint ternary_pyramid_level_for (TernaryPyramid *pyramid, gdouble side,
+    gdouble point_size)
+{
+    gint level;
+
+    if (!(side > 0 && point_size > 0))
+        return -1;
+
+    level = (gint) ceil (log2 (side / point_size));
+    level = MAX (level, 0);
+
+    return level <= (gint) pyramid->depth ? level : -1;
+}
+
+/* Lays the pyramid out as little-endian 32 bit words: a header, then the
+ * counts and the samples of every level from the root down, then the leaf
+ * offsets and the point order when the pyramid has them. */
+guint32 *ternary_pyramid_serialize (TernaryPyramid *pyramid, gsize *length)
+{
+    guint32 *words, *w;
+    gsize n_words, k;
+    guint l;
+
+    g_return_val_if_fail (pyramid != NULL, NULL);
+    g_return_val_if_fail (length != NULL, NULL);
+
+    n_words = PYRAMID_HEADER + 2;
+    for (l = 0; l <= pyramid->depth; l++)
+        n_words += 2 * level_size (l);
+    if (pyramid->order != NULL)
+        n_words += level_size (pyramid->depth) + 1 +
+                   pyramid->offsets[level_size (pyramid->depth)];
+
+    words = g_new (guint32, n_words);
+    words[0] = GUINT32_TO_LE (PYRAMID_MAGIC);
+    words[1] = GUINT32_TO_LE (PYRAMID_VERSION);
+    words[2] = GUINT32_TO_LE (pyramid->depth);
+    words[3] = GUINT32_TO_LE (pyramid->order != NULL ? PYRAMID_SORTED : 0);
+    words[4] = GUINT32_TO_LE (pyramid->n_points & G_MAXUINT32);
+    words[5] = GUINT32_TO_LE (pyramid->n_points >> 32);
+
+    w = words + PYRAMID_HEADER + 2;
+    for (l = 0; l <= pyramid->depth; l++)
+    {
+        for (k = 0; k < level_size (l); k++)
+            *w++ = GUINT32_TO_LE (pyramid->counts[l][k]);
+        for (k = 0; k < level_size (l); k++)
+            *w++ = GUINT32_TO_LE (pyramid->samples[l][k]);
+    }
+    if (pyramid->order != NULL)
+    {
+        for (k = 0; k <= level_size (pyramid->depth); k++)
+            *w++ = GUINT32_TO_LE (pyramid->offsets[k]);
+        for (k = 0; k < pyramid->offsets[level_size (pyramid->depth)]; k++)
+            *w++ = GUINT32_TO_LE (pyramid->order[k]);
+    }
+
+    *length = n_words * sizeof (guint32);
+
+    return words;
+}
+
+gboolean ternary_pyramid_save (TernaryPyramid *pyramid,
+    const gchar *filename, GError **error)
+{
+    guint32 *words;
+    gsize length;
+    gboolean ok;
+
+    g_return_val_if_fail (pyramid != NULL, FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+
+    words = ternary_pyramid_serialize (pyramid, &length);
+    ok = g_file_set_contents (filename, (const gchar *) words, length, error);
+    g_free (words);
+
+    return ok;
+}
+
+/* Reads a serialized pyramid found length bytes into a mapped file. On
+ * little-endian machines the levels and the point order are used in
+ * place, so a deep pyramid costs nothing until its pages are touched; the
+ * pyramid keeps a reference on the mapping. Version 1 pyramids load
+ * without the order. */
+TernaryPyramid *ternary_pyramid_new_from_mapping (GMappedFile *file,
+    gsize offset, gsize length, GError **error)
+{
+    TernaryPyramid *pyramid;
+    const guint32 *words, *offsets = NULL;
+    guint64 n_points;
+    gsize n_words, n_leaves, n_order = 0, k;
+    guint version, depth, l;
+
+    g_return_val_if_fail (file != NULL, NULL);
+    g_return_val_if_fail (offset % sizeof (guint32) == 0, NULL);
+    g_return_val_if_fail (offset + length <= g_mapped_file_get_length (file),
+                          NULL);
+
+    words = (const guint32 *) (g_mapped_file_get_contents (file) + offset);
+
+    if (length < (PYRAMID_HEADER + 2) * sizeof (guint32) ||
+        GUINT32_FROM_LE (words[0]) != PYRAMID_MAGIC ||
+        GUINT32_FROM_LE (words[1]) < 1 ||
+        GUINT32_FROM_LE (words[1]) > PYRAMID_VERSION ||
+        GUINT32_FROM_LE (words[2]) > TERNARY_PYRAMID_MAX_DEPTH)
+    {
+        g_set_error (error, TERNARY_PLOT_ERROR, TERNARY_PLOT_ERROR_INVALID,
+                     "Not a ternary plot pyramid");
+        return NULL;
+    }
+
+    version = GUINT32_FROM_LE (words[1]);
+    depth = GUINT32_FROM_LE (words[2]);
+    n_leaves = level_size (depth);
+    n_words = PYRAMID_HEADER + 2;
+    for (l = 0; l <= depth; l++)
+        n_words += 2 * level_size (l);
+
+    /* the order is as long as the last offset says */
+    if (version >= 2 && GUINT32_FROM_LE (words[3]) & PYRAMID_SORTED)
+    {
+        offsets = words + n_words;
+        n_words += n_leaves + 1;
+        if (length >= n_words * sizeof (guint32))
+            n_order = GUINT32_FROM_LE (offsets[n_leaves]);
+        n_words += n_order;
+    }
+    if (length != n_words * sizeof (guint32))
+    {
+        g_set_error (error, TERNARY_PLOT_ERROR, TERNARY_PLOT_ERROR_INVALID,
+                     "Pyramid is truncated");
+        return NULL;
+    }
+
+    /* leaves index the order in turn */
+    for (k = 0; offsets != NULL && k < n_leaves; k++)
+        if (GUINT32_FROM_LE (offsets[k]) >
+            GUINT32_FROM_LE (offsets[k + 1]))
+        {
+            g_set_error (error, TERNARY_PLOT_ERROR,
+                         TERNARY_PLOT_ERROR_INVALID,
+                         "Pyramid leaf offsets are out of order");
+            return NULL;
+        }
+
+    n_points = GUINT32_FROM_LE (words[4]) |
+               (guint64) GUINT32_FROM_LE (words[5]) << 32;
+    words += PYRAMID_HEADER + 2;
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+    pyramid = g_new0 (TernaryPyramid, 1);
+    pyramid->depth = depth;
+    pyramid->counts = g_new (guint32 *, depth + 1);
+    pyramid->samples = g_new (guint32 *, depth + 1);
+    pyramid->file = g_mapped_file_ref (file);
+    for (l = 0; l <= depth; l++)
+    {
+        pyramid->counts[l] = (guint32 *) words;
+        words += level_size (l);
+        pyramid->samples[l] = (guint32 *) words;
+        words += level_size (l);
+    }
+    if (offsets != NULL)
+    {
+        pyramid->offsets = (guint32 *) offsets;
+        pyramid->order = (guint32 *) offsets + n_leaves + 1;
+    }
+#else
+    pyramid = pyramid_alloc (depth);
+    for (l = 0; l <= depth; l++)
+    {
+        for (k = 0; k < level_size (l); k++)
+            pyramid->counts[l][k] = GUINT32_FROM_LE (*words++);
+        for (k = 0; k < level_size (l); k++)
+            pyramid->samples[l][k] = GUINT32_FROM_LE (*words++);
+    }
+    if (offsets != NULL)
+    {
+        pyramid->offsets = g_new (guint32, n_leaves + 1);
+        pyramid->order = g_new (guint32, MAX (n_order, 1));
+        for (k = 0; k <= n_leaves; k++)
+            pyramid->offsets[k] = GUINT32_FROM_LE (offsets[k]);
+        for (k = 0; k < n_order; k++)
+            pyramid->order[k] = GUINT32_FROM_LE (offsets[n_leaves + 1 + k]);
+    }
+#endif
+    pyramid->n_points = n_points;
+
+    return pyramid;
+}
+
+TernaryPyramid *ternary_pyramid_load (const gchar *filename, GError **error)
+{
+    TernaryPyramid *pyramid;
+    GMappedFile *file;
+    GError *local_error = NULL;
+
+    g_return_val_if_fail (filename != NULL, NULL);
+
+    file = g_mapped_file_new (filename, FALSE, error);
+    if (file == NULL)
+        return NULL;
+
+    pyramid = ternary_pyramid_new_from_mapping (file, 0,
+        g_mapped_file_get_length (file), &local_error);
+    g_mapped_file_unref (file);
+
+    if (local_error != NULL)
+        g_propagate_prefixed_error (error, local_error, "'%s': ", filename);
+
+    return pyramid;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_PYRAMID_H__
+#define __TERNARY_PLOT_PYRAMID_H__
+
+#include <glib.h>
+
+#include "ternaryplot-fixed.h"
+
+G_BEGIN_DECLS
+
+#define TERNARY_PYRAMID_MAX_DEPTH 11 /* 4^11 leaves, 2048 per side */
+
+/* Level of detail quadtree over the simplex. Every node splits into the
+ * 4 triangles cut off by its edge midpoints, so level l is the density
+ * lattice of resolution 2^l and nodes are numbered as its cells. Each
+ * node keeps the number of points in it and the index of one of them,
+ * taken from its most populated child. */
+typedef struct _TernaryPyramid TernaryPyramid;
+
+struct _TernaryPyramid
+{
+    guint depth; /* deepest level, level 0 is the whole simplex */
+    guint64 n_points; /* length of the columns it was built from */
+    guint32 **counts; /* per level, 4^level node counts */
+    guint32 **samples; /* per level, representative point or G_MAXUINT32 */
+    guint32 *order; /* points sorted by leaf, or NULL from version 1 */
+    guint32 *offsets; /* per leaf, where its points start in order */
+    GMappedFile *file; /* mapping the levels point into, or NULL */
+};
+
+TernaryPyramid *ternary_pyramid_new (const gdouble *x, const gdouble *y,
+    const gdouble *z, gsize n, guint depth);
+TernaryPyramid *ternary_pyramid_new_cancellable (const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, guint depth,
+    volatile gint *generation, gint expected);
+void ternary_pyramid_free (TernaryPyramid *pyramid);
+TernaryPyramid *ternary_pyramid_new_fixed (const TernaryFixed *fixed,
+    guint depth);
+guint ternary_pyramid_depth_for (gsize n);
+gint ternary_pyramid_level_for (TernaryPyramid *pyramid, gdouble side,
+    gdouble point_size);
+gboolean ternary_pyramid_save (TernaryPyramid *pyramid,
+    const gchar *filename, GError **error);
+TernaryPyramid *ternary_pyramid_load (const gchar *filename, GError **error);
+guint32 *ternary_pyramid_serialize (TernaryPyramid *pyramid, gsize *length);
+TernaryPyramid *ternary_pyramid_new_from_mapping (GMappedFile *file,
+    gsize offset, gsize length, GError **error);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,309 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <gtk/gtk.h>
+
+#include "ternaryplot-raster.h"
+
+#define RASTER_SLICE 65536 /* points drawn between cancellation checks */
+
+typedef struct _RasterJob RasterJob;
+
+struct _RasterJob
+{
+    gint generation;
+    gint width, height;
+    gboolean build_pyramid;
+    TernaryDataset *dataset; /* to build the pyramid through, or NULL */
+    TernaryRenderState state; /* plot as of the request */
+};
+
+struct _TernaryRaster
+{
+    GRWLock data_lock; /* read while drawing from the plot data */
+    GMutex lock; /* guards the back buffer */
+    GThreadPool *pool; /* one worker, a newer request supersedes */
+    volatile gint generation; /* bumped on invalidation, stale jobs stop */
+    cairo_surface_t *back; /* finished, not swapped in yet */
+    gsize back_points; /* points drawn on it */
+    TernaryPyramid *back_pyramid; /* built for it, or NULL */
+    gint back_generation;
+    guint ready_id; /* pending swap */
+    TernaryRasterReadyFunc ready;
+    gpointer data;
+
+    /* main loop only */
+    gint requested; /* generation last asked for */
+    cairo_surface_t *front; /* shown, possibly stale */
+    gint front_generation;
+    gsize front_points; /* points drawn on it */
+};
+
+static inline gboolean raster_current (TernaryRaster *raster,
+    gint generation)
+{
+    return generation == g_atomic_int_get (&raster->generation);
+}
+
+/* swaps a finished back buffer to the front */
+static gboolean raster_ready (gpointer data)
+{
+    TernaryRaster *raster = data;
+    cairo_surface_t *back;
+    TernaryPyramid *pyramid;
+    gboolean current;
+
+    g_mutex_lock (&raster->lock);
+    back = raster->back;
+    pyramid = raster->back_pyramid;
+    current = raster_current (raster, raster->back_generation);
+    raster->back = NULL;
+    raster->back_pyramid = NULL;
+    raster->ready_id = 0;
+    if (back && current)
+    {
+        if (raster->front)
+            cairo_surface_destroy (raster->front);
+        raster->front = back;
+        raster->front_generation = raster->back_generation;
+        raster->front_points = raster->back_points;
+        back = NULL;
+    }
+    g_mutex_unlock (&raster->lock);
+
+    if (back)
+    {
+        cairo_surface_destroy (back);
+        ternary_pyramid_free (pyramid);
+        return FALSE;
+    }
+
+    raster->ready (pyramid, raster->data);
+
+    return FALSE;
+}
+
+/* Draws a whole layer. Everything done under the data lock checks the
+ * generation as it goes, the pyramid build and the pyramid draw per
+ * chunk and layers without a pyramid per slice, so an invalidation does
+ * not wait for the rest of a long draw. A data set pyramid is built
+ * outside the lock, the job holds the data set and its columns. */
+static void raster_render (gpointer data, gpointer user_data)
+{
+    RasterJob *job = data;
+    TernaryRaster *raster = user_data;
+    TernaryRenderState *state = &job->state;
+    cairo_surface_t *surface = NULL;
+    TernaryPyramid *pyramid = NULL;
+
+    if (job->build_pyramid && job->dataset &&
+        raster_current (raster, job->generation))
+        state->pyramid = ternary_dataset_get_pyramid (job->dataset);
+
+    g_rw_lock_reader_lock (&raster->data_lock);
+
+    state->generation = &raster->generation;
+    state->expected = job->generation;
+    if (job->build_pyramid && !job->dataset &&
+        raster_current (raster, job->generation))
+    {
+        pyramid = ternary_pyramid_new_cancellable (state->xs, state->ys,
+            state->zs, state->n_points,
+            ternary_pyramid_depth_for (state->n_points),
+            &raster->generation, job->generation);
+        state->pyramid = pyramid;
+    }
+
+    if (raster_current (raster, job->generation))
+    {
+        surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                              job->width, job->height);
+        /* a pyramid missing the latest points still draws the rest */
+        if (state->density || (state->pyramid &&
+                               state->pyramid->n_points <= state->n_points))
+            ternary_render_data (state, surface);
+        else
+        {
+            gsize start;
+
+            for (start = 0; start < state->n_points; start += RASTER_SLICE)
+            {
+                if (!raster_current (raster, job->generation))
+                    break;
+                ternary_render_points (state, surface, start,
+                    MIN (start + RASTER_SLICE, state->n_points), NULL);
+            }
+        }
+    }
+
+    g_rw_lock_reader_unlock (&raster->data_lock);
+
+    g_mutex_lock (&raster->lock);
+    if (surface && raster_current (raster, job->generation))
+    {
+        if (raster->back)
+            cairo_surface_destroy (raster->back);
+        ternary_pyramid_free (raster->back_pyramid);
+        raster->back = surface;
+        raster->back_points = state->n_points;
+        raster->back_pyramid = pyramid;
+        raster->back_generation = job->generation;
+        surface = NULL;
+        pyramid = NULL;
+        if (raster->ready_id == 0)
+            raster->ready_id = g_idle_add (raster_ready, raster);
+    }
+    g_mutex_unlock (&raster->lock);
+
+    if (surface)
+        cairo_surface_destroy (surface);
+    ternary_pyramid_free (pyramid);
+    if (job->dataset)
+        g_object_unref (job->dataset);
+    g_free (job);
+}
+
+TernaryRaster *ternary_raster_new (TernaryRasterReadyFunc ready,
+    gpointer data)
+{
+    TernaryRaster *raster;
+
+    raster = g_new0 (TernaryRaster, 1);
+    g_rw_lock_init (&raster->data_lock);
+    g_mutex_init (&raster->lock);
+    raster->pool = g_thread_pool_new (raster_render, raster, 1, FALSE, NULL);
+    raster->requested = -1;
+    raster->ready = ready;
+    raster->data = data;
+
+    return raster;
+}
+
+void ternary_raster_free (TernaryRaster *raster)
+{
+    if (raster == NULL)
+        return;
+
+    /* queued jobs are stale now and finish at once */
+    g_atomic_int_inc (&raster->generation);
+    g_thread_pool_free (raster->pool, FALSE, TRUE);
+
+    if (raster->ready_id)
+        g_source_remove (raster->ready_id);
+    if (raster->back)
+        cairo_surface_destroy (raster->back);
+    ternary_pyramid_free (raster->back_pyramid);
+    if (raster->front)
+        cairo_surface_destroy (raster->front);
+    g_mutex_clear (&raster->lock);
+    g_rw_lock_clear (&raster->data_lock);
+    g_free (raster);
+}
+
+/* Marks the front buffer stale, it stays up until its replacement is
+ * ready. Returns once no worker reads the plot data any more, so the
+ * caller may change or free it afterwards. */
+void ternary_raster_invalidate (TernaryRaster *raster)
+{
+    cairo_surface_t *back;
+    TernaryPyramid *pyramid;
+
+    g_atomic_int_inc (&raster->generation);
+
+    g_rw_lock_writer_lock (&raster->data_lock);
+    g_rw_lock_writer_unlock (&raster->data_lock);
+
+    g_mutex_lock (&raster->lock);
+    back = raster->back;
+    pyramid = raster->back_pyramid;
+    raster->back = NULL;
+    raster->back_pyramid = NULL;
+    g_mutex_unlock (&raster->lock);
+
+    if (back)
+        cairo_surface_destroy (back);
+    ternary_pyramid_free (pyramid);
+}
+
+/* Paints the front buffer, asking for a new one first if it is stale.
+ * Points appended since the front was drawn are added to it here. */
+void ternary_raster_paint (TernaryRaster *raster, TernaryRenderState *state,
+    cairo_t *cr, gint width, gint height, gboolean build_pyramid,
+    TernaryDataset *dataset)
+{
+    gboolean current;
+
+    current = raster->front && raster_current (raster, raster->front_generation);
+    if (!current && !raster_current (raster, raster->requested))
+    {
+        RasterJob *job;
+
+        raster->requested = g_atomic_int_get (&raster->generation);
+
+        job = g_new (RasterJob, 1);
+        job->generation = raster->requested;
+        job->width = width;
+        job->height = height;
+        job->build_pyramid = build_pyramid;
+        job->dataset = dataset ? g_object_ref (dataset) : NULL;
+        job->state = *state;
+        g_thread_pool_push (raster->pool, job, NULL);
+    }
+
+    if (raster->front == NULL ||
+        cairo_image_surface_get_width (raster->front) != width ||
+        cairo_image_surface_get_height (raster->front) != height)
+        return;
+
+    if (current)
+        ternary_raster_append (raster, state, NULL);
+
+    cairo_set_source_surface (cr, raster->front, 0, 0);
+    cairo_paint (cr);
+}
+
+/* Whether the front buffer is up to date, the points appended since it
+ * was drawn aside. */
+gboolean ternary_raster_is_current (TernaryRaster *raster)
+{
+    return raster->front && raster_current (raster, raster->front_generation);
+}
+
+/* Draws the points appended since the front buffer was drawn onto it,
+ * growing damage to cover them. Returns FALSE if the front is stale and
+ * has to be redrawn instead. */
+gboolean ternary_raster_append (TernaryRaster *raster,
+    TernaryRenderState *state, GdkRectangle *damage)
+{
+    if (damage)
+        damage->width = damage->height = 0;
+
+    if (raster->front == NULL || state->density ||
+        !raster_current (raster, raster->front_generation))
+        return FALSE;
+
+    if (raster->front_points < state->n_points)
+    {
+        ternary_render_points (state, raster->front, raster->front_points,
+                               state->n_points, damage);
+        raster->front_points = state->n_points;
+    }
+
+    return TRUE;
+}
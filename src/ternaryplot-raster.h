@@ -0,0 +1,55 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_RASTER_H__
+#define __TERNARY_PLOT_RASTER_H__
+
+#include <gtk/gtk.h>
+
+#include "ternaryplot-dataset.h"
+#include "ternaryplot-render.h"
+
+G_BEGIN_DECLS
+
+/* Data layer of the full view, drawn by a background worker into a back
+ * buffer that is swapped to the front on the main loop when done. Until
+ * then the previous front buffer keeps being shown if it still has the
+ * right size, so a slow layer never holds up the main loop. */
+typedef struct _TernaryRaster TernaryRaster;
+
+/* Called on the main loop when a new front buffer is up, with the
+ * pyramid the worker built for it, if asked to, for the callee to own.
+ * Pyramids built through a data set stay with it and are not passed. */
+typedef void (*TernaryRasterReadyFunc) (TernaryPyramid *pyramid,
+    gpointer data);
+
+TernaryRaster *ternary_raster_new (TernaryRasterReadyFunc ready,
+    gpointer data);
+void ternary_raster_free (TernaryRaster *raster);
+void ternary_raster_invalidate (TernaryRaster *raster);
+void ternary_raster_paint (TernaryRaster *raster, TernaryRenderState *state,
+    cairo_t *cr, gint width, gint height, gboolean build_pyramid,
+    TernaryDataset *dataset);
+gboolean ternary_raster_append (TernaryRaster *raster,
+    TernaryRenderState *state, GdkRectangle *damage);
+gboolean ternary_raster_is_current (TernaryRaster *raster);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,1022 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <gtk/gtk.h>
+#include <cairo-pdf.h>
+#include <cairo-svg.h>
+#include <math.h>
+#include <string.h>
+
+#include "ternaryplot.h"
+#include "ternaryplot-render.h"
+
+#define POINT_SIZE 2 /* scatter marker size in pixels */
+#define POINT_SIZE_MAX 32 /* largest per point marker size */
+#define POINT_COLOR 0xff202020 /* scatter marker color, ARGB32 */
+#define POINT_CHUNK 1024 /* points projected per kernel call */
+#define SELECTED_SIZE 4 /* selected marker size in pixels */
+#define SELECTED_COLOR 0xffff7f0e /* selected marker color, ARGB32 */
+#define SUMMARY_VERTICES 96 /* points along the spread ellipse */
+#define SUMMARY_CROSS 5 /* half width of the centre mark in pixels */
+
+/* Full simplex view, 10% grid and nothing else set. */
+void ternary_render_state_init (TernaryRenderState *state)
+{
+    memset (state, 0, sizeof (*state));
+    state->grid_step = 0.1;
+    state->view_side = 1.0;
+    state->colormap = ternary_colormap_get_lut (TERNARY_COLORMAP_VIRIDIS);
+    state->value_max = 1.0;
+    state->ellipse_level = 0.95;
+}
+
+/* Lays the triangle out in the given rectangle, leaving room for the
+ * bottom label, and derives the pixel <-> barycentric transforms. The
+ * triangle shows the visible sub-triangle of the simplex. */
+void ternary_render_set_geometry (TernaryRenderState *state,
+    gdouble x, gdouble y, gdouble width, gdouble height)
+{
+    gdouble xc, yc, s;
+
+    /* radius and center */
+    state->radius = (MIN (width, (height - 15) / sin (M_PI / 3)) - 5)*
+                    sin (M_PI / 3) * 2 / 3;
+    xc = x + (gint) width / 2;
+    yc = y + (gint) (height - 15) * 2 / 3;
+
+    /* vertices */
+    state->x1 = xc + state->radius * 0; /* cos (-M_PI/2) */
+    state->y1 = yc + state->radius * -1; /* sin (-M_PI/2) */
+    state->x2 = xc + state->radius * sqrt (3)/2; /* cos (-11*M_PI/6) */
+    state->y2 = yc + state->radius * 0.5; /* sin (-11*M_PI/6) */
+    state->x3 = xc + state->radius * -sqrt (3)/2; /* cos (-7*M_PI/6) */
+    state->y3 = yc + state->radius * 0.5; /* sin (-7*M_PI/6) */
+
+    /* pixel = x' * v1 + y' * v2 + (1 - x' - y') * v3 in view coordinates
+     * x' = (x - view_x) / view_side, y' = (y - view_y) / view_side */
+    s = state->view_side;
+    state->forward.xx = (state->x1 - state->x3) / s;
+    state->forward.xy = (state->x2 - state->x3) / s;
+    state->forward.x0 = state->x3 - state->forward.xx * state->view_x -
+                        state->forward.xy * state->view_y;
+    state->forward.yx = (state->y1 - state->y3) / s;
+    state->forward.yy = (state->y2 - state->y3) / s;
+    state->forward.y0 = state->y3 - state->forward.yx * state->view_x -
+                        state->forward.yy * state->view_y;
+    if (!ternary_affine_invert (&state->forward, &state->inverse))
+        memset (&state->inverse, 0, sizeof (state->inverse));
+}
+
+/* Grid step in a zoomed view: the 1, 2, 5 series value that keeps about
+ * as many lines across the view as the grid step gives on the simplex. */
+static gdouble view_grid_step (TernaryRenderState *state)
+{
+    gdouble target, step;
+
+    target = state->grid_step * state->view_side;
+    step = pow (10, floor (log10 (target)));
+    if (5 * step <= target)
+        step *= 5;
+    else if (2 * step <= target)
+        step *= 2;
+
+    return step;
+}
+
+/* Lines of constant x, y and z across a zoomed view, end to end. */
+static void draw_view_grid (TernaryRenderState *state, cairo_t *cr)
+{
+    gdouble a, b, c, step, v, px, py;
+    gint k;
+
+    a = state->view_x;
+    b = state->view_y;
+    c = state->view_z;
+    step = view_grid_step (state);
+
+    for (k = (gint) floor (a / step) + 1; (v = k * step) < 1.0 - b - c; k++)
+    {
+        ternary_render_to_pixel (state, v, b, &px, &py);
+        cairo_move_to (cr, px, py);
+        ternary_render_to_pixel (state, v, 1.0 - v - c, &px, &py);
+        cairo_line_to (cr, px, py);
+    }
+    for (k = (gint) floor (b / step) + 1; (v = k * step) < 1.0 - a - c; k++)
+    {
+        ternary_render_to_pixel (state, a, v, &px, &py);
+        cairo_move_to (cr, px, py);
+        ternary_render_to_pixel (state, 1.0 - v - c, v, &px, &py);
+        cairo_line_to (cr, px, py);
+    }
+    for (k = (gint) floor (c / step) + 1; (v = k * step) < 1.0 - a - b; k++)
+    {
+        ternary_render_to_pixel (state, a, 1.0 - v - a, &px, &py);
+        cairo_move_to (cr, px, py);
+        ternary_render_to_pixel (state, 1.0 - v - b, b, &px, &py);
+        cairo_line_to (cr, px, py);
+    }
+    cairo_stroke (cr);
+}
+
+/* Outline of the visible triangle as the current path. */
+void ternary_render_view_path (TernaryRenderState *state, cairo_t *cr)
+{
+    cairo_move_to (cr, state->x1, state->y1);
+    cairo_line_to (cr, state->x2, state->y2);
+    cairo_line_to (cr, state->x3, state->y3);
+    cairo_close_path (cr);
+}
+
+void ternary_render_field (TernaryRenderState *state, cairo_t *cr)
+{
+    gdouble frac;
+
+    /* large triangle */
+    cairo_move_to (cr, state->x1, state->y1);
+    cairo_line_to (cr, state->x2, state->y2);
+    cairo_line_to (cr, state->x3, state->y3);
+    cairo_close_path (cr);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_fill_preserve (cr);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_stroke (cr);
+
+    cairo_save (cr); /* stack-pen-size */
+
+    /* 10% lines */
+    cairo_set_line_width (cr, 0.25 * cairo_get_line_width (cr));
+    cairo_set_source_rgb (cr, .8, .8, .8);
+
+    if (state->view_side < 1.0)
+    {
+        draw_view_grid (state, cr);
+        cairo_restore (cr); /* stack-pen-size */
+        return;
+    }
+
+    /* small triangle */
+    cairo_move_to (cr, (state->x1+state->x2)/2, (state->y1+state->y2)/2);
+    cairo_line_to (cr, (state->x2+state->x3)/2, (state->y2+state->y3)/2);
+    cairo_line_to (cr, (state->x3+state->x1)/2, (state->y3+state->y1)/2);
+    cairo_close_path(cr);
+    cairo_stroke (cr);
+
+    for (frac = state->grid_step; frac < 0.5; frac += state->grid_step)
+    {
+        cairo_move_to (cr, frac*state->x1 + (1-frac)*state->x2, frac*state->y1 + (1-frac)*state->y2);
+        cairo_line_to (cr, (1-frac)*state->x2 + frac*state->x3, (1-frac)*state->y2 + frac*state->y3);
+        cairo_line_to (cr, frac*state->x3 + (1-frac)*state->x1, frac*state->y3 + (1-frac)*state->y1);
+        cairo_line_to (cr, (1-frac)*state->x1 + frac*state->x2, (1-frac)*state->y1 + frac*state->y2);
+        cairo_line_to (cr, frac*state->x2 + (1-frac)*state->x3, frac*state->y2 + (1-frac)*state->y3);
+        cairo_line_to (cr, (1-frac)*state->x3 + frac*state->x1, (1-frac)*state->y3 + frac*state->y1);
+        cairo_close_path(cr);
+        cairo_stroke (cr);
+    }
+    cairo_restore (cr); /* stack-pen-size */
+}
+
+static void rectangle_from_points (GdkRectangle *rect,
+    const gdouble *xs, const gdouble *ys, gint n, gdouble pad)
+{
+    gdouble left, top, right, bottom;
+    gint i;
+
+    left = right = xs[0];
+    top = bottom = ys[0];
+    for (i = 1; i < n; i++)
+    {
+        left = MIN (left, xs[i]);
+        right = MAX (right, xs[i]);
+        top = MIN (top, ys[i]);
+        bottom = MAX (bottom, ys[i]);
+    }
+
+    rect->x = floor (left - pad);
+    rect->y = floor (top - pad);
+    rect->width = ceil (right + pad) - rect->x;
+    rect->height = ceil (bottom + pad) - rect->y;
+}
+
+static void draw_label (cairo_t *cr, const TernaryGlyphs *glyphs,
+    const TernaryGlyphRun *label, gdouble fraction,
+    gdouble x, gdouble y, gdouble angle, GdkRectangle *bounds)
+{
+    const TernaryGlyphRun *percent;
+    gdouble cx[4], cy[4];
+    gint i;
+
+    percent = ternary_glyphs_percent (glyphs, fraction);
+
+    cairo_save (cr);
+    cairo_translate (cr, x, y);
+    cairo_rotate (cr, angle);
+    cairo_translate (cr, (-label->extents.width - glyphs->percent_width)/2,
+                     angle == 0.0 ?
+                     (label->extents.height + 2) :
+                     (-label->extents.height - label->extents.y_bearing - 2));
+
+    /* device space box of the widest possible label, for damage tracking */
+    cx[0] = cx[3] = 0;
+    cx[1] = cx[2] = label->extents.x_advance + glyphs->percent_width;
+    cy[0] = cy[1] = -glyphs->font_extents.ascent;
+    cy[2] = cy[3] = glyphs->font_extents.descent;
+    for (i = 0; i < 4; i++)
+        cairo_user_to_device (cr, &cx[i], &cy[i]);
+    rectangle_from_points (bounds, cx, cy, 4, 2);
+
+    cairo_show_glyphs (cr, label->glyphs, label->n_glyphs);
+    cairo_translate (cr, label->extents.x_advance, 0);
+    cairo_show_glyphs (cr, percent->glyphs, percent->n_glyphs);
+    cairo_restore (cr);
+}
+
+/* Draws the labels from pre-shaped glyph runs; a state without a glyph
+ * cache, such as a one-off headless render, gets a temporary one. */
+void ternary_render_labels (TernaryRenderState *state, cairo_t *cr)
+{
+    TernaryGlyphs *glyphs;
+
+    glyphs = state->glyphs;
+    if (glyphs == NULL)
+    {
+        glyphs = ternary_glyphs_new ();
+        ternary_glyphs_set_label (glyphs, 0, state->xlabel);
+        ternary_glyphs_set_label (glyphs, 1, state->ylabel);
+        ternary_glyphs_set_label (glyphs, 2, state->zlabel);
+    }
+
+    cairo_set_scaled_font (cr, glyphs->font);
+
+    draw_label (cr, glyphs, &glyphs->labels[0], state->x,
+                (state->x2 + state->x3) / 2, (state->y2 + state->y3) / 2, 0.0,
+                &state->label_bounds[0]);
+    draw_label (cr, glyphs, &glyphs->labels[1], state->y,
+                (state->x1 + state->x3) / 2, (state->y1 + state->y3) / 2, -M_PI / 3,
+                &state->label_bounds[1]);
+    draw_label (cr, glyphs, &glyphs->labels[2], state->z,
+                (state->x1 + state->x2) / 2, (state->y1 + state->y2) / 2, M_PI / 3,
+                &state->label_bounds[2]);
+
+    if (glyphs != state->glyphs)
+        ternary_glyphs_free (glyphs);
+}
+
+/* current value relative to the visible triangle */
+static void view_value (TernaryRenderState *state,
+    gdouble *u, gdouble *v, gdouble *w)
+{
+    *u = (state->x - state->view_x) / state->view_side;
+    *v = (state->y - state->view_y) / state->view_side;
+    *w = (state->z - state->view_z) / state->view_side;
+}
+
+void ternary_render_pointer_bounds (TernaryRenderState *state,
+    GdkRectangle *bounds)
+{
+    gdouble px, py, u, v, w;
+    gdouble xs[5], ys[5];
+
+    ternary_render_to_pixel (state, state->x, state->y, &px, &py);
+    view_value (state, &u, &v, &w);
+
+    /* pointer circle and the feet of the three altitudes */
+    xs[0] = px - TERNARY_RENDER_POINTER_RADIUS;
+    ys[0] = py - TERNARY_RENDER_POINTER_RADIUS;
+    xs[1] = px + TERNARY_RENDER_POINTER_RADIUS;
+    ys[1] = py + TERNARY_RENDER_POINTER_RADIUS;
+    xs[2] = px + u * ((state->x2 + state->x3) / 2 - state->x1);
+    ys[2] = py + u * ((state->y2 + state->y3) / 2 - state->y1);
+    xs[3] = px + v * ((state->x1 + state->x3) / 2 - state->x2);
+    ys[3] = py + v * ((state->y1 + state->y3) / 2 - state->y2);
+    xs[4] = px + w * ((state->x1 + state->x2) / 2 - state->x3);
+    ys[4] = py + w * ((state->y1 + state->y2) / 2 - state->y3);
+
+    /* pad by the default line width */
+    rectangle_from_points (bounds, xs, ys, 5, 2);
+}
+
+/* Pixel positions of the spread ellipse, followed by the centre. The
+ * ellipse is left out, and the centre comes first, with fewer than two
+ * points summarized. Returns how many positions were filled. */
+static guint summary_points (TernaryRenderState *state, gdouble *px,
+    gdouble *py)
+{
+    gdouble x[SUMMARY_VERTICES + 1], y[SUMMARY_VERTICES + 1], z;
+    guint n = 0;
+
+    if (state->composition == NULL ||
+        !ternary_composition_get_centre (state->composition, &x[0], &y[0], &z))
+        return 0;
+
+    if (ternary_composition_ellipse (state->composition, state->ellipse_level,
+                                     x, y, SUMMARY_VERTICES))
+    {
+        ternary_composition_get_centre (state->composition,
+            &x[SUMMARY_VERTICES], &y[SUMMARY_VERTICES], &z);
+        n = SUMMARY_VERTICES;
+    }
+
+    ternary_kernels_affine (&state->forward, x, y, px, py, NULL, n + 1);
+    return n + 1;
+}
+
+/* Draws the geometric mean centre of the points as a cross and the
+ * ellipse holding state->ellipse_level of them around it. Both come
+ * from the running summary, so drawing never visits the points. */
+void ternary_render_summary (TernaryRenderState *state, cairo_t *cr)
+{
+    gdouble px[SUMMARY_VERTICES + 1], py[SUMMARY_VERTICES + 1];
+    guint n, i;
+
+    n = summary_points (state, px, py);
+    if (n == 0)
+        return;
+
+    cairo_save (cr);
+
+    if (state->view_side < 1.0)
+    {
+        ternary_render_view_path (state, cr);
+        cairo_clip (cr);
+    }
+
+    cairo_set_source_rgb (cr, 0.0, 0.4, 0.2);
+    cairo_set_line_width (cr, 1.5);
+    cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+    cairo_new_path (cr);
+    for (i = 0; i + 1 < n; i++)
+        cairo_line_to (cr, px[i], py[i]);
+    cairo_close_path (cr);
+
+    /* centre */
+    cairo_move_to (cr, px[n - 1] - SUMMARY_CROSS, py[n - 1]);
+    cairo_line_to (cr, px[n - 1] + SUMMARY_CROSS, py[n - 1]);
+    cairo_move_to (cr, px[n - 1], py[n - 1] - SUMMARY_CROSS);
+    cairo_line_to (cr, px[n - 1], py[n - 1] + SUMMARY_CROSS);
+    cairo_stroke (cr);
+
+    cairo_restore (cr);
+}
+
+/* FALSE when there is no summary to draw */
+gboolean ternary_render_summary_bounds (TernaryRenderState *state,
+    GdkRectangle *bounds)
+{
+    gdouble px[SUMMARY_VERTICES + 3], py[SUMMARY_VERTICES + 3];
+    guint n;
+
+    n = summary_points (state, px, py);
+    if (n == 0)
+        return FALSE;
+
+    px[n] = px[n - 1] - SUMMARY_CROSS;
+    py[n] = py[n - 1] - SUMMARY_CROSS;
+    px[n + 1] = px[n - 1] + SUMMARY_CROSS;
+    py[n + 1] = py[n - 1] + SUMMARY_CROSS;
+
+    /* pad by the line width */
+    rectangle_from_points (bounds, px, py, n + 2, 2);
+    return TRUE;
+}
+
+/* Strokes the trajectory between samples [start, end), clipped to the
+ * visible part of the simplex. */
+void ternary_render_trajectory (TernaryRenderState *state, cairo_t *cr,
+    gsize start, gsize end)
+{
+    if (state->trajectory == NULL)
+        return;
+
+    cairo_save (cr);
+    if (state->view_side < 1.0)
+    {
+        ternary_render_view_path (state, cr);
+        cairo_clip (cr);
+    }
+    ternary_trajectory_stroke (state->trajectory, &state->forward, cr,
+                               start, end);
+    cairo_restore (cr);
+}
+
+/* Strokes the cached isolines through the plot transform, the densest
+ * darkest. The paths are appended under the transform, so the line
+ * width stays in pixels. */
+void ternary_render_contours (TernaryRenderState *state, cairo_t *cr)
+{
+    cairo_matrix_t matrix;
+    guint l;
+
+    if (state->contours == NULL)
+        return;
+
+    cairo_save (cr);
+
+    if (state->view_side < 1.0)
+    {
+        ternary_render_view_path (state, cr);
+        cairo_clip (cr);
+    }
+
+    cairo_matrix_init (&matrix, state->forward.xx, state->forward.yx,
+                       state->forward.xy, state->forward.yy,
+                       state->forward.x0, state->forward.y0);
+    cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
+    cairo_set_line_width (cr, 1.5);
+
+    for (l = 0; l < TERNARY_CONTOURS_N_LEVELS; l++)
+    {
+        if (state->contours->paths[l] == NULL)
+            continue;
+
+        cairo_save (cr);
+        cairo_transform (cr, &matrix);
+        cairo_new_path (cr);
+        cairo_append_path (cr, state->contours->paths[l]);
+        cairo_restore (cr);
+
+        cairo_set_source_rgba (cr, 0.1, 0.2, 0.6,
+                               (l + 1.0) / TERNARY_CONTOURS_N_LEVELS);
+        cairo_stroke (cr);
+    }
+
+    cairo_restore (cr);
+}
+
+void ternary_render_pointer (TernaryRenderState *state, cairo_t *cr)
+{
+    gdouble px, py, u, v, w;
+
+    cairo_save (cr);
+
+    /* a zoomed view may leave the pointer outside */
+    if (state->view_side < 1.0)
+    {
+        ternary_render_view_path (state, cr);
+        cairo_clip (cr);
+    }
+
+    /* altitudes */
+    ternary_render_to_pixel (state, state->x, state->y, &px, &py);
+    view_value (state, &u, &v, &w);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_move_to (cr,
+        px + u * ((state->x2 + state->x3) / 2 - state->x1),
+        py + u * ((state->y2 + state->y3) / 2 - state->y1));
+    cairo_line_to (cr, px, py);
+    cairo_rel_line_to (cr,
+        v * ((state->x1 + state->x3) / 2 - state->x2),
+        v * ((state->y1 + state->y3) / 2 - state->y2));
+    cairo_stroke (cr);
+    cairo_move_to (cr, px, py);
+    cairo_rel_line_to (cr,
+        w * ((state->x1 + state->x2) / 2 - state->x3),
+        w * ((state->y1 + state->y2) / 2 - state->y3));
+    cairo_stroke (cr);
+
+    /* pointer */
+    cairo_arc (cr, px, py, TERNARY_RENDER_POINTER_RADIUS, 0, 2 * M_PI);
+    cairo_close_path(cr);
+    cairo_set_source_rgb (cr, 0.8, 0.8, 0.8);
+    cairo_fill_preserve (cr);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_stroke (cr);
+
+    cairo_restore (cr);
+}
+
+/* Packs the colours of points [start, start + n) for plot_markers, or
+ * returns NULL when they all get the default. */
+static const guint32 *chunk_colors (TernaryRenderState *state,
+    gsize start, gsize n, guint32 *colors)
+{
+    gsize i, m;
+
+    if (state->values == NULL || start >= state->n_values)
+        return NULL;
+
+    m = MIN (n, state->n_values - start);
+    ternary_kernels_lookup (state->colormap, TERNARY_COLORMAP_SIZE,
+        state->value_min, state->value_max, state->values + start, colors,
+        POINT_COLOR, m);
+    for (i = m; i < n; i++)
+        colors[i] = POINT_COLOR;
+
+    return colors;
+}
+
+/* the same for marker sizes */
+static const gdouble *chunk_sizes (TernaryRenderState *state,
+    gsize start, gsize n, gdouble *sizes)
+{
+    gsize i, m;
+
+    if (state->sizes == NULL || start >= state->n_sizes)
+        return NULL;
+
+    m = MIN (n, state->n_sizes - start);
+    if (m == n)
+        return state->sizes + start;
+    for (i = 0; i < n; i++)
+        sizes[i] = i < m ? state->sizes[start + i] : POINT_SIZE;
+
+    return sizes;
+}
+
+/* Plots n markers at pixel positions straight into the image buffer,
+ * with no path construction per point, growing box to cover them.
+ * Colours and sizes are per marker when given, packed beforehand so
+ * the loop does no lookups of its own. */
+static void plot_markers (guint32 *pixels, gint width, gint height,
+    gint stride, const gdouble *px, const gdouble *py,
+    const guint32 *colors, const gdouble *sizes, gsize n, gint *box)
+{
+    gsize j;
+
+    for (j = 0; j < n; j++)
+    {
+        gint ix, iy, dx, dy, size = POINT_SIZE;
+        guint32 color = colors ? colors[j] : POINT_COLOR;
+
+        /* sizes below a pixel and NaNs keep the default */
+        if (sizes && sizes[j] >= 1.0)
+            size = (gint) MIN (sizes[j] + 0.5, POINT_SIZE_MAX);
+
+        /* markers may reach in from just outside, as on tile edges;
+         * also rejects NaNs left by zero-sum compositions */
+        if (!(px[j] > -size && py[j] > -size &&
+              px[j] < width + size && py[j] < height + size))
+            continue;
+
+        ix = (gint) floor (px[j]) - size / 2;
+        iy = (gint) floor (py[j]) - size / 2;
+        if (ix + size <= 0 || iy + size <= 0 || ix >= width || iy >= height)
+            continue;
+        for (dy = MAX (iy, 0); dy < MIN (iy + size, height); dy++)
+            for (dx = MAX (ix, 0); dx < MIN (ix + size, width); dx++)
+                pixels[dy * stride + dx] = color;
+
+        box[0] = MIN (box[0], ix);
+        box[1] = MIN (box[1], iy);
+        box[2] = MAX (box[2], ix + size);
+        box[3] = MAX (box[3], iy + size);
+    }
+}
+
+/* projects and plots n gathered samples */
+static void plot_samples (TernaryRenderState *state, const gdouble *x,
+    const gdouble *y, const gdouble *values, const gdouble *sizes,
+    guint32 *colors, gdouble *px, gdouble *py, gsize n,
+    guint32 *pixels, gint width, gint height, gint stride, gint *box)
+{
+    if (state->values)
+        ternary_kernels_lookup (state->colormap, TERNARY_COLORMAP_SIZE,
+            state->value_min, state->value_max, values, colors,
+            POINT_COLOR, n);
+
+    ternary_kernels_affine (&state->forward, x, y, px, py, NULL, n);
+    plot_markers (pixels, width, height, stride, px, py,
+                  state->values ? colors : NULL,
+                  state->sizes ? sizes : NULL, n, box);
+}
+
+/* Adds point p to the chunk being gathered, plotting the chunk once it
+ * is full. Indices past the data, as a corrupt pyramid file may hold,
+ * are skipped. */
+static void gather_point (TernaryRenderState *state, guint32 p,
+    gdouble *x, gdouble *y, gdouble *values, gdouble *sizes, gsize *n,
+    guint32 *pixels, gint width, gint height, gint stride, gint *box)
+{
+    guint32 colors[POINT_CHUNK];
+    gdouble px[POINT_CHUNK], py[POINT_CHUNK];
+
+    if (p >= state->n_points)
+        return;
+
+    if (state->fixed)
+    {
+        gdouble z;
+
+        ternary_fixed_get (state->fixed, p, &x[*n], &y[*n], &z);
+    }
+    else
+    {
+        x[*n] = state->xs[p];
+        y[*n] = state->ys[p];
+    }
+    /* NaN stands for the defaults */
+    values[*n] = p < state->n_values ? state->values[p] : NAN;
+    sizes[*n] = p < state->n_sizes ? state->sizes[p] : NAN;
+    if (++*n == POINT_CHUNK)
+    {
+        plot_samples (state, x, y, values, sizes, colors, px, py, *n,
+                      pixels, width, height, stride, box);
+        *n = 0;
+    }
+}
+
+/* plots what is left of a chunk */
+static void flush_points (TernaryRenderState *state, gdouble *x,
+    gdouble *y, gdouble *values, gdouble *sizes, gsize n,
+    guint32 *pixels, gint width, gint height, gint stride, gint *box)
+{
+    guint32 colors[POINT_CHUNK];
+    gdouble px[POINT_CHUNK], py[POINT_CHUNK];
+
+    if (n > 0)
+        plot_samples (state, x, y, values, sizes, colors, px, py, n,
+                      pixels, width, height, stride, box);
+}
+
+/* a background worker asked to drop the draw */
+static inline gboolean render_cancelled (TernaryRenderState *state)
+{
+    return state->generation &&
+           g_atomic_int_get (state->generation) != state->expected;
+}
+
+/* lattice row or column holding coordinate v, clamped to [0, n) */
+static gint lattice_row (gdouble v, gint n)
+{
+    v = floor (v * n);
+
+    return (gint) CLAMP (v, 0, n - 1);
+}
+
+/* Finds the squares of the lattice of the given resolution under a
+ * surface: the pixel bounds, widened by the largest marker, are taken
+ * back to the simplex and range is set to the first and last row and
+ * column they cover. Returns FALSE when the surface shows none. */
+static gboolean visible_squares (TernaryRenderState *state, gint width,
+    gint height, gint resolution, gint *range)
+{
+    const TernaryAffine *inverse = &state->inverse;
+    gdouble xmin = G_MAXDOUBLE, xmax = -G_MAXDOUBLE;
+    gdouble ymin = G_MAXDOUBLE, ymax = -G_MAXDOUBLE;
+    gint k;
+
+    for (k = 0; k < 4; k++)
+    {
+        gdouble px, py, bx, by;
+
+        px = k % 2 ? width + POINT_SIZE_MAX : -POINT_SIZE_MAX;
+        py = k / 2 ? height + POINT_SIZE_MAX : -POINT_SIZE_MAX;
+        bx = inverse->xx * px + inverse->xy * py + inverse->x0;
+        by = inverse->yx * px + inverse->yy * py + inverse->y0;
+        xmin = MIN (xmin, bx);
+        xmax = MAX (xmax, bx);
+        ymin = MIN (ymin, by);
+        ymax = MAX (ymax, by);
+    }
+    if (!(xmax >= 0 && ymax >= 0 && xmin <= 1 && ymin <= 1))
+        return FALSE;
+
+    range[0] = lattice_row (xmin, resolution);
+    range[1] = lattice_row (xmax, resolution);
+    range[2] = lattice_row (ymin, resolution);
+    range[3] = lattice_row (ymax, resolution);
+
+    return TRUE;
+}
+
+/* Cells of square (i, j): the upward triangle, and the downward one
+ * next to it unless the square is on the diagonal. */
+static inline gsize square_cells (gint resolution, gint i, gint j,
+    gsize *cell)
+{
+    *cell = (gsize) i * (2 * resolution - i) + 2 * j;
+
+    return j < resolution - 1 - i ? 2 : 1;
+}
+
+/* Plots one representative point per occupied pyramid node at the given
+ * level that the surface shows, so the cost follows the number of nodes
+ * in view, not of points. */
+static void plot_level (TernaryRenderState *state, guint level,
+    guint32 *pixels, gint width, gint height, gint stride, gint *box)
+{
+    const guint32 *counts, *samples;
+    gdouble x[POINT_CHUNK], y[POINT_CHUNK];
+    gdouble values[POINT_CHUNK], sizes[POINT_CHUNK];
+    gint resolution, range[4], i, j;
+    gsize n = 0;
+
+    resolution = 1 << level;
+    if (!visible_squares (state, width, height, resolution, range))
+        return;
+
+    counts = state->pyramid->counts[level];
+    samples = state->pyramid->samples[level];
+    for (i = range[0]; i <= range[1] && !render_cancelled (state); i++)
+        for (j = range[2]; j <= MIN (range[3], resolution - 1 - i); j++)
+        {
+            gsize cell, c, n_cells;
+
+            n_cells = square_cells (resolution, i, j, &cell);
+            for (c = cell; c < cell + n_cells; c++)
+                if (counts[c] > 0)
+                    gather_point (state, samples[c], x, y, values, sizes,
+                                  &n, pixels, width, height, stride, box);
+        }
+
+    flush_points (state, x, y, values, sizes, n, pixels, width, height,
+                  stride, box);
+}
+
+/* Plots every point of the leaves the surface shows, for views zoomed in
+ * past the leaves. */
+static void plot_leaves (TernaryRenderState *state, guint32 *pixels,
+    gint width, gint height, gint stride, gint *box)
+{
+    TernaryPyramid *pyramid = state->pyramid;
+    gdouble x[POINT_CHUNK], y[POINT_CHUNK];
+    gdouble values[POINT_CHUNK], sizes[POINT_CHUNK];
+    gint resolution, range[4], i, j;
+    gsize n = 0;
+
+    resolution = 1 << pyramid->depth;
+    if (!visible_squares (state, width, height, resolution, range))
+        return;
+
+    for (i = range[0]; i <= range[1] && !render_cancelled (state); i++)
+        for (j = range[2]; j <= MIN (range[3], resolution - 1 - i); j++)
+        {
+            guint32 o, last;
+            gsize cell, n_cells;
+
+            /* the cells of a square are next to each other in order */
+            n_cells = square_cells (resolution, i, j, &cell);
+            last = pyramid->offsets[cell + n_cells];
+            for (o = pyramid->offsets[cell]; o < last; o++)
+                gather_point (state, pyramid->order[o], x, y, values, sizes,
+                              &n, pixels, width, height, stride, box);
+        }
+
+    flush_points (state, x, y, values, sizes, n, pixels, width, height,
+                  stride, box);
+}
+
+/* Plots every point of [start, end), projected a chunk at a time. */
+static void plot_range (TernaryRenderState *state, gsize start, gsize end,
+    guint32 *pixels, gint width, gint height, gint stride, gint *box)
+{
+    gsize i;
+
+    for (i = start; i < end && !render_cancelled (state); i += POINT_CHUNK)
+    {
+        gdouble px[POINT_CHUNK], py[POINT_CHUNK];
+        gdouble sizes[POINT_CHUNK];
+        guint32 colors[POINT_CHUNK];
+        gsize n;
+
+        n = MIN (POINT_CHUNK, end - i);
+        if (state->fixed)
+            ternary_fixed_affine (state->fixed, &state->forward, i, n,
+                                  px, py);
+        else
+            ternary_kernels_affine (&state->forward, state->xs + i,
+                state->ys + i, px, py, NULL, n);
+        plot_markers (pixels, width, height, stride, px, py,
+                      chunk_colors (state, i, n, colors),
+                      chunk_sizes (state, i, n, sizes), n, box);
+    }
+}
+
+/* Draws the markers of points [start, end). From the first point on, a
+ * pyramid stands in for the points it was built from, and the points
+ * appended since are drawn one by one after it. */
+void ternary_render_points (TernaryRenderState *state,
+    cairo_surface_t *surface, gsize start, gsize end, GdkRectangle *damage)
+{
+    TernaryPyramid *pyramid = state->pyramid;
+    guint32 *pixels;
+    gint width, height, stride;
+    gint box[4];
+    gint level;
+
+    cairo_surface_flush (surface);
+    pixels = (guint32 *) cairo_image_surface_get_data (surface);
+    width = cairo_image_surface_get_width (surface);
+    height = cairo_image_surface_get_height (surface);
+    stride = cairo_image_surface_get_stride (surface) / sizeof (guint32);
+
+    box[0] = width;
+    box[1] = height;
+    box[2] = box[3] = 0;
+
+    if (pyramid && start == 0 && pyramid->n_points <= end)
+    {
+        level = ternary_pyramid_level_for (pyramid,
+            state->radius * sqrt (3) / state->view_side, POINT_SIZE);
+        if (level >= 0)
+            plot_level (state, level, pixels, width, height, stride, box);
+        else if (pyramid->order)
+            plot_leaves (state, pixels, width, height, stride, box);
+        if (level >= 0 || pyramid->order)
+            start = pyramid->n_points;
+    }
+    plot_range (state, start, end, pixels, width, height, stride, box);
+
+    cairo_surface_mark_dirty (surface);
+
+    if (damage)
+    {
+        damage->x = box[0];
+        damage->y = box[1];
+        damage->width = MAX (box[2] - box[0], 0);
+        damage->height = MAX (box[3] - box[1], 0);
+    }
+}
+
+/* Draws the data layer, density or scatter, into a cleared ARGB32
+ * image surface. */
+void ternary_render_data (TernaryRenderState *state,
+    cairo_surface_t *surface)
+{
+    if (state->density)
+        ternary_density_render (state->density, &state->inverse, surface);
+    else
+        ternary_render_points (state, surface, 0, state->n_points, NULL);
+}
+
+/* Draws markers for the selected points only into an ARGB32 image
+ * surface, meant to go over the data layer. Words of the bitmask with
+ * nothing selected are skipped whole, so the cost follows the number of
+ * points selected rather than of points. */
+void ternary_render_selection (TernaryRenderState *state,
+    cairo_surface_t *surface)
+{
+    const TernarySelection *selection = state->selection;
+    gdouble x[POINT_CHUNK], y[POINT_CHUNK];
+    gdouble px[POINT_CHUNK], py[POINT_CHUNK], sizes[POINT_CHUNK];
+    guint32 colors[POINT_CHUNK];
+    guint32 *pixels;
+    gint width, height, stride;
+    gint box[4];
+    gsize w, i, n = 0;
+
+    if (selection == NULL || selection->n_selected == 0)
+        return;
+
+    cairo_surface_flush (surface);
+    pixels = (guint32 *) cairo_image_surface_get_data (surface);
+    width = cairo_image_surface_get_width (surface);
+    height = cairo_image_surface_get_height (surface);
+    stride = cairo_image_surface_get_stride (surface) / sizeof (guint32);
+    box[0] = width;
+    box[1] = height;
+    box[2] = box[3] = 0;
+
+    for (i = 0; i < POINT_CHUNK; i++)
+    {
+        colors[i] = SELECTED_COLOR;
+        sizes[i] = SELECTED_SIZE;
+    }
+
+    for (w = 0; w < ternary_selection_n_words (selection->n_points); w++)
+    {
+        guint32 bits = selection->bits[w];
+
+        while (bits)
+        {
+            i = w * 32 + g_bit_nth_lsf (bits, -1);
+            bits &= bits - 1;
+
+            if (state->fixed)
+            {
+                gdouble z;
+
+                ternary_fixed_get (state->fixed, i, &x[n], &y[n], &z);
+            }
+            else
+            {
+                x[n] = state->xs[i];
+                y[n] = state->ys[i];
+            }
+            if (++n == POINT_CHUNK)
+            {
+                ternary_kernels_affine (&state->forward, x, y, px, py, NULL, n);
+                plot_markers (pixels, width, height, stride, px, py,
+                              colors, sizes, n, box);
+                n = 0;
+            }
+        }
+    }
+
+    if (n > 0)
+    {
+        ternary_kernels_affine (&state->forward, x, y, px, py, NULL, n);
+        plot_markers (pixels, width, height, stride, px, py, colors, sizes,
+                      n, box);
+    }
+
+    cairo_surface_mark_dirty (surface);
+}
+
+/* Draws the whole plot, uncached, onto any cairo context. The state must
+ * already be laid out for the target with ternary_render_set_geometry. */
+void ternary_render (TernaryRenderState *state, cairo_t *cr,
+    gint width, gint height)
+{
+    ternary_render_field (state, cr);
+
+    if (state->n_points > 0)
+    {
+        cairo_surface_t *data;
+
+        /* vector targets get the data layer as one embedded image */
+        data = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+        ternary_render_data (state, data);
+        ternary_render_selection (state, data);
+        cairo_save (cr);
+        if (state->view_side < 1.0)
+        {
+            ternary_render_view_path (state, cr);
+            cairo_clip (cr);
+        }
+        cairo_set_source_surface (cr, data, 0, 0);
+        cairo_paint (cr);
+        cairo_restore (cr);
+        cairo_surface_destroy (data);
+    }
+
+    if (state->trajectory)
+        ternary_render_trajectory (state, cr, 0,
+            ternary_trajectory_get_length (state->trajectory));
+    ternary_render_contours (state, cr);
+    ternary_render_summary (state, cr);
+    ternary_render_pointer (state, cr);
+    ternary_render_labels (state, cr);
+}
+
+/* Lays the state out for a width x height page and writes it to a file,
+ * without touching GDK. */
+gboolean ternary_render_to_file (TernaryRenderState *state,
+    TernaryRenderFormat format, const gchar *filename,
+    gint width, gint height, GError **error)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+
+    ternary_render_set_geometry (state, 0, 0, width, height);
+
+    switch (format)
+    {
+    case TERNARY_RENDER_SVG:
+        surface = cairo_svg_surface_create (filename, width, height);
+        break;
+    case TERNARY_RENDER_PDF:
+        surface = cairo_pdf_surface_create (filename, width, height);
+        break;
+    default:
+        surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+            width, height);
+        break;
+    }
+
+    cr = cairo_create (surface);
+    if (format == TERNARY_RENDER_PNG)
+    {
+        /* the widget draws over the window background */
+        cairo_set_source_rgb (cr, 1, 1, 1);
+        cairo_paint (cr);
+    }
+    ternary_render (state, cr, width, height);
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+
+    if (status == CAIRO_STATUS_SUCCESS && format == TERNARY_RENDER_PNG)
+        status = cairo_surface_write_to_png (surface, filename);
+
+    /* vector surfaces are written out when finished */
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+        status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    if (status != CAIRO_STATUS_SUCCESS)
+    {
+        g_set_error (error, TERNARY_PLOT_ERROR, TERNARY_PLOT_ERROR_FAILED,
+                     "Failed to render '%s': %s", filename,
+                     cairo_status_to_string (status));
+        return FALSE;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_RENDER_H__
+#define __TERNARY_PLOT_RENDER_H__
+
+#include <gtk/gtk.h>
+
+#include "ternaryplot-colormap.h"
+#include "ternaryplot-composition.h"
+#include "ternaryplot-contours.h"
+#include "ternaryplot-density.h"
+#include "ternaryplot-fixed.h"
+#include "ternaryplot-glyphs.h"
+#include "ternaryplot-kernels.h"
+#include "ternaryplot-pyramid.h"
+#include "ternaryplot-selection.h"
+#include "ternaryplot-trajectory.h"
+
+G_BEGIN_DECLS
+
+#define TERNARY_RENDER_POINTER_RADIUS 5
+
+typedef enum
+{
+    TERNARY_RENDER_PNG,
+    TERNARY_RENDER_SVG,
+    TERNARY_RENDER_PDF
+} TernaryRenderFormat;
+
+typedef struct _TernaryRenderState TernaryRenderState;
+
+/* Everything needed to draw a plot, independent of any widget or
+ * display. The widget keeps one for its allocation; headless renders
+ * copy it and lay it out for their own size. */
+struct _TernaryRenderState
+{
+    gdouble x1, y1, x2, y2, x3, y3; /* vertices */
+    gdouble radius; /* radius */
+    TernaryAffine forward; /* (x, y) -> pixel, z = 1 - x - y */
+    TernaryAffine inverse; /* pixel -> (x, y) */
+    gdouble view_x, view_y, view_z; /* lower bounds of the visible part */
+    gdouble view_side; /* its side, 1 for the whole simplex */
+    gdouble x, y, z; /* x-,y-,z-values */
+    gchar *xlabel, *ylabel, *zlabel; /* x-,y-,z-labels */
+    TernaryGlyphs *glyphs; /* shaped labels, NULL to shape on each draw */
+    gdouble grid_step; /* grid step */
+    gdouble *xs, *ys, *zs; /* scatter layer x-,y-,z-columns */
+    TernaryFixed *fixed; /* quantized columns instead, or NULL */
+    gsize n_points; /* number of points in scatter layer */
+    gdouble *values; /* per point colour values, or NULL */
+    gsize n_values; /* points covered, later ones get the default colour */
+    const guint32 *colormap; /* TERNARY_COLORMAP_SIZE ARGB32 entries */
+    gdouble value_min, value_max; /* values at the ends of the colormap */
+    gdouble *sizes; /* per point marker sizes in pixels, or NULL */
+    gsize n_sizes; /* points covered, later ones get the default size */
+    TernaryPyramid *pyramid; /* level of detail for the first points */
+    TernaryDensity *density; /* binned scatter layer, drawn instead if set */
+    TernaryContourSet *contours; /* density isolines over the data, or NULL */
+    TernaryTrajectory *trajectory; /* path over time, or NULL */
+    TernarySelection *selection; /* highlighted points, or NULL */
+    TernaryComposition *composition; /* centre and spread overlay, or NULL */
+    gdouble ellipse_level; /* fraction of the points inside the ellipse */
+    GdkRectangle label_bounds[3]; /* last drawn x-,y-,z-label extents */
+    volatile gint *generation; /* a worker's, layers stop once it moves */
+    gint expected; /* value of generation when the layer was asked for */
+};
+
+void ternary_render_state_init (TernaryRenderState *state);
+void ternary_render_set_geometry (TernaryRenderState *state,
+    gdouble x, gdouble y, gdouble width, gdouble height);
+void ternary_render_view_path (TernaryRenderState *state, cairo_t *cr);
+void ternary_render_field (TernaryRenderState *state, cairo_t *cr);
+void ternary_render_points (TernaryRenderState *state,
+    cairo_surface_t *surface, gsize start, gsize end, GdkRectangle *damage);
+void ternary_render_data (TernaryRenderState *state,
+    cairo_surface_t *surface);
+void ternary_render_selection (TernaryRenderState *state,
+    cairo_surface_t *surface);
+void ternary_render_contours (TernaryRenderState *state, cairo_t *cr);
+void ternary_render_summary (TernaryRenderState *state, cairo_t *cr);
+gboolean ternary_render_summary_bounds (TernaryRenderState *state,
+    GdkRectangle *bounds);
+void ternary_render_trajectory (TernaryRenderState *state, cairo_t *cr,
+    gsize start, gsize end);
+void ternary_render_pointer (TernaryRenderState *state, cairo_t *cr);
+void ternary_render_pointer_bounds (TernaryRenderState *state,
+    GdkRectangle *bounds);
+void ternary_render_labels (TernaryRenderState *state, cairo_t *cr);
+void ternary_render (TernaryRenderState *state, cairo_t *cr,
+    gint width, gint height);
+gboolean ternary_render_to_file (TernaryRenderState *state,
+    TernaryRenderFormat format, const gchar *filename,
+    gint width, gint height, GError **error);
+
+static inline void ternary_render_to_pixel (const TernaryRenderState *state,
+    gdouble x, gdouble y, gdouble *px, gdouble *py)
+{
+    *px = state->forward.xx * x + state->forward.xy * y + state->forward.x0;
+    *py = state->forward.yx * x + state->forward.yy * y + state->forward.y0;
+}
+
+static inline void ternary_render_to_ternary (const TernaryRenderState *state,
+    gdouble px, gdouble py, gdouble *x, gdouble *y, gdouble *z)
+{
+    *x = state->inverse.xx * px + state->inverse.xy * py + state->inverse.x0;
+    *y = state->inverse.yx * px + state->inverse.yy * py + state->inverse.y0;
+    *z = 1.0 - *x - *y;
+}
+
+G_END_DECLS
+
+#endif
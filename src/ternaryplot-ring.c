@@ -0,0 +1,160 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+
+#include "ternaryplot-ring.h"
+
+#define RING_CACHE_LINE 64
+
+typedef struct _TernaryRingSlot TernaryRingSlot;
+
+struct _TernaryRingSlot
+{
+    gint sequence; /* position this slot is ready for */
+    gdouble x, y, z;
+};
+
+/* Bounded MPMC queue after Dmitry Vyukov: every slot carries a sequence
+ * number that tells producers and consumers whether it is free for the
+ * position they claimed, so claiming a position is the only CAS. The
+ * two positions live on separate cache lines. */
+struct _TernaryRing
+{
+    TernaryRingSlot *slots;
+    guint mask;
+    gchar pad0[RING_CACHE_LINE];
+    gint enqueue_pos;
+    gchar pad1[RING_CACHE_LINE];
+    gint dequeue_pos;
+    gchar pad2[RING_CACHE_LINE];
+};
+
+/* positions wrap around, do their arithmetic modulo 2^32 */
+static inline gint ring_diff (gint a, gint b)
+{
+    return (gint) ((guint) a - (guint) b);
+}
+
+static inline gint ring_add (gint a, guint b)
+{
+    return (gint) ((guint) a + b);
+}
+
+TernaryRing *ternary_ring_new (guint capacity)
+{
+    TernaryRing *ring;
+    guint size, i;
+
+    g_return_val_if_fail (capacity >= 2 && capacity <= G_MAXINT / 2, NULL);
+
+    /* round up to a power of two */
+    for (size = 2; size < capacity; size <<= 1)
+        ;
+
+    ring = g_new0 (TernaryRing, 1);
+    ring->slots = g_new (TernaryRingSlot, size);
+    ring->mask = size - 1;
+    for (i = 0; i < size; i++)
+        ring->slots[i].sequence = i;
+
+    return ring;
+}
+
+void ternary_ring_free (TernaryRing *ring)
+{
+    if (ring == NULL)
+        return;
+
+    g_free (ring->slots);
+    g_free (ring);
+}
+
+guint ternary_ring_get_capacity (TernaryRing *ring)
+{
+    return ring->mask + 1;
+}
+
+gboolean ternary_ring_push (TernaryRing *ring,
+    gdouble x, gdouble y, gdouble z)
+{
+    TernaryRingSlot *slot;
+    gint pos;
+
+    pos = g_atomic_int_get (&ring->enqueue_pos);
+    for (;;)
+    {
+        gint dif;
+
+        slot = &ring->slots[pos & ring->mask];
+        dif = ring_diff (g_atomic_int_get (&slot->sequence), pos);
+        if (dif == 0)
+        {
+            if (g_atomic_int_compare_and_exchange (&ring->enqueue_pos,
+                                                   pos, ring_add (pos, 1)))
+                break;
+            pos = g_atomic_int_get (&ring->enqueue_pos);
+        }
+        else if (dif < 0)
+            return FALSE; /* full */
+        else
+            pos = g_atomic_int_get (&ring->enqueue_pos);
+    }
+
+    slot->x = x;
+    slot->y = y;
+    slot->z = z;
+    g_atomic_int_set (&slot->sequence, ring_add (pos, 1));
+
+    return TRUE;
+}
+
+gboolean ternary_ring_pop (TernaryRing *ring,
+    gdouble *x, gdouble *y, gdouble *z)
+{
+    TernaryRingSlot *slot;
+    gint pos;
+
+    pos = g_atomic_int_get (&ring->dequeue_pos);
+    for (;;)
+    {
+        gint dif;
+
+        slot = &ring->slots[pos & ring->mask];
+        dif = ring_diff (g_atomic_int_get (&slot->sequence), ring_add (pos, 1));
+        if (dif == 0)
+        {
+            if (g_atomic_int_compare_and_exchange (&ring->dequeue_pos,
+                                                   pos, ring_add (pos, 1)))
+                break;
+            pos = g_atomic_int_get (&ring->dequeue_pos);
+        }
+        else if (dif < 0)
+            return FALSE; /* empty */
+        else
+            pos = g_atomic_int_get (&ring->dequeue_pos);
+    }
+
+    *x = slot->x;
+    *y = slot->y;
+    *z = slot->z;
+    g_atomic_int_set (&slot->sequence, ring_add (pos, ring->mask + 1));
+
+    return TRUE;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_RING_H__
+#define __TERNARY_PLOT_RING_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Bounded lock-free queue of compositions. Any number of threads may
+ * push and pop concurrently; a full queue makes push fail rather than
+ * wait, leaving the overflow policy to the caller. */
+typedef struct _TernaryRing TernaryRing;
+
+TernaryRing *ternary_ring_new (guint capacity);
+void ternary_ring_free (TernaryRing *ring);
+guint ternary_ring_get_capacity (TernaryRing *ring);
+gboolean ternary_ring_push (TernaryRing *ring,
+    gdouble x, gdouble y, gdouble z);
+gboolean ternary_ring_pop (TernaryRing *ring,
+    gdouble *x, gdouble *y, gdouble *z);
+
+G_END_DECLS
+
+#endif
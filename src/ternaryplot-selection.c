@@ -0,0 +1,288 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "ternaryplot-parallel.h"
+#include "ternaryplot-selection.h"
+
+#define SELECT_GRAIN 65536 /* points tested per worker at least */
+#define SELECT_BLOCK 256 /* points tested together, a multiple of 32 */
+
+typedef struct _SelectJob SelectJob;
+
+struct _SelectJob
+{
+    TernarySelection *selection;
+    const gdouble *xs, *ys;
+    const TernaryFixed *fixed; /* instead of xs and ys when set */
+    const gdouble *min, *max; /* range brush, per component */
+    const gdouble *vx, *vy; /* lasso polygon, or NULL */
+    guint n_vertices;
+    gdouble box[4]; /* lasso bounds: left, bottom, right, top */
+    gsize *counts; /* points selected, per worker */
+};
+
+TernarySelection *ternary_selection_new (gsize n_points)
+{
+    TernarySelection *selection;
+
+    selection = g_new0 (TernarySelection, 1);
+    selection->n_points = n_points;
+    selection->bits = g_new0 (guint32,
+        MAX (ternary_selection_n_words (n_points), 1));
+
+    return selection;
+}
+
+void ternary_selection_free (TernarySelection *selection)
+{
+    if (selection == NULL)
+        return;
+
+    g_free (selection->bits);
+    g_free (selection);
+}
+
+/* Follows the number of points, which are unselected when new. */
+void ternary_selection_resize (TernarySelection *selection, gsize n_points)
+{
+    gsize old_words, n_words, i;
+
+    g_return_if_fail (selection != NULL);
+
+    old_words = ternary_selection_n_words (selection->n_points);
+    n_words = ternary_selection_n_words (n_points);
+    if (n_points < selection->n_points)
+    {
+        /* the count has to be taken again for the bits dropped */
+        for (i = n_points; i < selection->n_points; i++)
+            if (ternary_selection_get (selection, i))
+                selection->n_selected--;
+        if (n_points % 32)
+            selection->bits[n_words - 1] &= (1u << (n_points % 32)) - 1;
+    }
+
+    selection->bits = g_renew (guint32, selection->bits, MAX (n_words, 1));
+    if (n_words > old_words)
+        memset (selection->bits + old_words, 0,
+                (n_words - old_words) * sizeof (guint32));
+    selection->n_points = n_points;
+}
+
+void ternary_selection_clear (TernarySelection *selection)
+{
+    g_return_if_fail (selection != NULL);
+
+    memset (selection->bits, 0,
+            ternary_selection_n_words (selection->n_points) * sizeof (guint32));
+    selection->n_selected = 0;
+}
+
+/* Crossing number test of m points against the lasso, one edge at a
+ * time over the whole block so the inner loop vectorizes. */
+static void select_lasso_block (SelectJob *job, const gdouble *x,
+    const gdouble *y, gsize m, guint8 *inside)
+{
+    guint8 parity[SELECT_BLOCK];
+    gboolean any = FALSE;
+    guint e;
+    gsize j;
+
+    for (j = 0; j < m; j++)
+    {
+        inside[j] = x[j] >= job->box[0] && y[j] >= job->box[1] &&
+                    x[j] <= job->box[2] && y[j] <= job->box[3];
+        any |= inside[j];
+        parity[j] = 0;
+    }
+    if (!any)
+        return;
+
+    for (e = 0; e < job->n_vertices; e++)
+    {
+        guint f = (e + 1) % job->n_vertices;
+        gdouble ax = job->vx[e], ay = job->vy[e];
+        gdouble by = job->vy[f], k;
+
+        /* edges along y never cross the ray */
+        if (ay == by)
+            continue;
+        k = (job->vx[f] - ax) / (by - ay);
+
+        for (j = 0; j < m; j++)
+            parity[j] ^= ((y[j] >= ay) != (y[j] >= by)) &
+                         (x[j] < ax + (y[j] - ay) * k);
+    }
+
+    for (j = 0; j < m; j++)
+        inside[j] &= parity[j];
+}
+
+static void select_range_block (SelectJob *job, const gdouble *x,
+    const gdouble *y, gsize m, guint8 *inside)
+{
+    gsize j;
+
+    /* NaN rows fail every comparison */
+    for (j = 0; j < m; j++)
+    {
+        gdouble z = 1.0 - x[j] - y[j];
+
+        inside[j] = x[j] >= job->min[0] && x[j] <= job->max[0] &&
+                    y[j] >= job->min[1] && y[j] <= job->max[1] &&
+                    z >= job->min[2] && z <= job->max[2];
+    }
+}
+
+/* words [start, end) of the bitmask, so no two workers share one */
+static void select_range_words (gsize start, gsize end, guint worker,
+    gpointer data)
+{
+    SelectJob *job = data;
+    TernarySelection *selection = job->selection;
+    gdouble x[SELECT_BLOCK], y[SELECT_BLOCK], z[SELECT_BLOCK];
+    guint8 inside[SELECT_BLOCK];
+    gsize first, last, i, count = 0;
+
+    first = start * 32;
+    last = MIN (end * 32, selection->n_points);
+
+    for (i = first; i < last; i += SELECT_BLOCK)
+    {
+        gsize m = MIN (SELECT_BLOCK, last - i), j, w;
+        const gdouble *bx, *by;
+
+        if (job->fixed)
+        {
+            ternary_fixed_decode (job->fixed, i, m, x, y, z);
+            bx = x;
+            by = y;
+        }
+        else
+        {
+            bx = job->xs + i;
+            by = job->ys + i;
+        }
+
+        if (job->vx)
+            select_lasso_block (job, bx, by, m, inside);
+        else
+            select_range_block (job, bx, by, m, inside);
+
+        /* pack 32 results to a word */
+        for (w = 0; w < (m + 31) / 32; w++)
+        {
+            guint32 bits = 0;
+
+            for (j = 0; j < 32 && w * 32 + j < m; j++)
+            {
+                bits |= (guint32) inside[w * 32 + j] << j;
+                count += inside[w * 32 + j];
+            }
+            selection->bits[i / 32 + w] = bits;
+        }
+    }
+
+    job->counts[worker] += count;
+}
+
+static void select_run (SelectJob *job)
+{
+    gsize n_words, grain;
+    guint n_workers, w;
+
+    n_words = ternary_selection_n_words (job->selection->n_points);
+    grain = SELECT_GRAIN / 32;
+    n_workers = ternary_parallel_n_workers (n_words, grain);
+    job->counts = g_new0 (gsize, n_workers);
+
+    if (n_words > 0)
+        ternary_parallel_for (n_words, grain, select_range_words, job);
+
+    job->selection->n_selected = 0;
+    for (w = 0; w < n_workers; w++)
+        job->selection->n_selected += job->counts[w];
+    g_free (job->counts);
+}
+
+/* Selects the points whose x, y and z all lie within [min[k], max[k]],
+ * and only those. */
+void ternary_selection_range (TernarySelection *selection,
+    const gdouble *xs, const gdouble *ys, const TernaryFixed *fixed,
+    const gdouble *min, const gdouble *max)
+{
+    SelectJob job;
+
+    g_return_if_fail (selection != NULL);
+    g_return_if_fail (min != NULL && max != NULL);
+    g_return_if_fail (selection->n_points == 0 || fixed != NULL ||
+                      (xs != NULL && ys != NULL));
+
+    memset (&job, 0, sizeof (job));
+    job.selection = selection;
+    job.xs = xs;
+    job.ys = ys;
+    job.fixed = fixed;
+    job.min = min;
+    job.max = max;
+    select_run (&job);
+}
+
+/* Selects the points inside the polygon through the n_vertices points
+ * (vx[i], vy[i]) in (x, y), and only those. The polygon closes by
+ * itself and may intersect itself; even-odd rule. */
+void ternary_selection_lasso (TernarySelection *selection,
+    const gdouble *xs, const gdouble *ys, const TernaryFixed *fixed,
+    const gdouble *vx, const gdouble *vy, guint n_vertices)
+{
+    SelectJob job;
+    guint i;
+
+    g_return_if_fail (selection != NULL);
+    g_return_if_fail (n_vertices == 0 || (vx != NULL && vy != NULL));
+    g_return_if_fail (selection->n_points == 0 || fixed != NULL ||
+                      (xs != NULL && ys != NULL));
+
+    if (n_vertices < 3)
+    {
+        ternary_selection_clear (selection);
+        return;
+    }
+
+    memset (&job, 0, sizeof (job));
+    job.selection = selection;
+    job.xs = xs;
+    job.ys = ys;
+    job.fixed = fixed;
+    job.vx = vx;
+    job.vy = vy;
+    job.n_vertices = n_vertices;
+    job.box[0] = job.box[2] = vx[0];
+    job.box[1] = job.box[3] = vy[0];
+    for (i = 1; i < n_vertices; i++)
+    {
+        job.box[0] = MIN (job.box[0], vx[i]);
+        job.box[1] = MIN (job.box[1], vy[i]);
+        job.box[2] = MAX (job.box[2], vx[i]);
+        job.box[3] = MAX (job.box[3], vy[i]);
+    }
+    select_run (&job);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_SELECTION_H__
+#define __TERNARY_PLOT_SELECTION_H__
+
+#include <glib.h>
+
+#include "ternaryplot-fixed.h"
+
+G_BEGIN_DECLS
+
+/* Subset of n_points points, one bit each. Selections are computed on
+ * all processors from closed (x, y) columns or quantized points,
+ * whichever the plot has. */
+typedef struct _TernarySelection TernarySelection;
+
+struct _TernarySelection
+{
+    gsize n_points;
+    gsize n_selected;
+    guint32 *bits; /* bit i % 32 of word i / 32 is point i */
+};
+
+TernarySelection *ternary_selection_new (gsize n_points);
+void ternary_selection_free (TernarySelection *selection);
+void ternary_selection_resize (TernarySelection *selection, gsize n_points);
+void ternary_selection_clear (TernarySelection *selection);
+void ternary_selection_range (TernarySelection *selection,
+    const gdouble *xs, const gdouble *ys, const TernaryFixed *fixed,
+    const gdouble *min, const gdouble *max);
+void ternary_selection_lasso (TernarySelection *selection,
+    const gdouble *xs, const gdouble *ys, const TernaryFixed *fixed,
+    const gdouble *vx, const gdouble *vy, guint n_vertices);
+
+static inline gsize ternary_selection_n_words (gsize n_points)
+{
+    return (n_points + 31) / 32;
+}
+
+static inline gboolean ternary_selection_get (const TernarySelection *selection,
+    gsize i)
+{
+    return (selection->bits[i / 32] >> (i % 32)) & 1;
+}
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+
+#include "ternaryplot-stats.h"
+
+struct _TernaryStats
+{
+    gdouble samples[TERNARY_PLOT_N_PHASES][TERNARY_STATS_WINDOW]; /* ms */
+    guint n_samples[TERNARY_PLOT_N_PHASES]; /* recorded so far */
+};
+
+static const gchar *phase_names[TERNARY_PLOT_N_PHASES] = {
+    "expose", "field", "data", "trajectory", "contours", "summary", "pointer",
+    "labels", "motion", "release"
+};
+
+TernaryStats *ternary_stats_new (void)
+{
+    return g_new0 (TernaryStats, 1);
+}
+
+void ternary_stats_free (TernaryStats *stats)
+{
+    g_free (stats);
+}
+
+/* returns the time a phase starts at, 0 when disabled */
+gint64 ternary_stats_start (TernaryStats *stats)
+{
+    return stats ? g_get_monotonic_time () : 0;
+}
+
+/* Records a phase that began at start and returns the time it ended,
+ * which is where the next phase starts. */
+gint64 ternary_stats_record (TernaryStats *stats, TernaryPlotPhase phase,
+    gint64 start)
+{
+    gint64 now;
+    guint i;
+
+    if (stats == NULL)
+        return 0;
+
+    now = g_get_monotonic_time ();
+    i = stats->n_samples[phase]++ % TERNARY_STATS_WINDOW;
+    stats->samples[phase][i] = (now - start) / 1000.0;
+
+    return now;
+}
+
+static int compare_doubles (const void *a, const void *b)
+{
+    gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* summarizes the window of a phase, FALSE if nothing was recorded */
+gboolean ternary_stats_get (TernaryStats *stats, TernaryPlotPhase phase,
+    TernaryPlotTiming *timing)
+{
+    gdouble sorted[TERNARY_STATS_WINDOW], sum = 0.0;
+    guint n, i;
+
+    timing->n_samples = 0;
+    timing->min = timing->avg = timing->p99 = 0.0;
+
+    if (stats == NULL || stats->n_samples[phase] == 0)
+        return FALSE;
+
+    n = MIN (stats->n_samples[phase], TERNARY_STATS_WINDOW);
+    for (i = 0; i < n; i++)
+    {
+        sorted[i] = stats->samples[phase][i];
+        sum += sorted[i];
+    }
+    qsort (sorted, n, sizeof (gdouble), compare_doubles);
+
+    timing->n_samples = n;
+    timing->min = sorted[0];
+    timing->avg = sum / n;
+    timing->p99 = sorted[(n - 1) * 99 / 100];
+
+    return TRUE;
+}
+
+/* one line per recorded phase, in milliseconds */
+gchar *ternary_stats_report (TernaryStats *stats)
+{
+    TernaryPlotTiming timing;
+    GString *report;
+    guint phase;
+
+    report = g_string_new (NULL);
+    for (phase = 0; phase < TERNARY_PLOT_N_PHASES; phase++)
+        if (ternary_stats_get (stats, phase, &timing))
+            g_string_append_printf (report,
+                "%-8s n %4u  min %8.3f  avg %8.3f  p99 %8.3f ms\n",
+                phase_names[phase], timing.n_samples, timing.min,
+                timing.avg, timing.p99);
+
+    return g_string_free (report, FALSE);
+}
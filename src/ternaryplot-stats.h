@@ -0,0 +1,47 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_STATS_H__
+#define __TERNARY_PLOT_STATS_H__
+
+#include <glib.h>
+
+#include "ternaryplot.h"
+
+G_BEGIN_DECLS
+
+#define TERNARY_STATS_WINDOW 256 /* latest samples kept per phase */
+
+/* Rolling timings of the widget phases. Every function takes NULL for
+ * disabled statistics and then does nothing, so the calls can stay in
+ * place at the cost of a branch. */
+typedef struct _TernaryStats TernaryStats;
+
+TernaryStats *ternary_stats_new (void);
+void ternary_stats_free (TernaryStats *stats);
+gint64 ternary_stats_start (TernaryStats *stats);
+gint64 ternary_stats_record (TernaryStats *stats, TernaryPlotPhase phase,
+    gint64 start);
+gboolean ternary_stats_get (TernaryStats *stats, TernaryPlotPhase phase,
+    TernaryPlotTiming *timing);
+gchar *ternary_stats_report (TernaryStats *stats);
+
+G_END_DECLS
+
+#endif
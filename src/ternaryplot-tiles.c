@@ -0,0 +1,459 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <gtk/gtk.h>
+#include <math.h>
+
+#include "ternaryplot-tiles.h"
+
+#define TILE_CACHE 256 /* tiles kept, 64 MB at most */
+#define TILE_ANCESTORS 4 /* zoom steps searched for a stand-in */
+
+typedef struct _TileKey TileKey;
+typedef struct _Tile Tile;
+typedef struct _TileJob TileJob;
+
+struct _TileKey
+{
+    gdouble side; /* view side of the zoom */
+    gint tx, ty; /* tile column and row */
+};
+
+struct _Tile
+{
+    TileKey key;
+    cairo_surface_t *surface; /* NULL until first drawn */
+    gint generation; /* the surface was drawn at, stale if not current */
+    gboolean queued; /* a job is drawing it */
+    guint64 used; /* paint that last showed it */
+};
+
+struct _TileJob
+{
+    TileKey key;
+    gint generation;
+    gboolean build_pyramid; /* builds the pyramid instead of a tile */
+    TernaryDataset *dataset; /* to build the pyramid through, or NULL */
+    TernaryRenderState state; /* plot as of the request */
+};
+
+struct _TernaryTiles
+{
+    GRWLock data_lock; /* read while drawing from the plot data */
+    GMutex lock; /* guards the fields below */
+    GHashTable *tiles; /* TileKey -> Tile */
+    GThreadPool *pool;
+    volatile gint generation; /* bumped on invalidation, stale jobs stop */
+    gint pyramid_requested; /* generation a pyramid was asked for at */
+    TernaryPyramid *pyramid; /* built, not handed over yet */
+    gdouble side; /* zoom painted last, jobs for others are dropped */
+    gboolean complete; /* the last paint had every tile current */
+    guint64 clock; /* paint counter */
+    guint ready_id; /* pending ready notification */
+    TernaryTilesReadyFunc ready;
+    gpointer data;
+};
+
+static guint tile_hash (gconstpointer key)
+{
+    const TileKey *k = key;
+
+    return g_double_hash (&k->side) ^ (guint) k->tx * 73856093u ^
+        (guint) k->ty * 19349663u;
+}
+
+static gboolean tile_equal (gconstpointer a, gconstpointer b)
+{
+    const TileKey *ka = a, *kb = b;
+
+    return ka->side == kb->side && ka->tx == kb->tx && ka->ty == kb->ty;
+}
+
+static void tile_free (gpointer data)
+{
+    Tile *tile = data;
+
+    if (tile->surface)
+        cairo_surface_destroy (tile->surface);
+    g_free (tile);
+}
+
+static inline gint floor_div (gint a, gint b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static gboolean tiles_ready (gpointer data)
+{
+    TernaryTiles *tiles = data;
+    TernaryPyramid *pyramid;
+
+    g_mutex_lock (&tiles->lock);
+    pyramid = tiles->pyramid;
+    tiles->pyramid = NULL;
+    tiles->ready_id = 0;
+    g_mutex_unlock (&tiles->lock);
+
+    tiles->ready (pyramid, tiles->data);
+
+    return FALSE;
+}
+
+static inline gboolean tiles_current (TernaryTiles *tiles, gint generation)
+{
+    return generation == g_atomic_int_get (&tiles->generation);
+}
+
+/* Builds the pyramid the tiles of a large scatter layer draw from, so
+ * the main loop never does. The build stops once the tiles are
+ * invalidated. Pyramids built through a data set stay with it, outside
+ * the data lock as the job holds the data set; the ready callback is
+ * only told they are there. */
+static void tiles_build_pyramid (TileJob *job, TernaryTiles *tiles)
+{
+    TernaryRenderState *state = &job->state;
+    TernaryPyramid *pyramid = NULL;
+
+    if (job->dataset && tiles_current (tiles, job->generation))
+        ternary_dataset_get_pyramid (job->dataset);
+    else if (tiles_current (tiles, job->generation))
+    {
+        g_rw_lock_reader_lock (&tiles->data_lock);
+        pyramid = ternary_pyramid_new_cancellable (state->xs, state->ys,
+            state->zs, state->n_points,
+            ternary_pyramid_depth_for (state->n_points),
+            &tiles->generation, job->generation);
+        g_rw_lock_reader_unlock (&tiles->data_lock);
+    }
+
+    g_mutex_lock (&tiles->lock);
+    if (tiles_current (tiles, job->generation) &&
+        (pyramid || job->dataset))
+    {
+        ternary_pyramid_free (tiles->pyramid);
+        tiles->pyramid = pyramid;
+        pyramid = NULL;
+        if (tiles->ready_id == 0)
+            tiles->ready_id = g_idle_add (tiles_ready, tiles);
+    }
+    else if (tiles->pyramid_requested == job->generation)
+        /* dropped, so a later paint asks again */
+        tiles->pyramid_requested = -1;
+    g_mutex_unlock (&tiles->lock);
+
+    ternary_pyramid_free (pyramid);
+    if (job->dataset)
+        g_object_unref (job->dataset);
+    g_free (job);
+}
+
+/* Draws one tile. The job state is moved so that the tile origin is at
+ * the top left of its surface. */
+static void tiles_render (gpointer data, gpointer user_data)
+{
+    TileJob *job = data;
+    TernaryTiles *tiles = user_data;
+    cairo_surface_t *surface = NULL;
+    Tile *tile;
+    gboolean current;
+
+    if (job->build_pyramid)
+    {
+        tiles_build_pyramid (job, tiles);
+        return;
+    }
+
+    g_rw_lock_reader_lock (&tiles->data_lock);
+
+    g_mutex_lock (&tiles->lock);
+    current = job->generation == tiles->generation &&
+              job->key.side == tiles->side;
+    g_mutex_unlock (&tiles->lock);
+
+    if (current)
+    {
+        job->state.generation = &tiles->generation;
+        job->state.expected = job->generation;
+        job->state.forward.x0 = -job->key.tx * TERNARY_TILE_SIZE;
+        job->state.forward.y0 = -job->key.ty * TERNARY_TILE_SIZE;
+        ternary_affine_invert (&job->state.forward, &job->state.inverse);
+
+        surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+            TERNARY_TILE_SIZE, TERNARY_TILE_SIZE);
+        ternary_render_data (&job->state, surface);
+    }
+
+    g_rw_lock_reader_unlock (&tiles->data_lock);
+
+    g_mutex_lock (&tiles->lock);
+    tile = g_hash_table_lookup (tiles->tiles, &job->key);
+    if (tile && tile->queued)
+    {
+        /* dropped jobs leave a later paint to ask again, the stale
+         * surface standing in until then */
+        tile->queued = FALSE;
+        if (surface && tiles_current (tiles, job->generation))
+        {
+            if (tile->surface)
+                cairo_surface_destroy (tile->surface);
+            tile->surface = surface;
+            tile->generation = job->generation;
+            surface = NULL;
+            if (tiles->ready_id == 0)
+                tiles->ready_id = g_idle_add (tiles_ready, tiles);
+        }
+        else if (tile->surface == NULL)
+            g_hash_table_remove (tiles->tiles, &job->key);
+    }
+    g_mutex_unlock (&tiles->lock);
+
+    if (surface)
+        cairo_surface_destroy (surface);
+    g_free (job);
+}
+
+TernaryTiles *ternary_tiles_new (TernaryTilesReadyFunc ready, gpointer data)
+{
+    TernaryTiles *tiles;
+
+    tiles = g_new0 (TernaryTiles, 1);
+    g_rw_lock_init (&tiles->data_lock);
+    g_mutex_init (&tiles->lock);
+    tiles->tiles = g_hash_table_new_full (tile_hash, tile_equal, NULL,
+                                          tile_free);
+    tiles->pool = g_thread_pool_new (tiles_render, tiles,
+                                     g_get_num_processors (), FALSE, NULL);
+    tiles->pyramid_requested = -1;
+    tiles->ready = ready;
+    tiles->data = data;
+
+    return tiles;
+}
+
+void ternary_tiles_free (TernaryTiles *tiles)
+{
+    if (tiles == NULL)
+        return;
+
+    /* queued jobs are stale now and finish at once */
+    g_mutex_lock (&tiles->lock);
+    g_atomic_int_inc (&tiles->generation);
+    g_mutex_unlock (&tiles->lock);
+    g_thread_pool_free (tiles->pool, FALSE, TRUE);
+
+    if (tiles->ready_id)
+        g_source_remove (tiles->ready_id);
+    ternary_pyramid_free (tiles->pyramid);
+    g_hash_table_destroy (tiles->tiles);
+    g_mutex_clear (&tiles->lock);
+    g_rw_lock_clear (&tiles->data_lock);
+    g_free (tiles);
+}
+
+/* Marks every tile stale; each stays up until its replacement is drawn.
+ * Returns once no worker reads the plot data any more, so the caller
+ * may change or free it afterwards. */
+void ternary_tiles_invalidate (TernaryTiles *tiles)
+{
+    TernaryPyramid *pyramid;
+
+    /* bumped first, so a worker drawing stops at its next check rather
+     * than holding the lock to the end of its tile */
+    g_atomic_int_inc (&tiles->generation);
+
+    g_rw_lock_writer_lock (&tiles->data_lock);
+    g_rw_lock_writer_unlock (&tiles->data_lock);
+
+    g_mutex_lock (&tiles->lock);
+    tiles->complete = FALSE;
+    pyramid = tiles->pyramid;
+    tiles->pyramid = NULL;
+    g_mutex_unlock (&tiles->lock);
+
+    ternary_pyramid_free (pyramid);
+}
+
+/* the same, dropping the tiles, for when they no longer fit the plane */
+void ternary_tiles_clear (TernaryTiles *tiles)
+{
+    ternary_tiles_invalidate (tiles);
+
+    g_mutex_lock (&tiles->lock);
+    g_hash_table_remove_all (tiles->tiles);
+    g_mutex_unlock (&tiles->lock);
+}
+
+/* scales up the nearest ready tile further out over a missing one */
+static void paint_ancestor (TernaryTiles *tiles, cairo_t *cr,
+    const TileKey *key, gdouble ox, gdouble oy)
+{
+    TileKey up;
+    Tile *tile;
+    gint k;
+
+    for (k = 1; k <= TILE_ANCESTORS; k++)
+    {
+        gint scale = 1 << k;
+
+        up.side = ldexp (key->side, k);
+        if (up.side >= 1.0)
+            return;
+        up.tx = floor_div (key->tx, scale);
+        up.ty = floor_div (key->ty, scale);
+
+        tile = g_hash_table_lookup (tiles->tiles, &up);
+        if (tile == NULL || tile->surface == NULL)
+            continue;
+
+        tile->used = tiles->clock;
+        cairo_save (cr);
+        cairo_rectangle (cr, ox + key->tx * TERNARY_TILE_SIZE,
+                         oy + key->ty * TERNARY_TILE_SIZE,
+                         TERNARY_TILE_SIZE, TERNARY_TILE_SIZE);
+        cairo_clip (cr);
+        cairo_translate (cr, ox + up.tx * scale * TERNARY_TILE_SIZE,
+                         oy + up.ty * scale * TERNARY_TILE_SIZE);
+        cairo_scale (cr, scale, scale);
+        cairo_set_source_surface (cr, tile->surface, 0, 0);
+        cairo_paint (cr);
+        cairo_restore (cr);
+        return;
+    }
+}
+
+/* least recently shown ready tiles go first */
+static void tiles_evict (TernaryTiles *tiles)
+{
+    while (g_hash_table_size (tiles->tiles) > TILE_CACHE)
+    {
+        GHashTableIter iter;
+        gpointer value;
+        Tile *oldest = NULL;
+
+        g_hash_table_iter_init (&iter, tiles->tiles);
+        while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+            Tile *tile = value;
+
+            if (tile->surface && tile->used < tiles->clock &&
+                (oldest == NULL || tile->used < oldest->used))
+                oldest = tile;
+        }
+        if (oldest == NULL)
+            return;
+        g_hash_table_remove (tiles->tiles, &oldest->key);
+    }
+}
+
+/* Paints the data layer over area from the cache, queueing the tiles it
+ * does not have yet or has stale. With build_pyramid the pyramid is
+ * built first, and until it is ready only the tiles at hand are shown. */
+void ternary_tiles_paint (TernaryTiles *tiles, TernaryRenderState *state,
+    cairo_t *cr, const GdkRectangle *area, gboolean build_pyramid,
+    TernaryDataset *dataset)
+{
+    gdouble ox, oy;
+    gint tx, ty, tx0, ty0, tx1, ty1;
+
+    /* screen = tile plane + origin, snapped to whole pixels */
+    ox = floor (state->forward.x0 + 0.5);
+    oy = floor (state->forward.y0 + 0.5);
+    tx0 = (gint) floor ((area->x - ox) / TERNARY_TILE_SIZE);
+    ty0 = (gint) floor ((area->y - oy) / TERNARY_TILE_SIZE);
+    tx1 = (gint) floor ((area->x + area->width - 1 - ox) / TERNARY_TILE_SIZE);
+    ty1 = (gint) floor ((area->y + area->height - 1 - oy) / TERNARY_TILE_SIZE);
+
+    g_mutex_lock (&tiles->lock);
+    tiles->side = state->view_side;
+    tiles->complete = !build_pyramid;
+    tiles->clock++;
+
+    if (build_pyramid && tiles->pyramid_requested != tiles->generation)
+    {
+        TileJob *job;
+
+        tiles->pyramid_requested = tiles->generation;
+        job = g_new0 (TileJob, 1);
+        job->generation = tiles->generation;
+        job->build_pyramid = TRUE;
+        job->dataset = dataset ? g_object_ref (dataset) : NULL;
+        job->state = *state;
+        g_thread_pool_push (tiles->pool, job, NULL);
+    }
+
+    for (ty = ty0; ty <= ty1; ty++)
+        for (tx = tx0; tx <= tx1; tx++)
+        {
+            TileKey key;
+            Tile *tile;
+
+            key.side = state->view_side;
+            key.tx = tx;
+            key.ty = ty;
+
+            tile = g_hash_table_lookup (tiles->tiles, &key);
+            if (tile == NULL && !build_pyramid)
+            {
+                tile = g_new0 (Tile, 1);
+                tile->key = key;
+                g_hash_table_insert (tiles->tiles, &tile->key, tile);
+            }
+            if (tile && !build_pyramid && !tile->queued &&
+                (tile->surface == NULL ||
+                 tile->generation != tiles->generation))
+            {
+                TileJob *job;
+
+                tile->queued = TRUE;
+                job = g_new0 (TileJob, 1);
+                job->key = key;
+                job->generation = tiles->generation;
+                job->state = *state;
+                g_thread_pool_push (tiles->pool, job, NULL);
+            }
+            if (tile)
+                tile->used = tiles->clock;
+            if (tile == NULL || tile->queued)
+                tiles->complete = FALSE;
+
+            if (tile && tile->surface)
+            {
+                cairo_set_source_surface (cr, tile->surface,
+                    ox + tx * TERNARY_TILE_SIZE, oy + ty * TERNARY_TILE_SIZE);
+                cairo_paint (cr);
+            }
+            else
+                paint_ancestor (tiles, cr, &key, ox, oy);
+        }
+
+    tiles_evict (tiles);
+    g_mutex_unlock (&tiles->lock);
+}
+
+/* Whether the last paint showed only current tiles. */
+gboolean ternary_tiles_is_complete (TernaryTiles *tiles)
+{
+    gboolean complete;
+
+    g_mutex_lock (&tiles->lock);
+    complete = tiles->complete;
+    g_mutex_unlock (&tiles->lock);
+
+    return complete;
+}
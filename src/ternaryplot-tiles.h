@@ -0,0 +1,56 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_TILES_H__
+#define __TERNARY_PLOT_TILES_H__
+
+#include <gtk/gtk.h>
+
+#include "ternaryplot-dataset.h"
+#include "ternaryplot-render.h"
+
+G_BEGIN_DECLS
+
+#define TERNARY_TILE_SIZE 256 /* tile side in pixels */
+
+/* Cache of data layer tiles for zoomed views. Tiles are laid on the
+ * plane the whole simplex maps to at a zoom, so panning only moves them,
+ * and are keyed on the zoom and their index there. Missing tiles are
+ * drawn by background workers; until then the tile a zoom step or more
+ * out is scaled up in their place. Stale tiles stay up until redrawn. */
+typedef struct _TernaryTiles TernaryTiles;
+
+/* Called on the main loop when new tiles are ready, or the pyramid asked
+ * for, which is passed for the callee to own. Pyramids built through a
+ * data set stay with it and are not passed. */
+typedef void (*TernaryTilesReadyFunc) (TernaryPyramid *pyramid,
+    gpointer data);
+
+TernaryTiles *ternary_tiles_new (TernaryTilesReadyFunc ready, gpointer data);
+void ternary_tiles_free (TernaryTiles *tiles);
+void ternary_tiles_invalidate (TernaryTiles *tiles);
+void ternary_tiles_clear (TernaryTiles *tiles);
+void ternary_tiles_paint (TernaryTiles *tiles, TernaryRenderState *state,
+    cairo_t *cr, const GdkRectangle *area, gboolean build_pyramid,
+    TernaryDataset *dataset);
+gboolean ternary_tiles_is_complete (TernaryTiles *tiles);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,210 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <cairo.h>
+#include <math.h>
+
+#include "ternaryplot-trajectory.h"
+
+#define TRAJECTORY_CHUNK 1024 /* samples projected and stroked at a time */
+
+struct _TernaryTrajectory
+{
+    gdouble *x, *y; /* closed samples, z = 1 - x - y */
+    gsize n_samples;
+    gsize capacity;
+    gdouble red, green, blue; /* line colour */
+    gdouble width; /* line width in pixels */
+};
+
+TernaryTrajectory *ternary_trajectory_new (void)
+{
+    TernaryTrajectory *trajectory;
+
+    trajectory = g_new0 (TernaryTrajectory, 1);
+    trajectory->red = 0.6;
+    trajectory->green = 0.1;
+    trajectory->blue = 0.1;
+    trajectory->width = 1.5;
+
+    return trajectory;
+}
+
+void ternary_trajectory_free (TernaryTrajectory *trajectory)
+{
+    if (trajectory == NULL)
+        return;
+
+    g_free (trajectory->x);
+    g_free (trajectory->y);
+    g_free (trajectory);
+}
+
+/* Closes n samples and adds them after the last one. */
+void ternary_trajectory_append (TernaryTrajectory *trajectory,
+    const gdouble *x, const gdouble *y, const gdouble *z, gsize n)
+{
+    gdouble cz[TRAJECTORY_CHUNK];
+    gsize i, m;
+
+    g_return_if_fail (trajectory != NULL);
+    g_return_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL));
+
+    if (trajectory->n_samples + n > trajectory->capacity)
+    {
+        trajectory->capacity = MAX (2 * trajectory->capacity,
+                                    MAX (trajectory->n_samples + n, 1024));
+        trajectory->x = g_renew (gdouble, trajectory->x, trajectory->capacity);
+        trajectory->y = g_renew (gdouble, trajectory->y, trajectory->capacity);
+    }
+
+    for (i = 0; i < n; i += m)
+    {
+        gsize at = trajectory->n_samples + i;
+
+        m = MIN (n - i, TRAJECTORY_CHUNK);
+        ternary_kernels_closure (x + i, y + i, z + i, trajectory->x + at,
+                                 trajectory->y + at, cz, m);
+    }
+    trajectory->n_samples += n;
+}
+
+void ternary_trajectory_clear (TernaryTrajectory *trajectory)
+{
+    g_return_if_fail (trajectory != NULL);
+    trajectory->n_samples = 0;
+}
+
+gsize ternary_trajectory_get_length (TernaryTrajectory *trajectory)
+{
+    g_return_val_if_fail (trajectory != NULL, 0);
+    return trajectory->n_samples;
+}
+
+void ternary_trajectory_set_style (TernaryTrajectory *trajectory,
+    gdouble red, gdouble green, gdouble blue, gdouble width)
+{
+    g_return_if_fail (trajectory != NULL);
+
+    trajectory->red = red;
+    trajectory->green = green;
+    trajectory->blue = blue;
+    trajectory->width = width;
+}
+
+/* Strokes the segments between samples [start, end) through forward.
+ * Round joins and caps let a later call starting at end - 1 continue
+ * the line without a visible seam. The path is stroked a chunk at a
+ * time, so long trajectories never build one huge path. */
+void ternary_trajectory_stroke (TernaryTrajectory *trajectory,
+    const TernaryAffine *forward, cairo_t *cr, gsize start, gsize end)
+{
+    gdouble px[TRAJECTORY_CHUNK], py[TRAJECTORY_CHUNK];
+    gdouble last_x = 0.0, last_y = 0.0;
+    gboolean pen = FALSE;
+    gsize i, j, n;
+
+    g_return_if_fail (trajectory != NULL);
+
+    end = MIN (end, trajectory->n_samples);
+    if (start + 1 >= end)
+        return;
+
+    cairo_save (cr);
+    cairo_set_source_rgb (cr, trajectory->red, trajectory->green,
+                          trajectory->blue);
+    cairo_set_line_width (cr, trajectory->width);
+    cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+    cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
+
+    for (i = start; i < end; i += n)
+    {
+        n = MIN (end - i, TRAJECTORY_CHUNK);
+        ternary_kernels_affine (forward, trajectory->x + i,
+                                trajectory->y + i, px, py, NULL, n);
+
+        cairo_new_path (cr);
+        if (pen)
+            cairo_move_to (cr, last_x, last_y);
+        for (j = 0; j < n; j++)
+        {
+            /* samples that failed closure lift the pen */
+            if (isnan (px[j]))
+            {
+                pen = FALSE;
+                continue;
+            }
+            if (pen)
+                cairo_line_to (cr, px[j], py[j]);
+            else
+                cairo_move_to (cr, px[j], py[j]);
+            pen = TRUE;
+            last_x = px[j];
+            last_y = py[j];
+        }
+        cairo_stroke (cr);
+    }
+
+    cairo_restore (cr);
+}
+
+/* Pixel bounds of what stroking [start, end) would touch. Returns FALSE
+ * when that is nothing. */
+gboolean ternary_trajectory_extents (TernaryTrajectory *trajectory,
+    const TernaryAffine *forward, gsize start, gsize end,
+    gdouble *x1, gdouble *y1, gdouble *x2, gdouble *y2)
+{
+    gdouble px[TRAJECTORY_CHUNK], py[TRAJECTORY_CHUNK];
+    gdouble left = G_MAXDOUBLE, top = G_MAXDOUBLE;
+    gdouble right = -G_MAXDOUBLE, bottom = -G_MAXDOUBLE;
+    gdouble pad;
+    gsize i, j, n;
+
+    g_return_val_if_fail (trajectory != NULL, FALSE);
+
+    end = MIN (end, trajectory->n_samples);
+    for (i = start; i < end; i += n)
+    {
+        n = MIN (end - i, TRAJECTORY_CHUNK);
+        ternary_kernels_affine (forward, trajectory->x + i,
+                                trajectory->y + i, px, py, NULL, n);
+        for (j = 0; j < n; j++)
+        {
+            if (isnan (px[j]))
+                continue;
+            left = MIN (left, px[j]);
+            right = MAX (right, px[j]);
+            top = MIN (top, py[j]);
+            bottom = MAX (bottom, py[j]);
+        }
+    }
+
+    if (left > right)
+        return FALSE;
+
+    /* half the line plus antialiasing */
+    pad = trajectory->width / 2 + 1;
+    *x1 = left - pad;
+    *y1 = top - pad;
+    *x2 = right + pad;
+    *y2 = bottom + pad;
+
+    return TRUE;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef __TERNARY_PLOT_TRAJECTORY_H__
+#define __TERNARY_PLOT_TRAJECTORY_H__
+
+#include <glib.h>
+#include <cairo.h>
+
+#include "ternaryplot-kernels.h"
+
+G_BEGIN_DECLS
+
+/* Samples of a composition over time, each joined to the one before by
+ * a straight segment. Samples can only be appended, so whatever has
+ * been stroked once stays valid until the transform or the style
+ * changes. A NaN sample breaks the path. */
+typedef struct _TernaryTrajectory TernaryTrajectory;
+
+TernaryTrajectory *ternary_trajectory_new (void);
+void ternary_trajectory_free (TernaryTrajectory *trajectory);
+void ternary_trajectory_append (TernaryTrajectory *trajectory,
+    const gdouble *x, const gdouble *y, const gdouble *z, gsize n);
+void ternary_trajectory_clear (TernaryTrajectory *trajectory);
+gsize ternary_trajectory_get_length (TernaryTrajectory *trajectory);
+void ternary_trajectory_set_style (TernaryTrajectory *trajectory,
+    gdouble red, gdouble green, gdouble blue, gdouble width);
+void ternary_trajectory_stroke (TernaryTrajectory *trajectory,
+    const TernaryAffine *forward, cairo_t *cr, gsize start, gsize end);
+gboolean ternary_trajectory_extents (TernaryTrajectory *trajectory,
+    const TernaryAffine *forward, gsize start, gsize end,
+    gdouble *x1, gdouble *y1, gdouble *x2, gdouble *y2);
+
+G_END_DECLS
+
+#endif
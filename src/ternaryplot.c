@@ -22,12 +22,35 @@
 #include <string.h>
 
 #include "ternaryplot.h"
+#include "ternaryplot-constraints.h"
+#include "ternaryplot-csv.h"
+#include "ternaryplot-datafile.h"
+#include "ternaryplot-dataset.h"
+#include "ternaryplot-density.h"
+#include "ternaryplot-index.h"
+#include "ternaryplot-kernels.h"
+#include "ternaryplot-pyramid.h"
+#include "ternaryplot-raster.h"
+#include "ternaryplot-render.h"
+#include "ternaryplot-ring.h"
+#include "ternaryplot-stats.h"
+#include "ternaryplot-tiles.h"
 #include "ternaryplot-marshallers.h"
 
 #define GETTEXT_PACKAGE "ternaryplot"
 #include <glib/gi18n.h>
 
 #define SENSITIVITY_THRESH 5
+#define STREAM_CAPACITY 65536 /* default streaming queue length */
+#define STREAM_CAPACITY_MAX (1 << 22) /* longest queue, 128 MiB of slots */
+#define STREAM_INTERVAL 16 /* ms between stream drains, about a frame */
+#define STREAM_CHUNK 256 /* points closed at a time before queueing */
+#define PYRAMID_THRESHOLD (1 << 20) /* points from which a pyramid is built */
+#define PYRAMID_STALE 8 /* rebuilt once 1/8 of the points are past it */
+#define CONTOURS_INTERVAL 250 /* ms between isoline restarts while streaming */
+#define MIN_VIEW_SIDE (1.0 / 65536) /* deepest zoom, 16 scroll steps */
+#define STATS_INTERVAL 5 /* default seconds between statistics dumps */
+#define LASSO_STEP 3 /* pixels between recorded lasso vertices */
 
 #define TERNARY_PLOT_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
                                        TERNARY_TYPE_PLOT, TernaryPlotPrivate))
@@ -36,24 +59,76 @@ typedef struct _TernaryPlotPrivate TernaryPlotPrivate;
 
 struct _TernaryPlotPrivate
 {
-    gdouble x1, y1, x2, y2, x3, y3; /* vertices */
-    gdouble radius; /* radius */
-    gdouble x, y, z; /* x-,y-,z-values */
-    gchar *xlabel, *ylabel, *zlabel; /* x-,y-,z-labels */
-    gdouble grid_step; /* grid step */
+    TernaryRenderState state; /* geometry, value, labels and data layers */
     gchar is_dragged; /* is pointer being dragged */
-    gdouble percent_width; /* percent value label width */
+    gsize points_capacity; /* allocated length of the columns */
+    GDestroyNotify points_destroy; /* releases borrowed columns */
+    gpointer points_data; /* owner of borrowed columns */
+    TernaryDataset *dataset; /* shared owner of the columns, or NULL */
+    gboolean pyramid_shared; /* state.pyramid belongs to the data set */
+    gboolean density_shared; /* state.density belongs to the data set */
+    TernaryRing *stream; /* points appended from producer threads */
+    GRWLock stream_lock; /* read while pushing, written to swap stream */
+    gint overflow_policy; /* TernaryPlotOverflowPolicy, read by producers */
+    gint stream_scheduled; /* stream drain pending */
+    gint n_dropped; /* points discarded on overflow, as a guint */
+    TernaryRaster *raster; /* full view data layer, drawn in the background */
+    gboolean density_enabled; /* draw density instead of scatter */
+    guint density_resolution; /* density cells per side */
+    TernaryIndex *index; /* nearest point lookup, built on demand */
+    gssize hovered; /* point under the mouse or -1 */
+    cairo_surface_t *field_surface; /* cached triangle, grid and frame */
+    cairo_surface_t *trajectory_surface; /* trajectory stroked so far */
+    gsize trajectory_drawn; /* samples on trajectory_surface */
+    cairo_surface_t *selection_surface; /* selected points, over the data */
+    GArray *lasso_x, *lasso_y; /* vertices of the lasso being drawn */
+    gboolean is_brushing; /* is range brush being dragged */
+    gdouble brush_x, brush_y, brush_z; /* where the brush started */
+    TernaryTiles *tiles; /* data layer of zoomed views */
+    gboolean contours_enabled; /* draw density isolines */
+    gdouble bandwidth; /* isoline kernel width, fraction of a side */
+    TernaryColormap colormap; /* colours of the per point values */
+    TernaryContours *contours; /* background isoline estimator */
+    guint contours_timeout_id; /* pending restart for appended points */
+    gboolean summary_enabled; /* draw the centre and spread ellipse */
+    TernaryComposition *composition; /* running log-ratio summary */
+    gboolean is_panned; /* is view being dragged */
+    gdouble pan_x, pan_y; /* pointer position the view was last moved to */
+    gdouble motion_x, motion_y; /* latest pointer position while dragging */
+    guint motion_idle_id; /* pending coalesced motion */
+    gdouble drag_rate; /* point-dragging emission rate in Hz */
+    gint64 drag_emitted; /* monotonic time of last point-dragging */
+    guint drag_timeout_id; /* pending trailing point-dragging */
+    TernaryConstraints *constraints; /* feasible region of the pointer */
+    TernaryStats *stats; /* phase timings, NULL when disabled */
+    guint stats_dump_id; /* periodic dump requested by TERNARYPLOT_STATS */
 };
 
 G_DEFINE_TYPE (TernaryPlot, ternary_plot, GTK_TYPE_DRAWING_AREA);
+G_DEFINE_QUARK (ternary-plot-error-quark, ternary_plot_error);
 
 enum {
     PROP_0,
-    PROP_TOLERANCE
+    PROP_TOLERANCE,
+    PROP_GRID_STEP,
+    PROP_DRAG_RATE,
+    PROP_DENSITY,
+    PROP_DENSITY_RESOLUTION,
+    PROP_CONTOURS,
+    PROP_BANDWIDTH,
+    PROP_SUMMARY,
+    PROP_SUMMARY_LEVEL,
+    PROP_STATS_ENABLED,
+    PROP_STATS,
+    PROP_DATASET
 };
 
 enum {
     POINT_CHANGED,
+    POINT_DRAGGING,
+    POINT_HOVERED,
+    POINT_ACTIVATED,
+    SELECTION_CHANGED,
     LAST_SIGNAL
 };
 
@@ -64,6 +139,13 @@ static gboolean ternary_plot_expose (GtkWidget* plot, GdkEventExpose *event);
 static gboolean ternary_plot_button_press (GtkWidget *plot, GdkEventButton *event);
 static gboolean ternary_plot_button_release (GtkWidget *plot, GdkEventButton *event);
 static gboolean ternary_plot_motion_notify (GtkWidget *plot, GdkEventMotion *event);
+static gboolean ternary_plot_leave_notify (GtkWidget *plot, GdkEventCrossing *event);
+static gboolean ternary_plot_scroll (GtkWidget *plot, GdkEventScroll *event);
+static void     ternary_plot_tiles_ready (TernaryPyramid *pyramid, gpointer data);
+static void     ternary_plot_raster_ready (TernaryPyramid *pyramid, gpointer data);
+static void     ternary_plot_contours_ready (TernaryContourSet *set, gpointer data);
+static gboolean ternary_plot_query_tooltip (GtkWidget *plot, gint x, gint y,
+    gboolean keyboard_mode, GtkTooltip *tooltip);
 static void     ternary_plot_size_allocate (GtkWidget *widget, GdkRectangle *allocation);
 static void     ternary_plot_finalize (GObject *object);
 
@@ -72,10 +154,6 @@ static void     ternary_plot_set_property (GObject *object, guint prop_id,
 static void      ternary_plot_get_property (GObject *object, guint prop_id,
     GValue *value, GParamSpec *pspec);
 
-/* utility functions */
-static gdouble   ternary_plot_dot_to_line_distance (gdouble x, gdouble y,
-    gdouble x1, gdouble y1, gdouble x2, gdouble y2);
-
 static void ternary_plot_class_init (TernaryPlotClass *class)
 {
     GObjectClass *obj_class;
@@ -95,6 +173,83 @@ static void ternary_plot_class_init (TernaryPlotClass *class)
             _("Current value is rounded to value proportional to the tolerance"),
             0.1, 100.0, 10.0, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
 
+    g_object_class_install_property (obj_class,
+        PROP_GRID_STEP,
+        g_param_spec_double ("grid-step",
+            _("Grid step in percents"),
+            _("Distance between neighbouring grid lines"),
+            1.0, 50.0, 10.0, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
+    g_object_class_install_property (obj_class,
+        PROP_DRAG_RATE,
+        g_param_spec_double ("drag-rate",
+            _("Dragging notification rate in Hz"),
+            _("Maximum rate of point-dragging emissions, 0 for every frame"),
+            0.0, 1000.0, 30.0, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
+    g_object_class_install_property (obj_class,
+        PROP_DENSITY,
+        g_param_spec_boolean ("density",
+            _("Density mode"),
+            _("Whether points are drawn as a binned density"),
+            FALSE, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
+    g_object_class_install_property (obj_class,
+        PROP_DENSITY_RESOLUTION,
+        g_param_spec_uint ("density-resolution",
+            _("Density resolution"),
+            _("Number of density cells along each side"),
+            2, 1024, 64, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
+    g_object_class_install_property (obj_class,
+        PROP_CONTOURS,
+        g_param_spec_boolean ("contours",
+            _("Density contours"),
+            _("Whether isolines of the point density are drawn"),
+            FALSE, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
+    g_object_class_install_property (obj_class,
+        PROP_BANDWIDTH,
+        g_param_spec_double ("bandwidth",
+            _("Contour bandwidth in percents"),
+            _("Width of the density kernel the contours are drawn from"),
+            0.5, 50.0, 5.0, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
+    g_object_class_install_property (obj_class,
+        PROP_SUMMARY,
+        g_param_spec_boolean ("summary",
+            _("Compositional summary"),
+            _("Whether the centre of the points and an ellipse around them are drawn"),
+            FALSE, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
+    g_object_class_install_property (obj_class,
+        PROP_SUMMARY_LEVEL,
+        g_param_spec_double ("summary-level",
+            _("Ellipse level in percents"),
+            _("Share of normally spread points the ellipse would hold"),
+            50.0, 99.9, 95.0, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
+    g_object_class_install_property (obj_class,
+        PROP_STATS_ENABLED,
+        g_param_spec_boolean ("stats-enabled",
+            _("Timing statistics"),
+            _("Whether drawing and input handling are timed"),
+            FALSE, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
+    g_object_class_install_property (obj_class,
+        PROP_STATS,
+        g_param_spec_string ("stats",
+            _("Timing report"),
+            _("Rolling minimum, mean and 99th percentile of each phase"),
+            NULL, G_PARAM_READABLE));
+
+    g_object_class_install_property (obj_class,
+        PROP_DATASET,
+        g_param_spec_object ("dataset",
+            _("Data set"),
+            _("Shared points shown by the plot"),
+            TERNARY_TYPE_DATASET, (G_PARAM_READABLE | G_PARAM_WRITABLE)));
+
     signals[POINT_CHANGED] =
         g_signal_new ("point-changed",
                       G_OBJECT_CLASS_TYPE (obj_class),
@@ -105,34 +260,226 @@ static void ternary_plot_class_init (TernaryPlotClass *class)
                       G_TYPE_NONE, 3,
                       G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE);
 
+    signals[POINT_DRAGGING] =
+        g_signal_new ("point-dragging",
+                      G_OBJECT_CLASS_TYPE (obj_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (TernaryPlotClass, point_dragging),
+                      NULL, NULL,
+                      ternaryplot_marshal_VOID__DOUBLE_DOUBLE_DOUBLE,
+                      G_TYPE_NONE, 3,
+                      G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE);
+
+    signals[POINT_HOVERED] =
+        g_signal_new ("point-hovered",
+                      G_OBJECT_CLASS_TYPE (obj_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (TernaryPlotClass, point_hovered),
+                      NULL, NULL,
+                      ternaryplot_marshal_VOID__INT64,
+                      G_TYPE_NONE, 1,
+                      G_TYPE_INT64);
+
+    signals[POINT_ACTIVATED] =
+        g_signal_new ("point-activated",
+                      G_OBJECT_CLASS_TYPE (obj_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (TernaryPlotClass, point_activated),
+                      NULL, NULL,
+                      ternaryplot_marshal_VOID__INT64,
+                      G_TYPE_NONE, 1,
+                      G_TYPE_INT64);
+
+    signals[SELECTION_CHANGED] =
+        g_signal_new ("selection-changed",
+                      G_OBJECT_CLASS_TYPE (obj_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (TernaryPlotClass, selection_changed),
+                      NULL, NULL,
+                      g_cclosure_marshal_VOID__VOID,
+                      G_TYPE_NONE, 0);
+
     /* event handlers */
     widget_class->expose_event = ternary_plot_expose;
     widget_class->button_press_event = ternary_plot_button_press;
     widget_class->button_release_event = ternary_plot_button_release;
     widget_class->motion_notify_event = ternary_plot_motion_notify;
+    widget_class->leave_notify_event = ternary_plot_leave_notify;
+    widget_class->scroll_event = ternary_plot_scroll;
+    widget_class->query_tooltip = ternary_plot_query_tooltip;
     widget_class->size_allocate = ternary_plot_size_allocate;
 
     g_type_class_add_private (obj_class, sizeof (TernaryPlotPrivate));
 }
 
+static gboolean ternary_plot_dump_stats (gpointer data)
+{
+    gchar *report;
+
+    report = ternary_stats_report (TERNARY_PLOT_GET_PRIVATE (data)->stats);
+    g_printerr ("TernaryPlot %p:\n%s", data, report);
+    g_free (report);
+
+    return TRUE;
+}
+
+/* TERNARYPLOT_STATS=n dumps the timings every n seconds while they are
+ * gathered; returns FALSE if it is not set */
+static gboolean start_stats_dump (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+    const gchar *stats;
+    guint interval;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    stats = g_getenv ("TERNARYPLOT_STATS");
+    if (stats == NULL || *stats == '\0')
+        return FALSE;
+
+    interval = g_ascii_strtoull (stats, NULL, 10);
+    priv->stats_dump_id = g_timeout_add_seconds (
+        interval > 0 ? interval : STATS_INTERVAL,
+        ternary_plot_dump_stats, plot);
+
+    return TRUE;
+}
+
 static void ternary_plot_init (TernaryPlot *plot)
 {
     TernaryPlotPrivate *priv;
 
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    priv->x = 0.1;
-    priv->y = 0.3;
-    priv->z = 0.6;
+    ternary_render_state_init (&priv->state);
+    priv->state.x = 0.1;
+    priv->state.y = 0.3;
+    priv->state.z = 0.6;
 
     plot->tol = 0.1;
-    priv->grid_step = 0.1; /* 10% */
+    priv->state.grid_step = 0.1; /* 10% */
+    priv->state.glyphs = ternary_glyphs_new ();
 
     priv->is_dragged = FALSE;
-
+    priv->drag_rate = 30.0;
+    priv->density_resolution = 64;
+    priv->hovered = -1;
+    priv->stream = ternary_ring_new (STREAM_CAPACITY);
+    g_rw_lock_init (&priv->stream_lock);
+    priv->overflow_policy = TERNARY_PLOT_OVERFLOW_DROP_OLDEST;
+    priv->tiles = ternary_tiles_new (ternary_plot_tiles_ready, plot);
+    priv->raster = ternary_raster_new (ternary_plot_raster_ready, plot);
+    priv->bandwidth = 0.05; /* 5% */
+    priv->contours = ternary_contours_new (ternary_plot_contours_ready, plot);
+    priv->state.trajectory = ternary_trajectory_new ();
+    priv->state.selection = ternary_selection_new (0);
+    priv->composition = ternary_composition_new ();
+    priv->constraints = ternary_constraints_new ();
+
+    if (start_stats_dump (plot))
+        priv->stats = ternary_stats_new ();
+
+    /* hints deliver at most one motion event per pointer query */
     gtk_widget_add_events (GTK_WIDGET (plot),
         GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK |
-        GDK_POINTER_MOTION_MASK);
+        GDK_POINTER_MOTION_MASK | GDK_POINTER_MOTION_HINT_MASK |
+        GDK_LEAVE_NOTIFY_MASK | GDK_SCROLL_MASK);
+    gtk_widget_set_has_tooltip (GTK_WIDGET (plot), TRUE);
+}
+
+/* drops the pyramid, unless the data set owns it */
+static void release_pyramid (TernaryPlotPrivate *priv)
+{
+    if (!priv->pyramid_shared)
+        ternary_pyramid_free (priv->state.pyramid);
+    priv->state.pyramid = NULL;
+    priv->pyramid_shared = FALSE;
+}
+
+/* drops the histogram, unless the data set owns it */
+static void release_density (TernaryPlotPrivate *priv)
+{
+    if (!priv->density_shared)
+        ternary_density_free (priv->state.density);
+    priv->state.density = NULL;
+    priv->density_shared = FALSE;
+}
+
+/* lets go of the columns, whoever owns them; the caller notifies
+ * "dataset" if one was set */
+static void release_points (TernaryPlotPrivate *priv)
+{
+    priv->dataset = NULL;
+    if (priv->points_destroy)
+        priv->points_destroy (priv->points_data);
+    else
+    {
+        g_free (priv->state.xs);
+        g_free (priv->state.ys);
+        g_free (priv->state.zs);
+    }
+
+    priv->points_destroy = NULL;
+    priv->points_data = NULL;
+    priv->state.xs = priv->state.ys = priv->state.zs = NULL;
+    priv->state.fixed = NULL;
+    priv->state.n_points = 0;
+    priv->points_capacity = 0;
+}
+
+/* makes room for more points, copying borrowed columns first, which
+ * detaches the data set if any; the caller notifies "dataset" */
+static void grow_points (TernaryPlotPrivate *priv)
+{
+    gsize n = priv->state.n_points;
+
+    /* no worker may read columns that move */
+    ternary_tiles_invalidate (priv->tiles);
+    ternary_raster_invalidate (priv->raster);
+    ternary_contours_cancel (priv->contours);
+    priv->points_capacity = MAX (2 * priv->points_capacity, 1024);
+
+    if (priv->points_destroy)
+    {
+        gdouble *xs, *ys, *zs;
+
+        xs = g_new (gdouble, priv->points_capacity);
+        ys = g_new (gdouble, priv->points_capacity);
+        zs = g_new (gdouble, priv->points_capacity);
+        if (priv->state.fixed)
+            ternary_fixed_decode (priv->state.fixed, 0, n, xs, ys, zs);
+        else
+        {
+            memcpy (xs, priv->state.xs, n * sizeof (gdouble));
+            memcpy (ys, priv->state.ys, n * sizeof (gdouble));
+            memcpy (zs, priv->state.zs, n * sizeof (gdouble));
+        }
+
+        /* whatever the data set derived is kept up to date here now */
+        if (priv->dataset)
+        {
+            release_pyramid (priv);
+            if (priv->density_shared)
+            {
+                priv->state.density = ternary_density_copy (priv->state.density);
+                priv->density_shared = FALSE;
+            }
+            priv->dataset = NULL;
+        }
+
+        priv->points_destroy (priv->points_data);
+        priv->points_destroy = NULL;
+        priv->points_data = NULL;
+        priv->state.xs = xs;
+        priv->state.ys = ys;
+        priv->state.zs = zs;
+        priv->state.fixed = NULL;
+        return;
+    }
+
+    priv->state.xs = g_renew (gdouble, priv->state.xs, priv->points_capacity);
+    priv->state.ys = g_renew (gdouble, priv->state.ys, priv->points_capacity);
+    priv->state.zs = g_renew (gdouble, priv->state.zs, priv->points_capacity);
 }
 
 static void ternary_plot_finalize (GObject *object)
@@ -141,12 +488,53 @@ static void ternary_plot_finalize (GObject *object)
 
     priv = TERNARY_PLOT_GET_PRIVATE (object);
 
-    if (priv->xlabel)
-        g_free (priv->xlabel);
-    if (priv->ylabel)
-        g_free (priv->ylabel);
-    if (priv->zlabel)
-        g_free (priv->zlabel);
+    /* workers may still be drawing from the data */
+    ternary_tiles_free (priv->tiles);
+    ternary_raster_free (priv->raster);
+    ternary_contours_free (priv->contours);
+    ternary_contour_set_free (priv->state.contours);
+
+    if (priv->state.xlabel)
+        g_free (priv->state.xlabel);
+    if (priv->state.ylabel)
+        g_free (priv->state.ylabel);
+    if (priv->state.zlabel)
+        g_free (priv->state.zlabel);
+    ternary_glyphs_free (priv->state.glyphs);
+
+    if (priv->motion_idle_id)
+        g_source_remove (priv->motion_idle_id);
+    if (priv->drag_timeout_id)
+        g_source_remove (priv->drag_timeout_id);
+    if (priv->contours_timeout_id)
+        g_source_remove (priv->contours_timeout_id);
+    if (priv->stats_dump_id)
+        g_source_remove (priv->stats_dump_id);
+    ternary_stats_free (priv->stats);
+    ternary_constraints_free (priv->constraints);
+
+    release_points (priv);
+    release_pyramid (priv);
+    release_density (priv);
+    g_free (priv->state.values);
+    g_free (priv->state.sizes);
+    ternary_index_free (priv->index);
+    ternary_ring_free (priv->stream);
+    g_rw_lock_clear (&priv->stream_lock);
+    if (priv->field_surface)
+        cairo_surface_destroy (priv->field_surface);
+    if (priv->trajectory_surface)
+        cairo_surface_destroy (priv->trajectory_surface);
+    ternary_trajectory_free (priv->state.trajectory);
+    if (priv->selection_surface)
+        cairo_surface_destroy (priv->selection_surface);
+    ternary_selection_free (priv->state.selection);
+    ternary_composition_free (priv->composition);
+    if (priv->lasso_x)
+    {
+        g_array_free (priv->lasso_x, TRUE);
+        g_array_free (priv->lasso_y, TRUE);
+    }
 
     G_OBJECT_CLASS (ternary_plot_parent_class)->finalize (object);
 }
@@ -161,6 +549,39 @@ static void ternary_plot_get_property (GObject *object, guint prop_id,
     case PROP_TOLERANCE:
         g_value_set_double (value, plot->tol);
         break;
+    case PROP_GRID_STEP:
+        g_value_set_double (value, ternary_plot_get_grid_step (plot));
+        break;
+    case PROP_DRAG_RATE:
+        g_value_set_double (value, ternary_plot_get_drag_rate (plot));
+        break;
+    case PROP_DENSITY:
+        g_value_set_boolean (value, ternary_plot_get_density (plot));
+        break;
+    case PROP_DENSITY_RESOLUTION:
+        g_value_set_uint (value, ternary_plot_get_density_resolution (plot));
+        break;
+    case PROP_CONTOURS:
+        g_value_set_boolean (value, ternary_plot_get_contours (plot));
+        break;
+    case PROP_BANDWIDTH:
+        g_value_set_double (value, ternary_plot_get_bandwidth (plot));
+        break;
+    case PROP_SUMMARY:
+        g_value_set_boolean (value, ternary_plot_get_summary (plot));
+        break;
+    case PROP_SUMMARY_LEVEL:
+        g_value_set_double (value, ternary_plot_get_summary_level (plot));
+        break;
+    case PROP_STATS_ENABLED:
+        g_value_set_boolean (value, ternary_plot_get_stats_enabled (plot));
+        break;
+    case PROP_STATS:
+        g_value_take_string (value, ternary_plot_get_stats (plot));
+        break;
+    case PROP_DATASET:
+        g_value_set_object (value, ternary_plot_get_dataset (plot));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -177,352 +598,2079 @@ static void ternary_plot_set_property (GObject *object, guint prop_id,
     case PROP_TOLERANCE:
         ternary_plot_set_tolerance (plot, g_value_get_double (value));
         break;
+    case PROP_GRID_STEP:
+        ternary_plot_set_grid_step (plot, g_value_get_double (value));
+        break;
+    case PROP_DRAG_RATE:
+        ternary_plot_set_drag_rate (plot, g_value_get_double (value));
+        break;
+    case PROP_DENSITY:
+        ternary_plot_set_density (plot, g_value_get_boolean (value));
+        break;
+    case PROP_DENSITY_RESOLUTION:
+        ternary_plot_set_density_resolution (plot, g_value_get_uint (value));
+        break;
+    case PROP_CONTOURS:
+        ternary_plot_set_contours (plot, g_value_get_boolean (value));
+        break;
+    case PROP_BANDWIDTH:
+        ternary_plot_set_bandwidth (plot, g_value_get_double (value));
+        break;
+    case PROP_SUMMARY:
+        ternary_plot_set_summary (plot, g_value_get_boolean (value));
+        break;
+    case PROP_SUMMARY_LEVEL:
+        ternary_plot_set_summary_level (plot, g_value_get_double (value));
+        break;
+    case PROP_STATS_ENABLED:
+        ternary_plot_set_stats_enabled (plot, g_value_get_boolean (value));
+        break;
+    case PROP_DATASET:
+        ternary_plot_set_dataset (plot, g_value_get_object (value));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
     }
 }
 
-static void draw_field (GtkWidget *plot, cairo_t *cr)
+static void draw_background (GtkWidget *plot, cairo_t *cr)
 {
-    gdouble frac;
     TernaryPlotPrivate *priv;
 
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    /* large triangle */
-    cairo_move_to (cr, priv->x1, priv->y1);
-    cairo_line_to (cr, priv->x2, priv->y2);
-    cairo_line_to (cr, priv->x3, priv->y3);
-    cairo_close_path (cr);
-    cairo_set_source_rgb (cr, 1, 1, 1);
-    cairo_fill_preserve (cr);
-    cairo_set_source_rgb (cr, 0, 0, 0);
-    cairo_stroke (cr);
-
-    cairo_save (cr); /* stack-pen-size */
-
-    /* 10% lines */
-    cairo_set_line_width (cr, 0.25 * cairo_get_line_width (cr));
-    cairo_set_source_rgb (cr, .8, .8, .8);
-
-    /* small triangle */
-    cairo_move_to (cr, (priv->x1+priv->x2)/2, (priv->y1+priv->y2)/2);
-    cairo_line_to (cr, (priv->x2+priv->x3)/2, (priv->y2+priv->y3)/2);
-    cairo_line_to (cr, (priv->x3+priv->x1)/2, (priv->y3+priv->y1)/2);
-    cairo_close_path(cr);
-    cairo_stroke (cr);
-
-    for (frac = priv->grid_step; frac < 0.5; frac += priv->grid_step)
+    /* the field only depends on the allocation and the grid step, so it
+     * is rendered once and blitted on every expose */
+    if (priv->field_surface == NULL)
     {
-        cairo_move_to (cr, frac*priv->x1 + (1-frac)*priv->x2, frac*priv->y1 + (1-frac)*priv->y2);
-        cairo_line_to (cr, (1-frac)*priv->x2 + frac*priv->x3, (1-frac)*priv->y2 + frac*priv->y3);
-        cairo_line_to (cr, frac*priv->x3 + (1-frac)*priv->x1, frac*priv->y3 + (1-frac)*priv->y1);
-        cairo_line_to (cr, (1-frac)*priv->x1 + frac*priv->x2, (1-frac)*priv->y1 + frac*priv->y2);
-        cairo_line_to (cr, frac*priv->x2 + (1-frac)*priv->x3, frac*priv->y2 + (1-frac)*priv->y3);
-        cairo_line_to (cr, (1-frac)*priv->x3 + frac*priv->x1, (1-frac)*priv->y3 + frac*priv->y1);
-        cairo_close_path(cr);
-        cairo_stroke (cr);
+        cairo_t *field_cr;
+
+        priv->field_surface = cairo_surface_create_similar (
+            cairo_get_target (cr), CAIRO_CONTENT_COLOR_ALPHA,
+            plot->allocation.x + plot->allocation.width,
+            plot->allocation.y + plot->allocation.height);
+        field_cr = cairo_create (priv->field_surface);
+        ternary_render_field (&priv->state, field_cr);
+        cairo_destroy (field_cr);
     }
-    cairo_restore (cr); /* stack-pen-size */
+
+    cairo_set_source_surface (cr, priv->field_surface, 0, 0);
+    cairo_paint (cr);
 }
 
-static void draw_label (cairo_t *cr, const char *label, gdouble percent,
-    gdouble percent_witdh, gdouble x, gdouble y, gdouble angle)
+static void invalidate_field (TernaryPlotPrivate *priv)
 {
-    gchar percent_label[12]; /* : 100.0% */
-    cairo_text_extents_t extents;
-
-    g_snprintf (percent_label, sizeof(percent_label), ": %.1f%%", percent);
-    cairo_text_extents (cr, label, &extents);
-    cairo_move_to (cr, x, y);
-    cairo_rotate (cr, angle);
-    cairo_rel_move_to (cr, (-extents.width - percent_witdh)/2,
-                       angle == 0.0 ?
-                       (extents.height + 2) :
-                       (-extents.height - extents.y_bearing - 2));
-    cairo_show_text (cr, label);
-    cairo_show_text (cr, percent_label);
-    cairo_rotate (cr, -angle);
+    if (priv->field_surface)
+    {
+        cairo_surface_destroy (priv->field_surface);
+        priv->field_surface = NULL;
+    }
 }
 
-static void draw_labels (GtkWidget *plot, cairo_t *cr)
+/* Keeps the trajectory on a surface of its own and strokes only the
+ * samples appended since the last expose onto it, so the cost of a
+ * frame follows what was added rather than the whole path. */
+static void draw_trajectory (GtkWidget *plot, cairo_t *cr)
 {
     TernaryPlotPrivate *priv;
+    gsize n;
 
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    /* font settings */
-    cairo_set_font_size (cr, 12);
-    cairo_select_font_face (cr, "Nimbus Sans L", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    n = ternary_trajectory_get_length (priv->state.trajectory);
+    if (n == 0)
+        return;
+
+    if (priv->trajectory_surface == NULL)
+    {
+        priv->trajectory_surface = cairo_surface_create_similar (
+            cairo_get_target (cr), CAIRO_CONTENT_COLOR_ALPHA,
+            plot->allocation.x + plot->allocation.width,
+            plot->allocation.y + plot->allocation.height);
+        priv->trajectory_drawn = 0;
+    }
 
-    if (priv->percent_width == 0.0) {
-        cairo_text_extents_t extents;
-        cairo_text_extents (cr, ": 100.0%", &extents);
-        priv->percent_width = extents.width;
+    if (priv->trajectory_drawn < n)
+    {
+        cairo_t *trajectory_cr;
+
+        /* from the last sample drawn, so the new segments join it */
+        trajectory_cr = cairo_create (priv->trajectory_surface);
+        ternary_render_trajectory (&priv->state, trajectory_cr,
+            priv->trajectory_drawn > 0 ? priv->trajectory_drawn - 1 : 0, n);
+        cairo_destroy (trajectory_cr);
+        priv->trajectory_drawn = n;
     }
 
-    draw_label (cr, priv->xlabel, 100 * priv->x, priv->percent_width,
-                (priv->x2 + priv->x3) / 2, (priv->y2 + priv->y3) / 2, 0.0);
-    draw_label (cr, priv->ylabel, 100 * priv->y, priv->percent_width,
-                (priv->x1 + priv->x3) / 2, (priv->y1 + priv->y3) / 2, -M_PI / 3);
-    draw_label (cr, priv->zlabel, 100 * priv->z, priv->percent_width,
-                (priv->x1 + priv->x2) / 2, (priv->y1 + priv->y2) / 2, M_PI / 3);
+    cairo_set_source_surface (cr, priv->trajectory_surface, 0, 0);
+    cairo_paint (cr);
 }
 
-static void draw_pointer (GtkWidget *plot, cairo_t *cr)
+/* the transform or the style changed, everything is stroked again */
+static void invalidate_trajectory (TernaryPlotPrivate *priv)
+{
+    if (priv->trajectory_surface)
+    {
+        cairo_surface_destroy (priv->trajectory_surface);
+        priv->trajectory_surface = NULL;
+    }
+}
+
+/* The selected points are marked on a layer of their own, so changing
+ * the selection never redraws the data layer under it. */
+static void draw_selection (GtkWidget *plot, cairo_t *cr)
 {
-    gdouble px, py;
     TernaryPlotPrivate *priv;
 
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    /* altitudes */
-    px = priv->x * priv->x1 + priv->y * priv->x2 + priv->z * priv->x3;
-    py = priv->x * priv->y1 + priv->y * priv->y2 + priv->z * priv->y3;
-    cairo_set_source_rgb (cr, 0, 0, 0);
-    cairo_move_to (cr,
-        px + priv->x * ((priv->x2 + priv->x3) / 2 - priv->x1),
-        py + priv->x * ((priv->y2 + priv->y3) / 2 - priv->y1));
-    cairo_line_to (cr, px, py);
-    cairo_rel_line_to (cr,
-        priv->y * ((priv->x1 + priv->x3) / 2 - priv->x2),
-        priv->y * ((priv->y1 + priv->y3) / 2 - priv->y2));
-    cairo_stroke (cr);
-    cairo_move_to (cr, px, py);
-    cairo_rel_line_to (cr,
-        priv->z * ((priv->x1 + priv->x2) / 2 - priv->x3),
-        priv->z * ((priv->y1 + priv->y2) / 2 - priv->y3));
-    cairo_stroke (cr);
+    if (priv->state.selection->n_selected == 0)
+        return;
 
-    /* pointer */
-    cairo_arc (cr, px, py, 5, 0, 2 * M_PI);
-    cairo_close_path(cr);
-    cairo_set_source_rgb (cr, 0.8, 0.8, 0.8);
-    cairo_fill_preserve (cr);
-    cairo_set_source_rgb (cr, 0, 0, 0);
-    cairo_stroke (cr);
+    if (priv->selection_surface == NULL)
+    {
+        priv->selection_surface = cairo_image_surface_create (
+            CAIRO_FORMAT_ARGB32,
+            plot->allocation.x + plot->allocation.width,
+            plot->allocation.y + plot->allocation.height);
+        ternary_render_selection (&priv->state, priv->selection_surface);
+    }
+
+    cairo_save (cr);
+    if (priv->state.view_side < 1.0)
+    {
+        ternary_render_view_path (&priv->state, cr);
+        cairo_clip (cr);
+    }
+    cairo_set_source_surface (cr, priv->selection_surface, 0, 0);
+    cairo_paint (cr);
+    cairo_restore (cr);
 }
 
-static void ternary_plot_size_allocate (GtkWidget *plot,
-    GdkRectangle *allocation)
+/* the selection, the points or the transform changed */
+static void invalidate_selection (TernaryPlotPrivate *priv)
+{
+    if (priv->selection_surface)
+    {
+        cairo_surface_destroy (priv->selection_surface);
+        priv->selection_surface = NULL;
+    }
+}
+
+static void selection_changed (GtkWidget *plot)
+{
+    invalidate_selection (TERNARY_PLOT_GET_PRIVATE (plot));
+    gtk_widget_queue_draw (plot);
+    g_signal_emit (plot, signals[SELECTION_CHANGED], 0);
+}
+
+/* open outline of the lasso while it is drawn */
+static void draw_lasso (GtkWidget *plot, cairo_t *cr)
 {
-    gdouble xc, yc;
     TernaryPlotPrivate *priv;
+    gdouble px, py;
+    guint i;
 
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    /* radius and center */
-    priv->radius = (MIN (allocation->width,
-                         (allocation->height - 15) / sin (M_PI / 3)) - 5)*
-                         sin (M_PI / 3) * 2 / 3;
-    xc = allocation->x + allocation->width / 2;
-    yc = allocation->y + (allocation->height - 15) * 2 / 3;
+    if (priv->lasso_x == NULL || priv->lasso_x->len < 2)
+        return;
 
-    /* vertices */
-    priv->x1 = xc + priv->radius * 0; /* cos (-M_PI/2) */
-    priv->y1 = yc + priv->radius * -1; /* sin (-M_PI/2) */
-    priv->x2 = xc + priv->radius * sqrt (3)/2; /* cos (-11*M_PI/6) */
-    priv->y2 = yc + priv->radius * 0.5; /* sin (-11*M_PI/6) */
-    priv->x3 = xc + priv->radius * -sqrt (3)/2; /* cos (-7*M_PI/6) */
-    priv->y3 = yc + priv->radius * 0.5; /* sin (-7*M_PI/6) */
-
-    GTK_WIDGET_CLASS (ternary_plot_parent_class)->size_allocate (plot, allocation);
+    cairo_save (cr);
+    cairo_new_path (cr);
+    for (i = 0; i < priv->lasso_x->len; i++)
+    {
+        ternary_render_to_pixel (&priv->state,
+            g_array_index (priv->lasso_x, gdouble, i),
+            g_array_index (priv->lasso_y, gdouble, i), &px, &py);
+        cairo_line_to (cr, px, py);
+    }
+    cairo_set_source_rgb (cr, 0.2, 0.2, 0.2);
+    cairo_set_line_width (cr, 1.0);
+    cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+    cairo_stroke (cr);
+    cairo_restore (cr);
 }
 
-static gboolean ternary_plot_expose (GtkWidget* plot, GdkEventExpose *event)
+static void draw_labels (GtkWidget *plot, cairo_t *cr, GdkRegion *region)
 {
-    cairo_t *cr;
-
-    /* get a cairo_t */
-    cr = gdk_cairo_create (plot->window);
-
-    /* set a clip region for the expose event */
-    cairo_rectangle (cr,
-        event->area.x, event->area.y,
-        event->area.width, event->area.height);
-    cairo_clip (cr);
+    TernaryPlotPrivate *priv;
+    gint i;
 
-    draw_field (plot, cr);
-    draw_pointer (plot, cr);
-    draw_labels (plot, cr);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    cairo_destroy (cr);
+    /* skip the pass when none of the labels are damaged */
+    for (i = 0; i < 3; i++)
+        if (priv->state.label_bounds[i].width == 0 ||
+            gdk_region_rect_in (region, &priv->state.label_bounds[i]) != GDK_OVERLAP_RECTANGLE_OUT)
+            break;
+    if (i == 3)
+        return;
 
-    return FALSE;
+    ternary_render_labels (&priv->state, cr);
 }
 
-static gboolean ternary_plot_button_press (GtkWidget *plot, GdkEventButton *event)
+static void queue_draw_pointer (GtkWidget *plot)
 {
     TernaryPlotPrivate *priv;
-    gdouble dx, dy;
+    GdkRegion *region;
+    GdkRectangle bounds;
+    gint i;
 
-    if (event->button != 1)
-        return FALSE;
+    if (!GTK_WIDGET_REALIZED (plot))
+        return;
 
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    /* distance from mouse coordinates to pointer */
-    dx = priv->x * priv->x1 + priv->y * priv->x2 + priv->z * priv->x3 - event->x;
-    dy = priv->x * priv->y1 + priv->y * priv->y2 + priv->z * priv->y3 - event->y;
-
-    /* if closer than SENSITIVITY_THRESH pixels, start dragging */
-    if (dx * dx + dy * dy < SENSITIVITY_THRESH * SENSITIVITY_THRESH)
-        priv->is_dragged = TRUE;
+    /* everything that depends on the current value */
+    ternary_render_pointer_bounds (&priv->state, &bounds);
+    region = gdk_region_rectangle (&bounds);
+    for (i = 0; i < 3; i++)
+        gdk_region_union_with_rect (region, &priv->state.label_bounds[i]);
 
-    return FALSE;
+    gdk_window_invalidate_region (plot->window, region, FALSE);
+    gdk_region_destroy (region);
 }
 
-static gboolean ternary_plot_motion_notify (GtkWidget *plot, GdkEventMotion *event)
+static void draw_points (GtkWidget *plot, cairo_t *cr)
 {
-    gdouble z;
     TernaryPlotPrivate *priv;
+    gboolean build_pyramid;
 
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    if (!priv->is_dragged)
-        return FALSE;
+    if (priv->state.n_points == 0)
+        return;
 
-    z = ternary_plot_dot_to_line_distance (event->x, event->y,
-        priv->x2, priv->y2, priv->x1, priv->y1) / (1.5 * priv->radius);
-    if (z >= 0)
+    /* another plot of the data set may have built its pyramid */
+    if (priv->dataset && priv->state.pyramid == NULL &&
+        ternary_dataset_peek_pyramid (priv->dataset))
     {
-        gdouble y;
-        y = ternary_plot_dot_to_line_distance (event->x, event->y,
-            priv->x1, priv->y1, priv->x3, priv->y3) / (1.5 * priv->radius);
-        if (y >= 0)
-        {
-            gdouble x;
-            x = ternary_plot_dot_to_line_distance (event->x, event->y,
-                priv->x3, priv->y3, priv->x2, priv->y2) / (1.5 * priv->radius);
-            if (x >= 0)
-            {
-                priv->x = x;
-                priv->y = y;
-                priv->z = z;
+        priv->state.pyramid = ternary_dataset_peek_pyramid (priv->dataset);
+        priv->pyramid_shared = TRUE;
+    }
 
-                gtk_widget_queue_draw (plot);
-            }
-        }
+    build_pyramid = !priv->density_enabled && priv->state.pyramid == NULL &&
+        priv->state.n_points >= PYRAMID_THRESHOLD;
+
+    /* zoomed views go through the tile cache */
+    if (priv->state.view_side < 1.0)
+    {
+        GdkRectangle area;
+        gdouble left, top, right, bottom;
+
+        cairo_save (cr);
+        ternary_render_view_path (&priv->state, cr);
+        cairo_clip (cr);
+        cairo_clip_extents (cr, &left, &top, &right, &bottom);
+        area.x = floor (left);
+        area.y = floor (top);
+        area.width = ceil (right) - area.x;
+        area.height = ceil (bottom) - area.y;
+        /* the tiles draw from the pyramid, built first by the tile
+         * workers as it is along with the full view layer otherwise */
+        ternary_tiles_paint (priv->tiles, &priv->state, cr, &area,
+                             build_pyramid, priv->dataset);
+        cairo_restore (cr);
+        return;
     }
 
-    return FALSE;
+    /* the previous layer stays up while its replacement is drawn */
+    ternary_raster_paint (priv->raster, &priv->state, cr,
+        plot->allocation.x + plot->allocation.width,
+        plot->allocation.y + plot->allocation.height, build_pyramid,
+        priv->dataset);
 }
 
-static gboolean ternary_plot_button_release (GtkWidget *widget, GdkEventButton *event)
+static void invalidate_points (TernaryPlotPrivate *priv)
 {
-    TernaryPlot *plot;
-    TernaryPlotPrivate *priv;
-    gdouble round_err;
-    gdouble new_x, new_y, new_z;
-    gdouble tol;
-
-    plot = TERNARY_PLOT (widget);
-    priv = TERNARY_PLOT_GET_PRIVATE (plot);
-
-    if (event->button != 1 || !priv->is_dragged)
-        return FALSE;
-
-    tol = plot->tol;
+    ternary_tiles_invalidate (priv->tiles);
+    ternary_raster_invalidate (priv->raster);
+}
 
-    new_x = roundf (priv->x / tol) * tol;
-    new_y = roundf (priv->y / tol) * tol;
-    new_z = roundf (priv->z / tol) * tol;
+static void update_density (TernaryPlotPrivate *priv)
+{
+    /* no worker may bin from the old histogram */
+    ternary_tiles_invalidate (priv->tiles);
+    ternary_raster_invalidate (priv->raster);
 
-    round_err = 1.0 - (new_x + new_y + new_z);
-    if (fabs (round_err) > tol / 2)
+    if (!priv->density_enabled)
     {
-        gdouble dx, dy, dz;
-        dx = (priv->x - new_x) / round_err;
-        dy = (priv->y - new_y) / round_err;
-        dz = (priv->z - new_z) / round_err;
-
-        if (dx > dy && dx > dz)
-            new_x += round_err;
-        else if (dy > dz)
-            new_y += round_err;
-        else
-            new_z += round_err;
+        release_density (priv);
+        return;
+    }
 
+    /* one histogram serves every plot of a data set */
+    if (priv->dataset)
+    {
+        release_density (priv);
+        priv->state.density = ternary_dataset_get_density (priv->dataset,
+            priv->density_resolution);
+        priv->density_shared = TRUE;
+        return;
     }
 
-    priv->x = new_x;
-    priv->y = new_y;
-    priv->z = new_z;
+    if (priv->density_shared)
+        release_density (priv);
+    if (priv->state.density == NULL ||
+        priv->state.density->resolution != priv->density_resolution)
+    {
+        ternary_density_free (priv->state.density);
+        priv->state.density = ternary_density_new (priv->density_resolution);
+    }
+    else
+        ternary_density_clear (priv->state.density);
 
-    gtk_widget_queue_draw (widget);
+    ternary_density_add (priv->state.density, priv->state.xs, priv->state.ys, priv->state.zs,
+        priv->state.n_points);
+}
 
-    priv->is_dragged = FALSE;
+/* starts estimating the isolines of the current points over */
+static void update_contours (TernaryPlotPrivate *priv)
+{
+    if (priv->contours_timeout_id)
+    {
+        g_source_remove (priv->contours_timeout_id);
+        priv->contours_timeout_id = 0;
+    }
 
-    g_signal_emit (plot, signals[POINT_CHANGED], 0, priv->x, priv->y, priv->z);
+    if (priv->contours_enabled && priv->state.fixed)
+    {
+        ternary_contours_update_fixed (priv->contours, priv->state.fixed,
+            priv->bandwidth);
+        return;
+    }
+    if (priv->contours_enabled)
+    {
+        ternary_contours_update (priv->contours, priv->state.xs,
+            priv->state.ys, priv->state.zs, priv->state.n_points,
+            priv->bandwidth);
+        return;
+    }
 
-    return FALSE;
+    ternary_contours_cancel (priv->contours);
+    ternary_contour_set_free (priv->state.contours);
+    priv->state.contours = NULL;
 }
 
-GtkWidget * ternary_plot_new (void)
+/* brings the summary up to the current points, reading only the rows
+ * added since it was last used */
+static void sync_summary (TernaryPlotPrivate *priv)
 {
-    return g_object_new (TERNARY_TYPE_PLOT, NULL);
+    ternary_composition_update (priv->composition, priv->state.xs,
+        priv->state.ys, priv->state.fixed, priv->state.n_points);
 }
 
-void ternary_plot_set_xlabel (TernaryPlot *plot, const gchar *xlabel)
+/* damages where the summary is drawn */
+static void queue_draw_summary (GtkWidget *plot)
 {
     TernaryPlotPrivate *priv;
+    GdkRectangle bounds;
 
-    g_return_if_fail (TERNARY_IS_PLOT (plot));
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    if (priv->xlabel != NULL)
-        g_free (priv->xlabel);
-    priv->xlabel = g_strdup (xlabel);
+    if (GTK_WIDGET_REALIZED (plot) &&
+        ternary_render_summary_bounds (&priv->state, &bounds))
+        gdk_window_invalidate_rect (plot->window, &bounds, FALSE);
 }
 
-void ternary_plot_set_ylabel (TernaryPlot *plot, const gchar *ylabel)
+static void ternary_plot_size_allocate (GtkWidget *plot,
+    GdkRectangle *allocation)
 {
     TernaryPlotPrivate *priv;
 
-    g_return_if_fail (TERNARY_IS_PLOT (plot));
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    if (priv->ylabel != NULL)
-        g_free (priv->ylabel);
-    priv->ylabel = g_strdup (ylabel);
-}
-
-void ternary_plot_set_zlabel (TernaryPlot *plot, const gchar *zlabel)
-{
-    TernaryPlotPrivate *priv;
+    ternary_render_set_geometry (&priv->state, allocation->x, allocation->y,
+        allocation->width, allocation->height);
 
-    g_return_if_fail (TERNARY_IS_PLOT (plot));
-    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    /* tiles are laid on a plane sized from the allocation */
+    ternary_tiles_clear (priv->tiles);
+    invalidate_field (priv);
+    invalidate_points (priv);
+    invalidate_trajectory (priv);
+    invalidate_selection (priv);
 
-    if (priv->zlabel != NULL)
-        g_free (priv->zlabel);
-    priv->zlabel = g_strdup (zlabel);
+    GTK_WIDGET_CLASS (ternary_plot_parent_class)->size_allocate (plot, allocation);
 }
 
-void ternary_plot_set_point (TernaryPlot *plot, gdouble x, gdouble y, gdouble z)
+static gboolean ternary_plot_expose (GtkWidget* plot, GdkEventExpose *event)
 {
+    cairo_t *cr;
+    GdkRectangle bounds;
     TernaryPlotPrivate *priv;
+    gint64 start, t;
 
-    g_return_if_fail (TERNARY_IS_PLOT (plot));
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
-    priv->x = fabs (x) / (fabs (x) + fabs (y) + fabs (z));
-    priv->y = fabs (y) / (fabs (x) + fabs (y) + fabs (z));
-    priv->z = fabs (z) / (fabs (x) + fabs (y) + fabs (z));
+    start = t = ternary_stats_start (priv->stats);
 
-    g_signal_emit (plot, signals[POINT_CHANGED], 0, priv->x, priv->y, priv->z);
-}
+    /* get a cairo_t */
+    cr = gdk_cairo_create (plot->window);
 
-void ternary_plot_set_tolerance (TernaryPlot *plot, gdouble tol)
-{
-    gdouble tolerance;
+    /* set a clip region for the expose event */
+    gdk_cairo_region (cr, event->region);
+    cairo_clip (cr);
+
+    draw_background (plot, cr);
+    t = ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_FIELD, t);
+    draw_points (plot, cr);
+    draw_selection (plot, cr);
+    t = ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_DATA, t);
+    draw_trajectory (plot, cr);
+    t = ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_TRAJECTORY, t);
+    ternary_render_contours (&priv->state, cr);
+    t = ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_CONTOURS, t);
+    if (priv->summary_enabled)
+    {
+        sync_summary (priv);
+        ternary_render_summary (&priv->state, cr);
+        t = ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_SUMMARY, t);
+    }
+    draw_lasso (plot, cr);
+
+    ternary_render_pointer_bounds (&priv->state, &bounds);
+    if (gdk_region_rect_in (event->region, &bounds) != GDK_OVERLAP_RECTANGLE_OUT)
+    {
+        ternary_render_pointer (&priv->state, cr);
+        t = ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_POINTER, t);
+    }
+
+    draw_labels (plot, cr, event->region);
+    ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_LABELS, t);
+
+    cairo_destroy (cr);
+    ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_EXPOSE, start);
+
+    return FALSE;
+}
+
+static gssize find_point (GtkWidget *plot, gdouble px, gdouble py)
+{
+    TernaryPlotPrivate *priv;
+    TernaryIndex *index;
+    gdouble x, y, z, radius;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->state.n_points == 0 || priv->state.radius <= 0)
+        return -1;
+
+    if (priv->dataset)
+        index = ternary_dataset_get_index (priv->dataset);
+    else
+    {
+        if (priv->index == NULL)
+            priv->index = ternary_index_new (priv->state.xs, priv->state.ys, priv->state.n_points);
+        index = priv->index;
+    }
+
+    /* visible triangle side is sqrt (3) * radius pixels */
+    ternary_render_to_ternary (&priv->state, px, py, &x, &y, &z);
+    radius = SENSITIVITY_THRESH * priv->state.view_side /
+        (sqrt (3) * priv->state.radius);
+    if (priv->state.fixed)
+        return ternary_index_nearest_fixed (index, priv->state.fixed, x, y,
+                                            radius);
+    return ternary_index_nearest (index, priv->state.xs, priv->state.ys, x, y,
+        radius);
+}
+
+static void set_hovered (GtkWidget *plot, gssize hovered)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->hovered != hovered)
+    {
+        priv->hovered = hovered;
+        g_signal_emit (plot, signals[POINT_HOVERED], 0, (gint64) hovered);
+    }
+}
+
+static gboolean ternary_plot_query_tooltip (GtkWidget *plot, gint x, gint y,
+    gboolean keyboard_mode, GtkTooltip *tooltip)
+{
+    TernaryPlotPrivate *priv;
+    gssize point;
+    gdouble px, py, pz;
+    gchar *text;
+
+    if (keyboard_mode)
+        return FALSE;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    point = find_point (plot, x, y);
+    if (point < 0)
+        return FALSE;
+
+    if (priv->state.fixed)
+        ternary_fixed_get (priv->state.fixed, point, &px, &py, &pz);
+    else
+    {
+        px = priv->state.xs[point];
+        py = priv->state.ys[point];
+        pz = priv->state.zs[point];
+    }
+
+    text = g_strdup_printf ("%s: %.1f%%\n%s: %.1f%%\n%s: %.1f%%",
+        priv->state.xlabel ? priv->state.xlabel : "x", 100 * px,
+        priv->state.ylabel ? priv->state.ylabel : "y", 100 * py,
+        priv->state.zlabel ? priv->state.zlabel : "z", 100 * pz);
+    gtk_tooltip_set_text (tooltip, text);
+    g_free (text);
+
+    return TRUE;
+}
+
+static gboolean ternary_plot_button_press (GtkWidget *plot, GdkEventButton *event)
+{
+    TernaryPlotPrivate *priv;
+    gdouble dx, dy;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    /* middle button pans zoomed views */
+    if (event->button == 2 && priv->state.view_side < 1.0)
+    {
+        priv->is_panned = TRUE;
+        priv->pan_x = event->x;
+        priv->pan_y = event->y;
+        return FALSE;
+    }
+
+    if (event->button != 1)
+        return FALSE;
+
+    /* shift draws a lasso around points, control drags a range brush */
+    if (priv->state.n_points > 0 && (event->state & GDK_SHIFT_MASK))
+    {
+        gdouble x, y, z;
+
+        ternary_render_to_ternary (&priv->state, event->x, event->y, &x, &y, &z);
+        priv->lasso_x = g_array_new (FALSE, FALSE, sizeof (gdouble));
+        priv->lasso_y = g_array_new (FALSE, FALSE, sizeof (gdouble));
+        g_array_append_val (priv->lasso_x, x);
+        g_array_append_val (priv->lasso_y, y);
+        return FALSE;
+    }
+    if (priv->state.n_points > 0 && (event->state & GDK_CONTROL_MASK))
+    {
+        ternary_render_to_ternary (&priv->state, event->x, event->y,
+            &priv->brush_x, &priv->brush_y, &priv->brush_z);
+        priv->is_brushing = TRUE;
+        return FALSE;
+    }
+
+    /* distance from mouse coordinates to pointer */
+    ternary_render_to_pixel (&priv->state, priv->state.x, priv->state.y, &dx, &dy);
+    dx -= event->x;
+    dy -= event->y;
+
+    /* if closer than SENSITIVITY_THRESH pixels, start dragging */
+    if (dx * dx + dy * dy < SENSITIVITY_THRESH * SENSITIVITY_THRESH)
+        priv->is_dragged = TRUE;
+    else
+    {
+        gssize point;
+
+        point = find_point (plot, event->x, event->y);
+        if (point >= 0)
+            g_signal_emit (plot, signals[POINT_ACTIVATED], 0, (gint64) point);
+    }
+
+    return FALSE;
+}
+
+/* Moves the lower bounds of a view as little as possible so that none is
+ * negative and they leave exactly side for the visible triangle. */
+static void clamp_view (gdouble *m, gdouble side)
+{
+    gdouble excess;
+    gint i, n, pass;
+
+    excess = m[0] + m[1] + m[2] - (1.0 - side);
+    for (pass = 0; pass < 4; pass++)
+    {
+        for (i = 0; i < 3; i++)
+            if (m[i] < 0)
+            {
+                excess -= m[i];
+                m[i] = 0;
+            }
+        if (excess == 0.0)
+            break;
+
+        /* spread the difference over the bounds that can take it */
+        for (i = 0, n = 0; i < 3; i++)
+            n += excess < 0 || m[i] > 0;
+        for (i = 0; i < 3; i++)
+            if (excess < 0 || m[i] > 0)
+                m[i] -= excess / n;
+        excess = 0.0;
+    }
+}
+
+static void apply_view (GtkWidget *plot, gdouble *m, gdouble side)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    side = CLAMP (side, MIN_VIEW_SIDE, 1.0);
+    if (side >= 1.0)
+        m[0] = m[1] = m[2] = 0.0;
+    else
+        clamp_view (m, side);
+
+    priv->state.view_x = m[0];
+    priv->state.view_y = m[1];
+    priv->state.view_z = m[2];
+    priv->state.view_side = side;
+    ternary_render_set_geometry (&priv->state, plot->allocation.x,
+        plot->allocation.y, plot->allocation.width, plot->allocation.height);
+
+    invalidate_field (priv);
+    invalidate_trajectory (priv);
+    invalidate_selection (priv);
+    gtk_widget_queue_draw (plot);
+}
+
+static gboolean ternary_plot_scroll (GtkWidget *plot, GdkEventScroll *event)
+{
+    TernaryPlotPrivate *priv;
+    gdouble x, y, z, side, k, m[3];
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    /* halving keeps zooms on a fixed ladder, so tiles get reused */
+    if (event->direction == GDK_SCROLL_UP)
+        side = priv->state.view_side / 2;
+    else if (event->direction == GDK_SCROLL_DOWN)
+        side = priv->state.view_side * 2;
+    else
+        return FALSE;
+    if (side < MIN_VIEW_SIDE)
+        return TRUE;
+
+    /* keep the composition under the mouse in place */
+    ternary_render_to_ternary (&priv->state, event->x, event->y, &x, &y, &z);
+    k = side / priv->state.view_side;
+    m[0] = x - (x - priv->state.view_x) * k;
+    m[1] = y - (y - priv->state.view_y) * k;
+    m[2] = z - (z - priv->state.view_z) * k;
+    apply_view (plot, m, side);
+
+    return TRUE;
+}
+
+/* the same as for the full view layer */
+static void ternary_plot_tiles_ready (TernaryPyramid *pyramid, gpointer data)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (data);
+
+    if (pyramid && priv->state.pyramid == NULL)
+        priv->state.pyramid = pyramid;
+    else
+        ternary_pyramid_free (pyramid);
+    gtk_widget_queue_draw (GTK_WIDGET (data));
+}
+
+/* a pyramid built along with the layer is kept unless one turned up */
+static void ternary_plot_raster_ready (TernaryPyramid *pyramid, gpointer data)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (data);
+
+    if (pyramid && priv->state.pyramid == NULL)
+        priv->state.pyramid = pyramid;
+    else
+        ternary_pyramid_free (pyramid);
+    gtk_widget_queue_draw (GTK_WIDGET (data));
+}
+
+/* a coarser pass stays up until the next one arrives */
+static void ternary_plot_contours_ready (TernaryContourSet *set, gpointer data)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (data);
+
+    ternary_contour_set_free (priv->state.contours);
+    priv->state.contours = set;
+    gtk_widget_queue_draw (GTK_WIDGET (data));
+}
+
+static gboolean ternary_plot_drag_timeout (gpointer data)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (data);
+    priv->drag_timeout_id = 0;
+
+    if (priv->is_dragged)
+    {
+        priv->drag_emitted = g_get_monotonic_time ();
+        g_signal_emit (data, signals[POINT_DRAGGING], 0, priv->state.x, priv->state.y, priv->state.z);
+    }
+
+    return FALSE;
+}
+
+static void ternary_plot_emit_dragging (GtkWidget *plot)
+{
+    TernaryPlotPrivate *priv;
+    gint64 now, interval;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->drag_timeout_id)
+        return; /* trailing emission already scheduled */
+
+    now = g_get_monotonic_time ();
+    interval = priv->drag_rate > 0 ? G_USEC_PER_SEC / priv->drag_rate : 0;
+    if (now - priv->drag_emitted >= interval)
+    {
+        priv->drag_emitted = now;
+        g_signal_emit (plot, signals[POINT_DRAGGING], 0, priv->state.x, priv->state.y, priv->state.z);
+    }
+    else
+    {
+        /* deliver the latest value once the interval elapses */
+        priv->drag_timeout_id = g_timeout_add (
+            (interval - (now - priv->drag_emitted)) / 1000 + 1,
+            ternary_plot_drag_timeout, plot);
+    }
+}
+
+/* Selects the points between the corner the brush started at and the
+ * pointer, component by component. Runs once per coalesced motion. */
+static void update_brush (GtkWidget *plot)
+{
+    TernaryPlotPrivate *priv;
+    gdouble x, y, z, min[3], max[3];
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    ternary_render_to_ternary (&priv->state, priv->motion_x, priv->motion_y, &x, &y, &z);
+    min[0] = MIN (x, priv->brush_x);
+    max[0] = MAX (x, priv->brush_x);
+    min[1] = MIN (y, priv->brush_y);
+    max[1] = MAX (y, priv->brush_y);
+    min[2] = MIN (z, priv->brush_z);
+    max[2] = MAX (z, priv->brush_z);
+
+    ternary_selection_range (priv->state.selection, priv->state.xs,
+        priv->state.ys, priv->state.fixed, min, max);
+    selection_changed (plot);
+}
+
+/* records the pointer as a lasso vertex once it has moved far enough,
+ * and damages only the new segment */
+static void extend_lasso (GtkWidget *plot)
+{
+    TernaryPlotPrivate *priv;
+    GdkRectangle area;
+    gdouble x, y, z, px, py;
+    guint last;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    last = priv->lasso_x->len - 1;
+    ternary_render_to_pixel (&priv->state,
+        g_array_index (priv->lasso_x, gdouble, last),
+        g_array_index (priv->lasso_y, gdouble, last), &px, &py);
+    if (fabs (priv->motion_x - px) < LASSO_STEP &&
+        fabs (priv->motion_y - py) < LASSO_STEP)
+        return;
+
+    ternary_render_to_ternary (&priv->state, priv->motion_x, priv->motion_y, &x, &y, &z);
+    g_array_append_val (priv->lasso_x, x);
+    g_array_append_val (priv->lasso_y, y);
+
+    if (GTK_WIDGET_REALIZED (plot))
+    {
+        area.x = floor (MIN (px, priv->motion_x)) - 2;
+        area.y = floor (MIN (py, priv->motion_y)) - 2;
+        area.width = ceil (MAX (px, priv->motion_x)) + 2 - area.x;
+        area.height = ceil (MAX (py, priv->motion_y)) + 2 - area.y;
+        gdk_window_invalidate_rect (plot->window, &area, FALSE);
+    }
+}
+
+static void process_motion (GtkWidget *plot)
+{
+    gdouble x, y, z;
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->is_panned)
+    {
+        gdouble dx, dy, m[3];
+
+        /* the view moves against the pointer */
+        dx = priv->motion_x - priv->pan_x;
+        dy = priv->motion_y - priv->pan_y;
+        m[0] = priv->state.view_x - (priv->state.inverse.xx * dx + priv->state.inverse.xy * dy);
+        m[1] = priv->state.view_y - (priv->state.inverse.yx * dx + priv->state.inverse.yy * dy);
+        m[2] = 1.0 - priv->state.view_side - m[0] - m[1];
+        priv->pan_x = priv->motion_x;
+        priv->pan_y = priv->motion_y;
+        apply_view (plot, m, priv->state.view_side);
+        return;
+    }
+
+    if (priv->is_brushing)
+    {
+        update_brush (plot);
+        return;
+    }
+    if (priv->lasso_x)
+    {
+        extend_lasso (plot);
+        return;
+    }
+
+    if (!priv->is_dragged)
+    {
+        set_hovered (plot, find_point (plot, priv->motion_x, priv->motion_y));
+        return;
+    }
+
+    /* outside the feasible region the pointer follows its border */
+    ternary_render_to_ternary (&priv->state, priv->motion_x, priv->motion_y, &x, &y, &z);
+    ternary_constraints_project (priv->constraints, &x, &y, &z);
+    if (x != priv->state.x || y != priv->state.y || z != priv->state.z)
+    {
+        /* damage old and new pointer only */
+        queue_draw_pointer (plot);
+        priv->state.x = x;
+        priv->state.y = y;
+        priv->state.z = z;
+        queue_draw_pointer (plot);
+
+        ternary_plot_emit_dragging (plot);
+    }
+}
+
+static gboolean ternary_plot_process_motion (gpointer data)
+{
+    TernaryPlotPrivate *priv;
+    gint64 start;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (data);
+    priv->motion_idle_id = 0;
+
+    start = ternary_stats_start (priv->stats);
+    process_motion (GTK_WIDGET (data));
+    ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_MOTION, start);
+
+    return FALSE;
+}
+
+static gboolean ternary_plot_motion_notify (GtkWidget *plot, GdkEventMotion *event)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (event->is_hint)
+    {
+        gint x, y;
+
+        gdk_window_get_pointer (plot->window, &x, &y, NULL);
+        priv->motion_x = x;
+        priv->motion_y = y;
+    }
+    else
+    {
+        priv->motion_x = event->x;
+        priv->motion_y = event->y;
+    }
+
+    /* only the latest position is processed, once all pending events
+     * are handled and before the redraw of this frame */
+    if (priv->motion_idle_id == 0 &&
+        (priv->is_dragged || priv->is_panned || priv->is_brushing ||
+         priv->lasso_x || priv->state.n_points > 0))
+        priv->motion_idle_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE + 10,
+            ternary_plot_process_motion, plot, NULL);
+
+    gdk_event_request_motions (event);
+
+    return FALSE;
+}
+
+static gboolean ternary_plot_leave_notify (GtkWidget *plot, GdkEventCrossing *event)
+{
+    (void) event;
+
+    if (!TERNARY_PLOT_GET_PRIVATE (plot)->is_dragged)
+        set_hovered (plot, -1);
+
+    return FALSE;
+}
+
+static gboolean release_button (GtkWidget *widget, GdkEventButton *event)
+{
+    TernaryPlot *plot;
+    TernaryPlotPrivate *priv;
+    gdouble round_err;
+    gdouble new_x, new_y, new_z;
+    gdouble tol;
+
+    plot = TERNARY_PLOT (widget);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (event->button == 2 && priv->is_panned)
+    {
+        if (priv->motion_idle_id)
+        {
+            g_source_remove (priv->motion_idle_id);
+            ternary_plot_process_motion (plot);
+        }
+        priv->is_panned = FALSE;
+        return FALSE;
+    }
+
+    if (event->button == 1 && (priv->is_brushing || priv->lasso_x))
+    {
+        if (priv->motion_idle_id)
+        {
+            g_source_remove (priv->motion_idle_id);
+            ternary_plot_process_motion (plot);
+        }
+
+        /* the lasso closes back to its first vertex */
+        if (priv->lasso_x)
+        {
+            ternary_selection_lasso (priv->state.selection, priv->state.xs,
+                priv->state.ys, priv->state.fixed,
+                (const gdouble *) priv->lasso_x->data,
+                (const gdouble *) priv->lasso_y->data, priv->lasso_x->len);
+            g_array_free (priv->lasso_x, TRUE);
+            g_array_free (priv->lasso_y, TRUE);
+            priv->lasso_x = priv->lasso_y = NULL;
+            selection_changed (widget);
+        }
+        priv->is_brushing = FALSE;
+        return FALSE;
+    }
+
+    if (event->button != 1 || !priv->is_dragged)
+        return FALSE;
+
+    /* flush the coalesced motion so rounding starts from the last position */
+    if (priv->motion_idle_id)
+    {
+        g_source_remove (priv->motion_idle_id);
+        ternary_plot_process_motion (plot);
+    }
+    if (priv->drag_timeout_id)
+    {
+        g_source_remove (priv->drag_timeout_id);
+        priv->drag_timeout_id = 0;
+    }
+
+    tol = plot->tol;
+
+    new_x = roundf (priv->state.x / tol) * tol;
+    new_y = roundf (priv->state.y / tol) * tol;
+    new_z = roundf (priv->state.z / tol) * tol;
+
+    round_err = 1.0 - (new_x + new_y + new_z);
+    if (fabs (round_err) > tol / 2)
+    {
+        gdouble dx, dy, dz;
+        dx = (priv->state.x - new_x) / round_err;
+        dy = (priv->state.y - new_y) / round_err;
+        dz = (priv->state.z - new_z) / round_err;
+
+        if (dx > dy && dx > dz)
+            new_x += round_err;
+        else if (dy > dz)
+            new_y += round_err;
+        else
+            new_z += round_err;
+
+    }
+
+    /* rounding may step over the border of the feasible region */
+    ternary_constraints_project (priv->constraints, &new_x, &new_y, &new_z);
+
+    queue_draw_pointer (widget);
+    priv->state.x = new_x;
+    priv->state.y = new_y;
+    priv->state.z = new_z;
+    queue_draw_pointer (widget);
+
+    priv->is_dragged = FALSE;
+
+    g_signal_emit (plot, signals[POINT_CHANGED], 0, priv->state.x, priv->state.y, priv->state.z);
+
+    return FALSE;
+}
+
+static gboolean ternary_plot_button_release (GtkWidget *widget, GdkEventButton *event)
+{
+    TernaryPlotPrivate *priv;
+    gint64 start;
+    gboolean handled;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (widget);
+
+    start = ternary_stats_start (priv->stats);
+    handled = release_button (widget, event);
+    ternary_stats_record (priv->stats, TERNARY_PLOT_PHASE_RELEASE, start);
+
+    return handled;
+}
+
+GtkWidget * ternary_plot_new (void)
+{
+    return g_object_new (TERNARY_TYPE_PLOT, NULL);
+}
+
+void ternary_plot_set_xlabel (TernaryPlot *plot, const gchar *xlabel)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->state.xlabel != NULL)
+        g_free (priv->state.xlabel);
+    priv->state.xlabel = g_strdup (xlabel);
+    ternary_glyphs_set_label (priv->state.glyphs, 0, xlabel);
+}
+
+void ternary_plot_set_ylabel (TernaryPlot *plot, const gchar *ylabel)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->state.ylabel != NULL)
+        g_free (priv->state.ylabel);
+    priv->state.ylabel = g_strdup (ylabel);
+    ternary_glyphs_set_label (priv->state.glyphs, 1, ylabel);
+}
+
+void ternary_plot_set_zlabel (TernaryPlot *plot, const gchar *zlabel)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->state.zlabel != NULL)
+        g_free (priv->state.zlabel);
+    priv->state.zlabel = g_strdup (zlabel);
+    ternary_glyphs_set_label (priv->state.glyphs, 2, zlabel);
+}
+
+void ternary_plot_set_point (TernaryPlot *plot, gdouble x, gdouble y, gdouble z)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    queue_draw_pointer (GTK_WIDGET (plot));
+    priv->state.x = fabs (x) / (fabs (x) + fabs (y) + fabs (z));
+    priv->state.y = fabs (y) / (fabs (x) + fabs (y) + fabs (z));
+    priv->state.z = fabs (z) / (fabs (x) + fabs (y) + fabs (z));
+    ternary_constraints_project (priv->constraints, &priv->state.x,
+        &priv->state.y, &priv->state.z);
+    queue_draw_pointer (GTK_WIDGET (plot));
+
+    g_signal_emit (plot, signals[POINT_CHANGED], 0, priv->state.x, priv->state.y, priv->state.z);
+}
+
+/* moves the pointer into a changed feasible region */
+static void constrain_point (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+    gdouble x, y, z;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    x = priv->state.x;
+    y = priv->state.y;
+    z = priv->state.z;
+    if (!ternary_constraints_project (priv->constraints, &x, &y, &z))
+        return;
+
+    queue_draw_pointer (GTK_WIDGET (plot));
+    priv->state.x = x;
+    priv->state.y = y;
+    priv->state.z = z;
+    queue_draw_pointer (GTK_WIDGET (plot));
+
+    g_signal_emit (plot, signals[POINT_CHANGED], 0, priv->state.x, priv->state.y, priv->state.z);
+}
+
+/* Limits each component of the point to [min, max], as fractions.
+ * Bounds leaving nothing feasible are refused and FALSE is returned. */
+gboolean ternary_plot_set_bounds (TernaryPlot *plot, gdouble xmin,
+    gdouble xmax, gdouble ymin, gdouble ymax, gdouble zmin, gdouble zmax)
+{
+    gdouble min[3] = { xmin, ymin, zmin }, max[3] = { xmax, ymax, zmax };
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+
+    if (!ternary_constraints_set_bounds (
+            TERNARY_PLOT_GET_PRIVATE (plot)->constraints, min, max))
+        return FALSE;
+
+    constrain_point (plot);
+    return TRUE;
+}
+
+/* Keeps the point to a x + b y + c z <= d from now on. An inequality
+ * leaving nothing feasible is refused and FALSE is returned. */
+gboolean ternary_plot_add_constraint (TernaryPlot *plot, gdouble a,
+    gdouble b, gdouble c, gdouble d)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+
+    if (!ternary_constraints_add (TERNARY_PLOT_GET_PRIVATE (plot)->constraints,
+                                  a, b, c, d))
+        return FALSE;
+
+    constrain_point (plot);
+    return TRUE;
+}
+
+/* drops the bounds and inequalities, the whole simplex is feasible */
+void ternary_plot_clear_constraints (TernaryPlot *plot)
+{
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    ternary_constraints_clear (TERNARY_PLOT_GET_PRIVATE (plot)->constraints);
+}
+
+/* restarts the isolines for the points appended meanwhile */
+static gboolean ternary_plot_contours_timeout (gpointer data)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (data);
+
+    priv->contours_timeout_id = 0;
+    update_contours (priv);
+
+    return FALSE;
+}
+
+static void points_appended (GtkWidget *plot, gsize start)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    /* the new points join the index as they are, until it is too
+     * coarse for them and is built again on the next query */
+    if (priv->index && !ternary_index_insert (priv->index, priv->state.xs,
+            priv->state.ys, start, priv->state.n_points))
+    {
+        ternary_index_free (priv->index);
+        priv->index = NULL;
+    }
+
+    /* the pyramid keeps drawing the points it was built from and the
+     * new ones are drawn one by one after it, until there are enough of
+     * them to build it again with the next layer */
+    if (priv->state.pyramid && priv->state.n_points -
+        priv->state.pyramid->n_points > priv->state.n_points / PYRAMID_STALE)
+    {
+        invalidate_points (priv);
+        release_pyramid (priv);
+    }
+
+    /* a stream would restart the isolines every frame, so they catch up
+     * at most a few times a second */
+    if (priv->contours_enabled && priv->contours_timeout_id == 0)
+        priv->contours_timeout_id = g_timeout_add (CONTOURS_INTERVAL,
+            ternary_plot_contours_timeout, plot);
+
+    if (priv->state.density)
+    {
+        /* no worker may draw from the histogram while it changes */
+        invalidate_points (priv);
+        ternary_density_add (priv->state.density, priv->state.xs + start,
+            priv->state.ys + start, priv->state.zs + start, priv->state.n_points - start);
+        gtk_widget_queue_draw (plot);
+    }
+    else if (priv->state.view_side < 1.0)
+    {
+        /* the full view layer is redrawn when the view returns to it */
+        invalidate_points (priv);
+        gtk_widget_queue_draw (plot);
+    }
+    else
+    {
+        GdkRectangle damage;
+
+        /* only the new markers are drawn onto the existing layer, unless
+         * it is still being redrawn */
+        if (!ternary_raster_append (priv->raster, &priv->state, &damage))
+            gtk_widget_queue_draw (plot);
+        else if (damage.width > 0 && GTK_WIDGET_REALIZED (plot))
+            gdk_window_invalidate_rect (plot->window, &damage, FALSE);
+    }
+
+    /* new points start unselected */
+    ternary_selection_resize (priv->state.selection, priv->state.n_points);
+
+    /* the summary takes in the new rows only; it moves, so both where it
+     * was and where it goes are redrawn */
+    if (priv->summary_enabled)
+    {
+        queue_draw_summary (plot);
+        sync_summary (priv);
+        queue_draw_summary (plot);
+    }
+}
+
+static gboolean ternary_plot_drain_stream (gpointer data);
+
+/* one drain per frame however many producers push; any thread */
+static void schedule_drain (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (g_atomic_int_compare_and_exchange (&priv->stream_scheduled, 0, 1))
+        g_timeout_add_full (G_PRIORITY_DEFAULT, STREAM_INTERVAL,
+            ternary_plot_drain_stream, g_object_ref (plot), g_object_unref);
+}
+
+static gboolean ternary_plot_drain_stream (gpointer data)
+{
+    TernaryPlotPrivate *priv;
+    TernaryDataset *dataset;
+    gdouble x, y, z;
+    gsize start;
+    guint budget;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (data);
+    dataset = priv->dataset;
+
+    /* producers pushing from now on schedule another drain */
+    g_atomic_int_set (&priv->stream_scheduled, 0);
+
+    /* take at most one queue length, so busy producers cannot starve
+     * the main loop */
+    start = priv->state.n_points;
+    budget = ternary_ring_get_capacity (priv->stream);
+    while (budget > 0 && ternary_ring_pop (priv->stream, &x, &y, &z))
+    {
+        budget--;
+        if (priv->state.n_points == priv->points_capacity)
+            grow_points (priv);
+        priv->state.xs[priv->state.n_points] = x;
+        priv->state.ys[priv->state.n_points] = y;
+        priv->state.zs[priv->state.n_points] = z;
+        priv->state.n_points++;
+    }
+
+    if (priv->state.n_points > start)
+        points_appended (GTK_WIDGET (data), start);
+    if (dataset && priv->dataset == NULL)
+        g_object_notify (G_OBJECT (data), "dataset");
+
+    /* what is left waits for the next frame, even if no producer
+     * pushes again */
+    if (budget == 0)
+        schedule_drain (data);
+
+    return FALSE;
+}
+
+void ternary_plot_append_points (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n)
+{
+    TernaryPlotPrivate *priv;
+    gdouble cx[STREAM_CHUNK], cy[STREAM_CHUNK], cz[STREAM_CHUNK];
+    gsize i, j, m;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    /* the queue cannot be swapped while it is pushed to */
+    g_rw_lock_reader_lock (&priv->stream_lock);
+
+    for (i = 0; i < n; i += m)
+    {
+        m = MIN (n - i, STREAM_CHUNK);
+        ternary_kernels_closure (x + i, y + i, z + i, cx, cy, cz, m);
+
+        for (j = 0; j < m; j++)
+            while (!ternary_ring_push (priv->stream, cx[j], cy[j], cz[j]))
+            {
+                gdouble dx, dy, dz;
+
+                if (g_atomic_int_get (&priv->overflow_policy) ==
+                    TERNARY_PLOT_OVERFLOW_DROP_OLDEST)
+                {
+                    if (ternary_ring_pop (priv->stream, &dx, &dy, &dz))
+                        g_atomic_int_inc (&priv->n_dropped);
+                }
+                else if (g_main_context_is_owner (g_main_context_default ()))
+                    ternary_plot_drain_stream (plot); /* nobody else will */
+                else
+                {
+                    /* room is only made by a pending drain, and the
+                     * queue may be swapped while waiting for it */
+                    schedule_drain (plot);
+                    g_rw_lock_reader_unlock (&priv->stream_lock);
+                    g_usleep (STREAM_INTERVAL * 1000 / 4);
+                    g_rw_lock_reader_lock (&priv->stream_lock);
+                }
+            }
+    }
+
+    g_rw_lock_reader_unlock (&priv->stream_lock);
+
+    if (n > 0)
+        schedule_drain (plot);
+}
+
+/* Sets how many points may wait for the next drain. The queue holds a
+ * power of two of them, so capacity is rounded up to one, and clamped
+ * to [2, 2^22]. */
+void ternary_plot_set_stream_capacity (TernaryPlot *plot, guint capacity)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    /* compared as the queue would round it */
+    capacity = CLAMP (capacity, 2, STREAM_CAPACITY_MAX);
+    capacity = 1u << g_bit_storage (capacity - 1);
+    if (capacity == ternary_ring_get_capacity (priv->stream))
+        return;
+
+    /* keep what is queued, then swap the queue once no producer is
+     * pushing; a full queue is drained whole by one call */
+    g_rw_lock_writer_lock (&priv->stream_lock);
+    ternary_plot_drain_stream (plot);
+    ternary_ring_free (priv->stream);
+    priv->stream = ternary_ring_new (capacity);
+    g_rw_lock_writer_unlock (&priv->stream_lock);
+}
+
+void ternary_plot_set_overflow_policy (TernaryPlot *plot,
+    TernaryPlotOverflowPolicy policy)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    g_atomic_int_set (&priv->overflow_policy, policy);
+}
+
+/* everything derived from the columns is stale */
+static void points_replaced (GtkWidget *plot)
+{
+    TernaryPlotPrivate *priv;
+    gsize selected;
+
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    ternary_index_free (priv->index);
+    priv->index = NULL;
+    set_hovered (plot, -1);
+
+    /* rebuilt on the next draw unless one is loaded first */
+    release_pyramid (priv);
+
+    update_density (priv);
+    update_contours (priv);
+    invalidate_points (priv);
+    ternary_composition_reset (priv->composition);
+    gtk_widget_queue_draw (plot);
+
+    /* rows of the old points say nothing about the new ones */
+    selected = priv->state.selection->n_selected;
+    ternary_selection_resize (priv->state.selection, 0);
+    ternary_selection_resize (priv->state.selection, priv->state.n_points);
+    if (selected > 0)
+        selection_changed (plot);
+}
+
+void ternary_plot_set_points (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n)
+{
+    TernaryPlotPrivate *priv;
+    gboolean detached;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    detached = priv->dataset != NULL;
+
+    ternary_tiles_invalidate (priv->tiles);
+    ternary_raster_invalidate (priv->raster);
+    ternary_contours_cancel (priv->contours);
+
+    if (priv->points_destroy || n != priv->state.n_points)
+    {
+        release_points (priv);
+        priv->state.xs = g_new (gdouble, n);
+        priv->state.ys = g_new (gdouble, n);
+        priv->state.zs = g_new (gdouble, n);
+        priv->state.n_points = n;
+        priv->points_capacity = n;
+    }
+
+    /* same closure as ternary_plot_set_point, in one pass */
+    ternary_kernels_closure (x, y, z, priv->state.xs, priv->state.ys, priv->state.zs, n);
+
+    points_replaced (GTK_WIDGET (plot));
+    if (detached)
+        g_object_notify (G_OBJECT (plot), "dataset");
+}
+
+/* Shows n points straight from the caller's columns, which must already
+ * be closed to x + y + z = 1 and stay untouched until destroy is called
+ * with data. Nothing is copied unless points are appended later. */
+void ternary_plot_set_points_full (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, GDestroyNotify destroy,
+    gpointer data)
+{
+    TernaryPlotPrivate *priv;
+    gboolean detached;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    detached = priv->dataset != NULL;
+
+    ternary_tiles_invalidate (priv->tiles);
+    ternary_raster_invalidate (priv->raster);
+    ternary_contours_cancel (priv->contours);
+
+    release_points (priv);
+    priv->state.xs = (gdouble *) x;
+    priv->state.ys = (gdouble *) y;
+    priv->state.zs = (gdouble *) z;
+    priv->state.n_points = n;
+    priv->points_capacity = n;
+    priv->points_destroy = destroy;
+    priv->points_data = data;
+
+    points_replaced (GTK_WIDGET (plot));
+    if (detached)
+        g_object_notify (G_OBJECT (plot), "dataset");
+}
+
+/* Shows the points of dataset, which any number of plots may share along
+ * with its index, histograms and pyramid. Appending points afterwards
+ * gives the plot its own copy. NULL clears the points. */
+void ternary_plot_set_dataset (TernaryPlot *plot, TernaryDataset *dataset)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (dataset == NULL || TERNARY_IS_DATASET (dataset));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (dataset == priv->dataset)
+        return;
+
+    ternary_tiles_invalidate (priv->tiles);
+    ternary_raster_invalidate (priv->raster);
+    ternary_contours_cancel (priv->contours);
+
+    release_points (priv);
+    if (dataset)
+    {
+        const gdouble *x, *y, *z;
+
+        ternary_dataset_get_columns (dataset, &x, &y, &z);
+        priv->state.xs = (gdouble *) x;
+        priv->state.ys = (gdouble *) y;
+        priv->state.zs = (gdouble *) z;
+        priv->state.fixed = (TernaryFixed *) ternary_dataset_get_fixed (dataset);
+        priv->state.n_points = ternary_dataset_get_n_points (dataset);
+        priv->points_capacity = priv->state.n_points;
+        priv->points_destroy = g_object_unref;
+        priv->points_data = g_object_ref (dataset);
+        priv->dataset = dataset;
+    }
+
+    points_replaced (GTK_WIDGET (plot));
+    g_object_notify (G_OBJECT (plot), "dataset");
+}
+
+/* the data set shown, NULL if the points are the plot's own */
+TernaryDataset *ternary_plot_get_dataset (TernaryPlot *plot)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), NULL);
+    return TERNARY_PLOT_GET_PRIVATE (plot)->dataset;
+}
+
+/* Colours the first n points by a copy of values through the colormap,
+ * resetting the value range to the smallest and largest of them. NULL
+ * goes back to a single colour. */
+void ternary_plot_set_values (TernaryPlot *plot, const gdouble *values,
+    gsize n)
+{
+    TernaryPlotPrivate *priv;
+    gdouble min = G_MAXDOUBLE, max = -G_MAXDOUBLE;
+    gsize i;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (n == 0 || values != NULL);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    /* no worker may draw from the old column */
+    invalidate_points (priv);
+
+    g_free (priv->state.values);
+    priv->state.values = n > 0 ? g_memdup (values, n * sizeof (gdouble)) : NULL;
+    priv->state.n_values = n;
+
+    for (i = 0; i < n; i++)
+        if (isfinite (values[i]))
+        {
+            min = MIN (min, values[i]);
+            max = MAX (max, values[i]);
+        }
+    if (min <= max)
+    {
+        priv->state.value_min = min;
+        priv->state.value_max = max;
+    }
+
+    gtk_widget_queue_draw (GTK_WIDGET (plot));
+}
+
+/* Draws the first n points as squares of a copy of sizes, in pixels up
+ * to 32. NULL goes back to a single size. */
+void ternary_plot_set_sizes (TernaryPlot *plot, const gdouble *sizes,
+    gsize n)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (n == 0 || sizes != NULL);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    invalidate_points (priv);
+
+    g_free (priv->state.sizes);
+    priv->state.sizes = n > 0 ? g_memdup (sizes, n * sizeof (gdouble)) : NULL;
+    priv->state.n_sizes = n;
+
+    gtk_widget_queue_draw (GTK_WIDGET (plot));
+}
+
+void ternary_plot_set_colormap (TernaryPlot *plot, TernaryColormap colormap)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (colormap < TERNARY_COLORMAP_N);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->colormap != colormap) {
+        invalidate_points (priv);
+        priv->colormap = colormap;
+        priv->state.colormap = ternary_colormap_get_lut (colormap);
+        gtk_widget_queue_draw (GTK_WIDGET (plot));
+    }
+}
+
+/* Adds n samples to the end of the trajectory. Only the area of the new
+ * segments is redrawn. */
+void ternary_plot_append_trajectory (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n)
+{
+    TernaryPlotPrivate *priv;
+    GdkRectangle area;
+    gdouble x1, y1, x2, y2;
+    gsize start;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (n == 0 || (x != NULL && y != NULL && z != NULL));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    start = ternary_trajectory_get_length (priv->state.trajectory);
+    ternary_trajectory_append (priv->state.trajectory, x, y, z, n);
+
+    if (!GTK_WIDGET_REALIZED (GTK_WIDGET (plot)) ||
+        !ternary_trajectory_extents (priv->state.trajectory,
+            &priv->state.forward, start > 0 ? start - 1 : 0, start + n,
+            &x1, &y1, &x2, &y2))
+        return;
+
+    area.x = floor (x1);
+    area.y = floor (y1);
+    area.width = ceil (x2) - area.x;
+    area.height = ceil (y2) - area.y;
+    gdk_window_invalidate_rect (GTK_WIDGET (plot)->window, &area, FALSE);
+}
+
+void ternary_plot_clear_trajectory (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    ternary_trajectory_clear (priv->state.trajectory);
+    invalidate_trajectory (priv);
+    gtk_widget_queue_draw (GTK_WIDGET (plot));
+}
+
+/* Colour and line width in pixels of the trajectory. */
+void ternary_plot_set_trajectory_style (TernaryPlot *plot, gdouble red,
+    gdouble green, gdouble blue, gdouble width)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (width > 0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    ternary_trajectory_set_style (priv->state.trajectory, red, green, blue,
+                                  width);
+    invalidate_trajectory (priv);
+    gtk_widget_queue_draw (GTK_WIDGET (plot));
+}
+
+/* Selects the points inside the polygon through (x[i], y[i]), z being
+ * implied, and only those. The polygon closes by itself. */
+void ternary_plot_select_lasso (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, guint n)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (n == 0 || (x != NULL && y != NULL));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    ternary_selection_lasso (priv->state.selection, priv->state.xs,
+        priv->state.ys, priv->state.fixed, x, y, n);
+    selection_changed (GTK_WIDGET (plot));
+}
+
+/* Selects the points with xmin <= x <= xmax, ymin <= y <= ymax and
+ * zmin <= z <= zmax, and only those. */
+void ternary_plot_select_range (TernaryPlot *plot, gdouble xmin,
+    gdouble xmax, gdouble ymin, gdouble ymax, gdouble zmin, gdouble zmax)
+{
+    TernaryPlotPrivate *priv;
+    gdouble min[3], max[3];
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    min[0] = xmin;
+    max[0] = xmax;
+    min[1] = ymin;
+    max[1] = ymax;
+    min[2] = zmin;
+    max[2] = zmax;
+    ternary_selection_range (priv->state.selection, priv->state.xs,
+        priv->state.ys, priv->state.fixed, min, max);
+    selection_changed (GTK_WIDGET (plot));
+}
+
+void ternary_plot_clear_selection (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->state.selection->n_selected == 0)
+        return;
+
+    ternary_selection_clear (priv->state.selection);
+    selection_changed (GTK_WIDGET (plot));
+}
+
+/* Values at or below min get the first colour of the colormap, those at
+ * or above max the last. */
+void ternary_plot_set_value_range (TernaryPlot *plot, gdouble min,
+    gdouble max)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (min <= max);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->state.value_min != min || priv->state.value_max != max) {
+        invalidate_points (priv);
+        priv->state.value_min = min;
+        priv->state.value_max = max;
+        gtk_widget_queue_draw (GTK_WIDGET (plot));
+    }
+}
+
+/* Loads a data set written by ternary_data_file_write or
+ * ternary_plot_save_data. Its columns are used where they are mapped,
+ * and its labels and precomputed pyramid replace the current ones. */
+gboolean ternary_plot_load_data (TernaryPlot *plot, const gchar *filename,
+    GError **error)
+{
+    TernaryPlotPrivate *priv;
+    TernaryDataFile *data;
+    TernaryPyramid *pyramid;
+    GError *local_error = NULL;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    data = ternary_data_file_open (filename, error);
+    if (data == NULL)
+        return FALSE;
+
+    pyramid = ternary_data_file_new_pyramid (data, &local_error);
+    if (local_error != NULL)
+    {
+        g_propagate_prefixed_error (error, local_error, "'%s': ", filename);
+        ternary_data_file_unref (data);
+        return FALSE;
+    }
+
+    if (data->closed)
+        ternary_plot_set_points_full (plot, data->x, data->y, data->z,
+            data->n_points, (GDestroyNotify) ternary_data_file_unref,
+            ternary_data_file_ref (data));
+    else
+        ternary_plot_set_points (plot, data->x, data->y, data->z,
+            data->n_points);
+
+    if (pyramid != NULL)
+    {
+        invalidate_points (priv);
+        release_pyramid (priv);
+        priv->state.pyramid = pyramid;
+    }
+
+    if (data->labels[0])
+        ternary_plot_set_xlabel (plot, data->labels[0]);
+    if (data->labels[1])
+        ternary_plot_set_ylabel (plot, data->labels[1]);
+    if (data->labels[2])
+        ternary_plot_set_zlabel (plot, data->labels[2]);
+
+    ternary_data_file_unref (data);
+
+    return TRUE;
+}
+
+/* Reads comma or tab separated compositions, closing them as
+ * ternary_plot_set_point does. Rows that are not three numbers or do
+ * not close, zero sums and NaNs, are skipped and counted in n_skipped.
+ * Header names replace the labels. */
+gboolean ternary_plot_load_csv (TernaryPlot *plot, const gchar *filename,
+    gsize *n_skipped, GError **error)
+{
+    TernaryCsv *csv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+
+    csv = ternary_csv_load (filename, error);
+    if (csv == NULL)
+        return FALSE;
+
+    if (n_skipped)
+        *n_skipped = csv->n_malformed + csv->n_degenerate;
+
+    if (csv->n_points == 0 && csv->n_malformed > 0)
+    {
+        g_set_error (error, TERNARY_PLOT_ERROR, TERNARY_PLOT_ERROR_INVALID,
+                     "'%s' has no rows of three numbers", filename);
+        ternary_csv_free (csv);
+        return FALSE;
+    }
+
+    /* the columns were parsed in place and become the plot's */
+    ternary_plot_set_points_full (plot, csv->x, csv->y, csv->z,
+        csv->n_points, g_free, csv->x);
+    csv->x = NULL;
+
+    if (csv->labels[0])
+        ternary_plot_set_xlabel (plot, csv->labels[0]);
+    if (csv->labels[1])
+        ternary_plot_set_ylabel (plot, csv->labels[1]);
+    if (csv->labels[2])
+        ternary_plot_set_zlabel (plot, csv->labels[2]);
+
+    ternary_csv_free (csv);
+
+    return TRUE;
+}
+
+/* Writes the points, the labels and the pyramid, if one was built, so
+ * ternary_plot_load_data can show them again without any work. */
+gboolean ternary_plot_save_data (TernaryPlot *plot, const gchar *filename,
+    GError **error)
+{
+    TernaryPlotPrivate *priv;
+    TernaryPyramid *pyramid;
+    const gchar *labels[3];
+    gdouble *columns;
+    gsize n;
+    gboolean written;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    labels[0] = priv->state.xlabel;
+    labels[1] = priv->state.ylabel;
+    labels[2] = priv->state.zlabel;
+
+    /* a pyramid loaded for other points is left out */
+    pyramid = priv->state.pyramid;
+    if (pyramid && pyramid->n_points != priv->state.n_points)
+        pyramid = NULL;
+
+    if (priv->state.fixed == NULL)
+        return ternary_data_file_write (filename, priv->state.xs,
+            priv->state.ys, priv->state.zs, priv->state.n_points, labels,
+            NULL, pyramid, error);
+
+    /* the file format holds doubles */
+    n = priv->state.n_points;
+    columns = g_new (gdouble, 3 * n);
+    ternary_fixed_decode (priv->state.fixed, 0, n, columns, columns + n,
+                          columns + 2 * n);
+    written = ternary_data_file_write (filename, columns, columns + n,
+        columns + 2 * n, n, labels, NULL, pyramid, error);
+    g_free (columns);
+
+    return written;
+}
+
+gboolean ternary_plot_save_pyramid (TernaryPlot *plot, const gchar *filename,
+    GError **error)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    /* also for data sets below the automatic threshold */
+    if (priv->state.pyramid == NULL && priv->dataset)
+    {
+        priv->state.pyramid = ternary_dataset_get_pyramid (priv->dataset);
+        priv->pyramid_shared = TRUE;
+    }
+    else if (priv->state.pyramid == NULL)
+        priv->state.pyramid = ternary_pyramid_new (priv->state.xs,
+            priv->state.ys, priv->state.zs, priv->state.n_points,
+            ternary_pyramid_depth_for (priv->state.n_points));
+
+    return ternary_pyramid_save (priv->state.pyramid, filename, error);
+}
+
+gboolean ternary_plot_load_pyramid (TernaryPlot *plot, const gchar *filename,
+    GError **error)
+{
+    TernaryPlotPrivate *priv;
+    TernaryPyramid *pyramid;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    pyramid = ternary_pyramid_load (filename, error);
+    if (pyramid == NULL)
+        return FALSE;
+
+    if (pyramid->n_points != priv->state.n_points)
+    {
+        g_set_error (error, TERNARY_PLOT_ERROR, TERNARY_PLOT_ERROR_INVALID,
+                     "Pyramid '%s' was built for %" G_GUINT64_FORMAT
+                     " points, not %" G_GSIZE_FORMAT, filename,
+                     pyramid->n_points, priv->state.n_points);
+        ternary_pyramid_free (pyramid);
+        return FALSE;
+    }
+
+    invalidate_points (priv);
+    release_pyramid (priv);
+    priv->state.pyramid = pyramid;
+    gtk_widget_queue_draw (GTK_WIDGET (plot));
+
+    return TRUE;
+}
+
+void ternary_plot_set_view (TernaryPlot *plot, gdouble x, gdouble y, gdouble z)
+{
+    gdouble m[3];
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (x >= 0 && y >= 0 && z >= 0 && x + y + z < 1.0);
+
+    m[0] = x;
+    m[1] = y;
+    m[2] = z;
+    apply_view (GTK_WIDGET (plot), m, 1.0 - x - y - z);
+}
+
+void ternary_plot_set_tolerance (TernaryPlot *plot, gdouble tol)
+{
+    gdouble tolerance;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+
+    tolerance = CLAMP(tol, 0.1, 100.0) / 100.0;
+    if (plot->tol != tolerance) {
+        plot->tol = tolerance;
+        g_object_notify (G_OBJECT (plot), "tolerance");
+    }
+}
+
+void ternary_plot_set_grid_step (TernaryPlot *plot, gdouble step)
+{
+    TernaryPlotPrivate *priv;
+    gdouble grid_step;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    grid_step = CLAMP(step, 1.0, 50.0) / 100.0;
+    if (priv->state.grid_step != grid_step) {
+        priv->state.grid_step = grid_step;
+        invalidate_field (priv);
+        gtk_widget_queue_draw (GTK_WIDGET (plot));
+        g_object_notify (G_OBJECT (plot), "grid-step");
+    }
+}
+
+void ternary_plot_set_drag_rate (TernaryPlot *plot, gdouble rate)
+{
+    TernaryPlotPrivate *priv;
+    gdouble drag_rate;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    drag_rate = CLAMP(rate, 0.0, 1000.0);
+    if (priv->drag_rate != drag_rate) {
+        priv->drag_rate = drag_rate;
+        g_object_notify (G_OBJECT (plot), "drag-rate");
+    }
+}
+
+void ternary_plot_set_density (TernaryPlot *plot, gboolean density)
+{
+    TernaryPlotPrivate *priv;
 
     g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
 
-    tolerance = CLAMP(tol, 0.1, 100.0) / 100.0;
-    if (plot->tol != tolerance) {
-        plot->tol = tolerance;
-        g_object_notify (G_OBJECT (plot), "tolerance");
+    density = density != FALSE;
+    if (priv->density_enabled != density) {
+        priv->density_enabled = density;
+        update_density (priv);
+        invalidate_points (priv);
+        gtk_widget_queue_draw (GTK_WIDGET (plot));
+        g_object_notify (G_OBJECT (plot), "density");
+    }
+}
+
+void ternary_plot_set_density_resolution (TernaryPlot *plot, guint resolution)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    resolution = CLAMP(resolution, 2, 1024);
+    if (priv->density_resolution != resolution) {
+        priv->density_resolution = resolution;
+        update_density (priv);
+        invalidate_points (priv);
+        gtk_widget_queue_draw (GTK_WIDGET (plot));
+        g_object_notify (G_OBJECT (plot), "density-resolution");
+    }
+}
+
+void ternary_plot_set_contours (TernaryPlot *plot, gboolean contours)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    contours = contours != FALSE;
+    if (priv->contours_enabled != contours) {
+        priv->contours_enabled = contours;
+        update_contours (priv);
+        gtk_widget_queue_draw (GTK_WIDGET (plot));
+        g_object_notify (G_OBJECT (plot), "contours");
+    }
+}
+
+void ternary_plot_set_bandwidth (TernaryPlot *plot, gdouble bandwidth)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    bandwidth = CLAMP(bandwidth, 0.5, 50.0) / 100.0;
+    if (priv->bandwidth != bandwidth) {
+        priv->bandwidth = bandwidth;
+        update_contours (priv);
+        g_object_notify (G_OBJECT (plot), "bandwidth");
+    }
+}
+
+void ternary_plot_set_summary (TernaryPlot *plot, gboolean summary)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    summary = summary != FALSE;
+    if (priv->summary_enabled != summary) {
+        priv->summary_enabled = summary;
+        priv->state.composition = summary ? priv->composition : NULL;
+        gtk_widget_queue_draw (GTK_WIDGET (plot));
+        g_object_notify (G_OBJECT (plot), "summary");
+    }
+}
+
+void ternary_plot_set_summary_level (TernaryPlot *plot, gdouble level)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    level = CLAMP(level, 50.0, 99.9) / 100.0;
+    if (priv->state.ellipse_level != level) {
+        if (priv->summary_enabled)
+            queue_draw_summary (GTK_WIDGET (plot));
+        priv->state.ellipse_level = level;
+        if (priv->summary_enabled)
+            queue_draw_summary (GTK_WIDGET (plot));
+        g_object_notify (G_OBJECT (plot), "summary-level");
     }
 }
 
@@ -532,7 +2680,7 @@ const gchar* ternary_plot_get_xlabel (TernaryPlot *plot)
 
     g_return_val_if_fail (TERNARY_IS_PLOT (plot), NULL);
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
-    return priv->xlabel;
+    return priv->state.xlabel;
 }
 
 const gchar* ternary_plot_get_ylabel (TernaryPlot *plot)
@@ -541,7 +2689,7 @@ const gchar* ternary_plot_get_ylabel (TernaryPlot *plot)
 
     g_return_val_if_fail (TERNARY_IS_PLOT (plot), NULL);
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
-    return priv->ylabel;
+    return priv->state.ylabel;
 }
 
 const gchar* ternary_plot_get_zlabel (TernaryPlot *plot)
@@ -550,7 +2698,7 @@ const gchar* ternary_plot_get_zlabel (TernaryPlot *plot)
 
     g_return_val_if_fail (TERNARY_IS_PLOT (plot), NULL);
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
-    return priv->zlabel;
+    return priv->state.zlabel;
 }
 
 void ternary_plot_get_point (TernaryPlot *plot, gdouble *x, gdouble *y, gdouble *z)
@@ -560,28 +2708,380 @@ void ternary_plot_get_point (TernaryPlot *plot, gdouble *x, gdouble *y, gdouble
     g_return_if_fail (TERNARY_IS_PLOT (plot));
     priv = TERNARY_PLOT_GET_PRIVATE (plot);
     if (x)
-        *x = priv->x;
+        *x = priv->state.x;
     if (y)
-        *y = priv->y;
+        *y = priv->state.y;
     if (z)
-        *z = priv->z;
+        *z = priv->state.z;
 }
 
-gdouble ternary_plot_get_tolerance (TernaryPlot *plot)
+void ternary_plot_get_view (TernaryPlot *plot, gdouble *x, gdouble *y, gdouble *z)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (x)
+        *x = priv->state.view_x;
+    if (y)
+        *y = priv->state.view_y;
+    if (z)
+        *z = priv->state.view_z;
+}
+
+gdouble ternary_plot_get_grid_step (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0.0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return priv->state.grid_step * 100.0;
+}
+
+gdouble ternary_plot_get_drag_rate (TernaryPlot *plot)
 {
+    TernaryPlotPrivate *priv;
+
     g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0.0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return priv->drag_rate;
+}
 
-    return plot->tol * 100.0;
+gboolean ternary_plot_get_density (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return priv->density_enabled;
+}
+
+guint ternary_plot_get_density_resolution (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return priv->density_resolution;
+}
+
+gboolean ternary_plot_get_contours (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return priv->contours_enabled;
+}
+
+gdouble ternary_plot_get_bandwidth (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return priv->bandwidth * 100.0;
+}
+
+gboolean ternary_plot_get_summary (TernaryPlot *plot)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    return TERNARY_PLOT_GET_PRIVATE (plot)->summary_enabled;
+}
+
+gdouble ternary_plot_get_summary_level (TernaryPlot *plot)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0);
+    return TERNARY_PLOT_GET_PRIVATE (plot)->state.ellipse_level * 100.0;
+}
+
+/* Closed geometric mean of the points with no zero part, FALSE when
+ * there are none. */
+gboolean ternary_plot_get_centre (TernaryPlot *plot, gdouble *x,
+    gdouble *y, gdouble *z)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    sync_summary (priv);
+    return ternary_composition_get_centre (priv->composition, x, y, z);
+}
+
+/* Total variance of the same points, the trace of their clr
+ * covariance. */
+gdouble ternary_plot_get_total_variance (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0.0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    sync_summary (priv);
+    return ternary_composition_get_total_variance (priv->composition);
+}
+
+guint ternary_plot_get_stream_capacity (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return ternary_ring_get_capacity (priv->stream);
+}
+
+gsize ternary_plot_get_trajectory_length (TernaryPlot *plot)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0);
+    return ternary_trajectory_get_length (
+        TERNARY_PLOT_GET_PRIVATE (plot)->state.trajectory);
+}
+
+gsize ternary_plot_get_n_selected (TernaryPlot *plot)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0);
+    return TERNARY_PLOT_GET_PRIVATE (plot)->state.selection->n_selected;
+}
+
+/* Bit i % 32 of word i / 32 is set when point i is selected. The mask
+ * covers n_points points and is valid until the points or the
+ * selection change. */
+const guint32 *ternary_plot_get_selection (TernaryPlot *plot,
+    gsize *n_points)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), NULL);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (n_points)
+        *n_points = priv->state.selection->n_points;
+    return priv->state.selection->bits;
+}
+
+gboolean ternary_plot_is_selected (TernaryPlot *plot, gsize index)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    g_return_val_if_fail (index < priv->state.n_points, FALSE);
+
+    return ternary_selection_get (priv->state.selection, index);
+}
+
+TernaryColormap ternary_plot_get_colormap (TernaryPlot *plot)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), TERNARY_COLORMAP_VIRIDIS);
+    return TERNARY_PLOT_GET_PRIVATE (plot)->colormap;
+}
+
+void ternary_plot_get_value_range (TernaryPlot *plot, gdouble *min,
+    gdouble *max)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (min)
+        *min = priv->state.value_min;
+    if (max)
+        *max = priv->state.value_max;
+}
+
+TernaryPlotOverflowPolicy ternary_plot_get_overflow_policy (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), TERNARY_PLOT_OVERFLOW_DROP_OLDEST);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return g_atomic_int_get (&priv->overflow_policy);
+}
+
+gsize ternary_plot_get_n_dropped (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return (guint) g_atomic_int_get (&priv->n_dropped);
+}
+
+/* Times drawing and input handling per phase over a rolling window.
+ * Disabling drops the samples recorded so far. */
+void ternary_plot_set_stats_enabled (TernaryPlot *plot, gboolean enabled)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if ((priv->stats != NULL) == (enabled != FALSE))
+        return;
+
+    if (enabled)
+    {
+        priv->stats = ternary_stats_new ();
+        start_stats_dump (plot);
+    }
+    else
+    {
+        /* nothing left to dump */
+        if (priv->stats_dump_id)
+            g_source_remove (priv->stats_dump_id);
+        priv->stats_dump_id = 0;
+        ternary_stats_free (priv->stats);
+        priv->stats = NULL;
+    }
+    g_object_notify (G_OBJECT (plot), "stats-enabled");
+}
+
+gboolean ternary_plot_get_stats_enabled (TernaryPlot *plot)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    return TERNARY_PLOT_GET_PRIVATE (plot)->stats != NULL;
+}
+
+/* fills timing in for a phase, FALSE if it was not timed yet */
+gboolean ternary_plot_get_timing (TernaryPlot *plot, TernaryPlotPhase phase,
+    TernaryPlotTiming *timing)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    g_return_val_if_fail (phase < TERNARY_PLOT_N_PHASES, FALSE);
+    g_return_val_if_fail (timing != NULL, FALSE);
+
+    return ternary_stats_get (TERNARY_PLOT_GET_PRIVATE (plot)->stats, phase,
+                              timing);
+}
+
+/* Whether the data layer on screen is up to date, FALSE while a worker
+ * still draws its replacement and a stale one stands in. */
+gboolean ternary_plot_get_layer_ready (TernaryPlot *plot)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->state.n_points == 0)
+        return TRUE;
+    if (priv->state.view_side < 1.0)
+        return ternary_tiles_is_complete (priv->tiles);
+
+    return ternary_raster_is_current (priv->raster);
+}
+
+/* returns a newly allocated report, one line per timed phase */
+gchar *ternary_plot_get_stats (TernaryPlot *plot)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), NULL);
+    return ternary_stats_report (TERNARY_PLOT_GET_PRIVATE (plot)->stats);
+}
+
+void ternary_plot_pixels_to_ternary (TernaryPlot *plot,
+    const gdouble *px, const gdouble *py,
+    gdouble *x, gdouble *y, gdouble *z, gsize n)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (n == 0 || (px && py && x && y));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    ternary_kernels_affine (&priv->state.inverse, px, py, x, y, z, n);
+}
+
+void ternary_plot_ternary_to_pixels (TernaryPlot *plot,
+    const gdouble *x, const gdouble *y,
+    gdouble *px, gdouble *py, gsize n)
+{
+    TernaryPlotPrivate *priv;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (n == 0 || (x && y && px && py));
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    ternary_kernels_affine (&priv->state.forward, x, y, px, py, NULL, n);
+}
+
+void ternary_plot_render_to_surface (TernaryPlot *plot,
+    cairo_surface_t *surface, gint width, gint height)
+{
+    TernaryPlotPrivate *priv;
+    TernaryRenderState state;
+    cairo_t *cr;
+
+    g_return_if_fail (TERNARY_IS_PLOT (plot));
+    g_return_if_fail (surface != NULL);
+    g_return_if_fail (width > 0 && height > 0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    /* a copy, so the widget's own layout is left alone */
+    if (priv->summary_enabled)
+        sync_summary (priv);
+    state = priv->state;
+    ternary_render_set_geometry (&state, 0, 0, width, height);
+
+    cr = cairo_create (surface);
+    ternary_render (&state, cr, width, height);
+    cairo_destroy (cr);
+}
+
+static gboolean ternary_plot_save (TernaryPlot *plot,
+    TernaryRenderFormat format, const gchar *filename,
+    gint width, gint height, GError **error)
+{
+    TernaryPlotPrivate *priv;
+    TernaryRenderState state;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+    g_return_val_if_fail (width > 0 && height > 0, FALSE);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+
+    if (priv->summary_enabled)
+        sync_summary (priv);
+    state = priv->state;
+    return ternary_render_to_file (&state, format, filename,
+        width, height, error);
+}
+
+gboolean ternary_plot_save_to_png (TernaryPlot *plot, const gchar *filename,
+    gint width, gint height, GError **error)
+{
+    return ternary_plot_save (plot, TERNARY_RENDER_PNG, filename,
+        width, height, error);
+}
+
+gboolean ternary_plot_save_to_svg (TernaryPlot *plot, const gchar *filename,
+    gint width, gint height, GError **error)
+{
+    return ternary_plot_save (plot, TERNARY_RENDER_SVG, filename,
+        width, height, error);
+}
+
+gboolean ternary_plot_save_to_pdf (TernaryPlot *plot, const gchar *filename,
+    gint width, gint height, GError **error)
+{
+    return ternary_plot_save (plot, TERNARY_RENDER_PDF, filename,
+        width, height, error);
 }
 
-static gdouble ternary_plot_dot_to_line_distance (gdouble x, gdouble y,
-    gdouble x1, gdouble y1, gdouble x2, gdouble y2)
+gsize ternary_plot_get_n_points (TernaryPlot *plot)
 {
-    gdouble d, dx, dy;
+    TernaryPlotPrivate *priv;
+
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0);
+    priv = TERNARY_PLOT_GET_PRIVATE (plot);
+    return priv->state.n_points;
+}
 
-    dx = x2 - x1;
-    dy = y2 - y1;
-    d = ((y1 - y) * dx - (x1 - x) * dy) / sqrt (dx * dx + dy * dy);
+gdouble ternary_plot_get_tolerance (TernaryPlot *plot)
+{
+    g_return_val_if_fail (TERNARY_IS_PLOT (plot), 0.0);
 
-    return d;
+    return plot->tol * 100.0;
 }
@@ -22,6 +22,9 @@
 
 #include <gtk/gtk.h>
 
+#include "ternaryplot-colormap.h"
+#include "ternaryplot-dataset.h"
+
 G_BEGIN_DECLS
 
 #define TERNARY_TYPE_PLOT          (ternary_plot_get_type ())
@@ -36,6 +39,44 @@ G_BEGIN_DECLS
 #define TERNARY_PLOT_GET_CLASS     (G_TYPE_INSTANCE_GET_CLASS ((obj), \
                                     TERNARY_TYPE_PLOT, TernaryPlotClass))
 
+#define TERNARY_PLOT_ERROR         (ternary_plot_error_quark ())
+
+typedef enum
+{
+    TERNARY_PLOT_ERROR_FAILED,
+    TERNARY_PLOT_ERROR_INVALID
+} TernaryPlotError;
+
+/* what ternary_plot_append_points does when the stream queue is full */
+typedef enum
+{
+    TERNARY_PLOT_OVERFLOW_DROP_OLDEST,
+    TERNARY_PLOT_OVERFLOW_BLOCK
+} TernaryPlotOverflowPolicy;
+
+typedef enum
+{
+    TERNARY_PLOT_PHASE_EXPOSE,
+    TERNARY_PLOT_PHASE_FIELD,
+    TERNARY_PLOT_PHASE_DATA,
+    TERNARY_PLOT_PHASE_TRAJECTORY,
+    TERNARY_PLOT_PHASE_CONTOURS,
+    TERNARY_PLOT_PHASE_SUMMARY,
+    TERNARY_PLOT_PHASE_POINTER,
+    TERNARY_PLOT_PHASE_LABELS,
+    TERNARY_PLOT_PHASE_MOTION,
+    TERNARY_PLOT_PHASE_RELEASE,
+    TERNARY_PLOT_N_PHASES
+} TernaryPlotPhase;
+
+typedef struct _TernaryPlotTiming TernaryPlotTiming;
+
+struct _TernaryPlotTiming
+{
+    guint n_samples; /* in the rolling window */
+    gdouble min, avg, p99; /* milliseconds */
+};
+
 typedef struct _TernaryPlot         TernaryPlot;
 typedef struct _TernaryPlotClass    TernaryPlotClass;
 
@@ -57,8 +98,18 @@ struct _TernaryPlotClass
                            gdouble x,
                            gdouble y,
                            gdouble z);
+    void (*point_dragging) (TernaryPlot *plot,
+                            gdouble x,
+                            gdouble y,
+                            gdouble z);
+    void (*point_hovered) (TernaryPlot *plot,
+                           gint64 index);
+    void (*point_activated) (TernaryPlot *plot,
+                             gint64 index);
+    void (*selection_changed) (TernaryPlot *plot);
 };
 
+GQuark ternary_plot_error_quark (void);
 GType ternary_plot_get_type (void);
 GtkWidget * ternary_plot_new (void);
 void ternary_plot_set_xlabel (TernaryPlot *plot, const gchar *xlabel);
@@ -69,8 +120,143 @@ const gchar* ternary_plot_get_ylabel (TernaryPlot *plot);
 const gchar* ternary_plot_get_zlabel (TernaryPlot *plot);
 void ternary_plot_set_tolerance (TernaryPlot *plot, gdouble tol);
 gdouble ternary_plot_get_tolerance (TernaryPlot *plot);
+void ternary_plot_set_grid_step (TernaryPlot *plot, gdouble step);
+gdouble ternary_plot_get_grid_step (TernaryPlot *plot);
+void ternary_plot_set_drag_rate (TernaryPlot *plot, gdouble rate);
+gdouble ternary_plot_get_drag_rate (TernaryPlot *plot);
+void ternary_plot_set_density (TernaryPlot *plot, gboolean density);
+gboolean ternary_plot_get_density (TernaryPlot *plot);
+void ternary_plot_set_density_resolution (TernaryPlot *plot, guint resolution);
+guint ternary_plot_get_density_resolution (TernaryPlot *plot);
+void ternary_plot_set_contours (TernaryPlot *plot, gboolean contours);
+gboolean ternary_plot_get_contours (TernaryPlot *plot);
+void ternary_plot_set_bandwidth (TernaryPlot *plot, gdouble bandwidth);
+gdouble ternary_plot_get_bandwidth (TernaryPlot *plot);
+/* Centre and spread of the points in log-ratio terms, kept up to date
+ * as points are appended without visiting the earlier ones again. */
+void ternary_plot_set_summary (TernaryPlot *plot, gboolean summary);
+gboolean ternary_plot_get_summary (TernaryPlot *plot);
+void ternary_plot_set_summary_level (TernaryPlot *plot, gdouble level);
+gdouble ternary_plot_get_summary_level (TernaryPlot *plot);
+gboolean ternary_plot_get_centre (TernaryPlot *plot, gdouble *x,
+    gdouble *y, gdouble *z);
+gdouble ternary_plot_get_total_variance (TernaryPlot *plot);
 void ternary_plot_set_point (TernaryPlot *plot, gdouble x, gdouble y, gdouble z);
 void ternary_plot_get_point (TernaryPlot *plot, gdouble *x, gdouble *y, gdouble *z);
+/* Zoomed views show the sub-triangle x >= xmin, y >= ymin, z >= zmin.
+ * The scroll wheel zooms about the mouse and the middle button pans. */
+void ternary_plot_set_view (TernaryPlot *plot, gdouble xmin, gdouble ymin,
+    gdouble zmin);
+void ternary_plot_get_view (TernaryPlot *plot, gdouble *xmin, gdouble *ymin,
+    gdouble *zmin);
+/* The point, set or dragged, is kept in the feasible region: the
+ * compositions within the bounds and meeting every constraint added. */
+gboolean ternary_plot_set_bounds (TernaryPlot *plot, gdouble xmin,
+    gdouble xmax, gdouble ymin, gdouble ymax, gdouble zmin, gdouble zmax);
+gboolean ternary_plot_add_constraint (TernaryPlot *plot, gdouble a,
+    gdouble b, gdouble c, gdouble d);
+void ternary_plot_clear_constraints (TernaryPlot *plot);
+void ternary_plot_set_points (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n);
+void ternary_plot_set_points_full (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n, GDestroyNotify destroy,
+    gpointer data);
+void ternary_plot_set_dataset (TernaryPlot *plot, TernaryDataset *dataset);
+TernaryDataset *ternary_plot_get_dataset (TernaryPlot *plot);
+gsize ternary_plot_get_n_points (TernaryPlot *plot);
+
+/* Per point appearance of the scatter layer. Row i of each column is
+ * point i; points past the end of a column, and NaN rows, are drawn as
+ * usual. The density layer ignores both. */
+void ternary_plot_set_values (TernaryPlot *plot, const gdouble *values,
+    gsize n);
+void ternary_plot_set_sizes (TernaryPlot *plot, const gdouble *sizes,
+    gsize n);
+void ternary_plot_set_colormap (TernaryPlot *plot, TernaryColormap colormap);
+TernaryColormap ternary_plot_get_colormap (TernaryPlot *plot);
+void ternary_plot_set_value_range (TernaryPlot *plot, gdouble min,
+    gdouble max);
+void ternary_plot_get_value_range (TernaryPlot *plot, gdouble *min,
+    gdouble *max);
+
+/* Path through samples taken over time, drawn over the scatter layer.
+ * Appending only strokes the new segments. */
+void ternary_plot_append_trajectory (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n);
+void ternary_plot_clear_trajectory (TernaryPlot *plot);
+gsize ternary_plot_get_trajectory_length (TernaryPlot *plot);
+void ternary_plot_set_trajectory_style (TernaryPlot *plot, gdouble red,
+    gdouble green, gdouble blue, gdouble width);
+
+/* Subset of the points, picked with the first button by drawing a lasso
+ * with shift held or dragging a range brush with control held, or
+ * through these calls. Each emits selection-changed. */
+void ternary_plot_select_lasso (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, guint n);
+void ternary_plot_select_range (TernaryPlot *plot, gdouble xmin,
+    gdouble xmax, gdouble ymin, gdouble ymax, gdouble zmin, gdouble zmax);
+void ternary_plot_clear_selection (TernaryPlot *plot);
+gsize ternary_plot_get_n_selected (TernaryPlot *plot);
+const guint32 *ternary_plot_get_selection (TernaryPlot *plot,
+    gsize *n_points);
+gboolean ternary_plot_is_selected (TernaryPlot *plot, gsize index);
+
+/* Binary data sets (see ternaryplot-datafile.h), memory-mapped so that
+ * loading does not parse or copy the points. */
+gboolean ternary_plot_load_data (TernaryPlot *plot, const gchar *filename,
+    GError **error);
+gboolean ternary_plot_save_data (TernaryPlot *plot, const gchar *filename,
+    GError **error);
+gboolean ternary_plot_load_csv (TernaryPlot *plot, const gchar *filename,
+    gsize *n_skipped, GError **error);
+
+/* Level of detail pyramid over the current points, built automatically
+ * for large data sets. Saving it next to the data set and loading it
+ * after ternary_plot_set_points skips the build. */
+gboolean ternary_plot_save_pyramid (TernaryPlot *plot, const gchar *filename,
+    GError **error);
+gboolean ternary_plot_load_pyramid (TernaryPlot *plot, const gchar *filename,
+    GError **error);
+
+/* Streaming. ternary_plot_append_points may be called from any thread;
+ * points are queued and added to the scatter layer once per frame on
+ * the main loop. The other calls are main thread only. The queue
+ * length is rounded up to a power of two. */
+void ternary_plot_append_points (TernaryPlot *plot, const gdouble *x,
+    const gdouble *y, const gdouble *z, gsize n);
+void ternary_plot_set_stream_capacity (TernaryPlot *plot, guint capacity);
+guint ternary_plot_get_stream_capacity (TernaryPlot *plot);
+void ternary_plot_set_overflow_policy (TernaryPlot *plot,
+    TernaryPlotOverflowPolicy policy);
+TernaryPlotOverflowPolicy ternary_plot_get_overflow_policy (TernaryPlot *plot);
+gsize ternary_plot_get_n_dropped (TernaryPlot *plot);
+
+void ternary_plot_set_stats_enabled (TernaryPlot *plot, gboolean enabled);
+gboolean ternary_plot_get_stats_enabled (TernaryPlot *plot);
+gboolean ternary_plot_get_timing (TernaryPlot *plot, TernaryPlotPhase phase,
+    TernaryPlotTiming *timing);
+gchar *ternary_plot_get_stats (TernaryPlot *plot);
+gboolean ternary_plot_get_layer_ready (TernaryPlot *plot);
+
+/* Batched coordinate transforms for the current allocation. z is the
+ * implicit 1 - x - y and may be NULL. */
+void ternary_plot_pixels_to_ternary (TernaryPlot *plot,
+    const gdouble *px, const gdouble *py,
+    gdouble *x, gdouble *y, gdouble *z, gsize n);
+void ternary_plot_ternary_to_pixels (TernaryPlot *plot,
+    const gdouble *x, const gdouble *y,
+    gdouble *px, gdouble *py, gsize n);
+
+/* Drawing without a window. The plot is laid out for the given size,
+ * independently of its allocation, and need not be realized. */
+void ternary_plot_render_to_surface (TernaryPlot *plot,
+    cairo_surface_t *surface, gint width, gint height);
+gboolean ternary_plot_save_to_png (TernaryPlot *plot, const gchar *filename,
+    gint width, gint height, GError **error);
+gboolean ternary_plot_save_to_svg (TernaryPlot *plot, const gchar *filename,
+    gint width, gint height, GError **error);
+gboolean ternary_plot_save_to_pdf (TernaryPlot *plot, const gchar *filename,
+    gint width, gint height, GError **error);
 
 G_END_DECLS
 
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+
+#include "ternaryplot-constraints.h"
+
+#define TOLERANCE 1e-9
+
+/* projects (x, y, z), checking whether it moved and where to */
+static void assert_projects (TernaryConstraints *constraints, gdouble x,
+    gdouble y, gdouble z, gboolean moved, gdouble px, gdouble py, gdouble pz)
+{
+    g_assert_cmpint (ternary_constraints_project (constraints, &x, &y, &z),
+                     ==, moved);
+    g_assert_cmpfloat (fabs (x - px), <, TOLERANCE);
+    g_assert_cmpfloat (fabs (y - py), <, TOLERANCE);
+    g_assert_cmpfloat (fabs (z - pz), <, TOLERANCE);
+}
+
+static void test_simplex (void)
+{
+    TernaryConstraints *constraints;
+
+    constraints = ternary_constraints_new ();
+    assert_projects (constraints, 0.2, 0.3, 0.5, FALSE, 0.2, 0.3, 0.5);
+    assert_projects (constraints, 1.0, 0.0, 0.0, FALSE, 1.0, 0.0, 0.0);
+    ternary_constraints_free (constraints);
+}
+
+/* bounds pinning two components leave a single feasible point */
+static void test_single_vertex (void)
+{
+    static const gdouble min[3] = { 0.2, 0.3, 0.0 };
+    static const gdouble max[3] = { 0.2, 0.3, 1.0 };
+    TernaryConstraints *constraints;
+
+    constraints = ternary_constraints_new ();
+    g_assert_true (ternary_constraints_set_bounds (constraints, min, max));
+    assert_projects (constraints, 0.2, 0.3, 0.5, FALSE, 0.2, 0.3, 0.5);
+    assert_projects (constraints, 1.0, 0.0, 0.0, TRUE, 0.2, 0.3, 0.5);
+    assert_projects (constraints, 0.0, 0.0, 1.0, TRUE, 0.2, 0.3, 0.5);
+    ternary_constraints_free (constraints);
+}
+
+/* pinning one component leaves a segment, which has no inside: points
+ * move onto it across it, or to its nearer end */
+static void test_two_vertices (void)
+{
+    static const gdouble min[3] = { 0.2, 0.0, 0.0 };
+    static const gdouble max[3] = { 0.2, 1.0, 1.0 };
+    TernaryConstraints *constraints;
+
+    constraints = ternary_constraints_new ();
+    g_assert_true (ternary_constraints_set_bounds (constraints, min, max));
+    assert_projects (constraints, 0.2, 0.5, 0.3, FALSE, 0.2, 0.5, 0.3);
+    assert_projects (constraints, 0.5, 0.25, 0.25, TRUE, 0.2, 0.4, 0.4);
+    assert_projects (constraints, 0.0, 1.0, 0.0, TRUE, 0.2, 0.8, 0.0);
+    ternary_constraints_free (constraints);
+
+    /* the same segment from two opposite inequalities */
+    constraints = ternary_constraints_new ();
+    g_assert_true (ternary_constraints_add (constraints, 1, 0, 0, 0.2));
+    g_assert_true (ternary_constraints_add (constraints, -1, 0, 0, -0.2));
+    assert_projects (constraints, 0.5, 0.25, 0.25, TRUE, 0.2, 0.4, 0.4);
+    assert_projects (constraints, 0.0, 0.0, 1.0, TRUE, 0.2, 0.0, 0.8);
+    ternary_constraints_free (constraints);
+}
+
+/* what would leave nothing feasible is refused and changes nothing */
+static void test_infeasible (void)
+{
+    static const gdouble min[3] = { 0.6, 0.6, 0.0 };
+    static const gdouble max[3] = { 1.0, 1.0, 1.0 };
+    TernaryConstraints *constraints;
+
+    constraints = ternary_constraints_new ();
+    g_assert_true (ternary_constraints_add (constraints, 1, 0, 0, 0.5));
+    g_assert_false (ternary_constraints_set_bounds (constraints, min, max));
+    g_assert_false (ternary_constraints_add (constraints, -1, 0, 0, -0.7));
+    assert_projects (constraints, 0.4, 0.3, 0.3, FALSE, 0.4, 0.3, 0.3);
+    assert_projects (constraints, 1.0, 0.0, 0.0, TRUE, 0.5, 0.25, 0.25);
+    ternary_constraints_free (constraints);
+}
+
+int main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/constraints/simplex", test_simplex);
+    g_test_add_func ("/constraints/single-vertex", test_single_vertex);
+    g_test_add_func ("/constraints/two-vertices", test_two_vertices);
+    g_test_add_func ("/constraints/infeasible", test_infeasible);
+
+    return g_test_run ();
+}
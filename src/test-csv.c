@@ -0,0 +1,159 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <math.h>
+
+#include "ternaryplot-csv.h"
+
+static gchar *directory;
+
+/* loads text as a file */
+static TernaryCsv *load_text (const gchar *text)
+{
+    TernaryCsv *csv;
+    GError *error = NULL;
+    gchar *filename;
+
+    filename = g_build_filename (directory, "test.csv", NULL);
+    g_assert_true (g_file_set_contents (filename, text, -1, NULL));
+    csv = ternary_csv_load (filename, &error);
+    g_assert_no_error (error);
+    g_assert_nonnull (csv);
+
+    g_unlink (filename);
+    g_free (filename);
+
+    return csv;
+}
+
+static void assert_point (TernaryCsv *csv, gsize i, gdouble x, gdouble y,
+    gdouble z)
+{
+    g_assert_cmpuint (i, <, csv->n_points);
+    g_assert_cmpfloat (fabs (csv->x[i] - x), <, 1e-12);
+    g_assert_cmpfloat (fabs (csv->y[i] - y), <, 1e-12);
+    g_assert_cmpfloat (fabs (csv->z[i] - z), <, 1e-12);
+}
+
+static void test_crlf (void)
+{
+    TernaryCsv *csv;
+
+    csv = load_text ("a,b,c\r\n1,1,2\r\n\r\n# comment\r\n2,1,1\r\n");
+    g_assert_cmpstr (csv->labels[0], ==, "a");
+    g_assert_cmpstr (csv->labels[2], ==, "c");
+    g_assert_cmpuint (csv->n_points, ==, 2);
+    g_assert_cmpuint (csv->n_malformed, ==, 0);
+    assert_point (csv, 0, 0.25, 0.25, 0.5);
+    assert_point (csv, 1, 0.5, 0.25, 0.25);
+    ternary_csv_free (csv);
+
+    /* no header, and no newline after the last row */
+    csv = load_text ("1,2,1\r\n1,1,2");
+    g_assert_null (csv->labels[0]);
+    g_assert_cmpuint (csv->n_points, ==, 2);
+    assert_point (csv, 1, 0.25, 0.25, 0.5);
+    ternary_csv_free (csv);
+}
+
+static void test_quoted_header (void)
+{
+    TernaryCsv *csv;
+
+    csv = load_text ("\"Tax\", \"Luxury\",\"Science\"\n\"1\",\"1\",\"2\"\n");
+    g_assert_cmpstr (csv->labels[0], ==, "Tax");
+    g_assert_cmpstr (csv->labels[1], ==, "Luxury");
+    g_assert_cmpstr (csv->labels[2], ==, "Science");
+    g_assert_cmpuint (csv->n_points, ==, 1);
+    assert_point (csv, 0, 0.25, 0.25, 0.5);
+    ternary_csv_free (csv);
+
+    /* tabs delimit when the first line has one */
+    csv = load_text ("x\ty\tz\n1\t2\t1\textra\n");
+    g_assert_cmpstr (csv->labels[1], ==, "y");
+    g_assert_cmpuint (csv->n_points, ==, 1);
+    assert_point (csv, 0, 0.25, 0.5, 0.25);
+    ternary_csv_free (csv);
+}
+
+/* rows closure cannot make a composition of are counted, not kept */
+static void test_non_finite (void)
+{
+    TernaryCsv *csv;
+
+    csv = load_text ("nan,1,1\n1,inf,1\n1,1,-inf\n1,1,1\nNaN,NAN,nan\n");
+    g_assert_cmpuint (csv->n_points, ==, 1);
+    g_assert_cmpuint (csv->n_degenerate, ==, 4);
+    g_assert_cmpuint (csv->n_malformed, ==, 0);
+    assert_point (csv, 0, 1.0 / 3, 1.0 / 3, 1.0 / 3);
+    ternary_csv_free (csv);
+}
+
+static void test_zero_sum (void)
+{
+    TernaryCsv *csv;
+
+    /* components count by magnitude, so only zeros sum to zero */
+    csv = load_text ("0,0,0\n1,-1,0\n0.0,0e5,-0\n3,0,0\n");
+    g_assert_cmpuint (csv->n_points, ==, 2);
+    g_assert_cmpuint (csv->n_degenerate, ==, 2);
+    assert_point (csv, 0, 0.5, 0.5, 0.0);
+    assert_point (csv, 1, 1.0, 0.0, 0.0);
+    ternary_csv_free (csv);
+}
+
+static void test_malformed (void)
+{
+    TernaryCsv *csv;
+
+    /* words past a numeric first line are rows, not a header, and an
+     * e without an exponent ends a number short of the delimiter */
+    csv = load_text ("1,2,3\n1,2\nx,y,z\n1,,2\n.,1,1\n1e,1,1\n2,4,6\n");
+    g_assert_cmpuint (csv->n_points, ==, 2);
+    g_assert_cmpuint (csv->n_malformed, ==, 5);
+    g_assert_null (csv->labels[0]);
+    assert_point (csv, 0, 1.0 / 6, 2.0 / 6, 3.0 / 6);
+    assert_point (csv, 1, 1.0 / 6, 2.0 / 6, 3.0 / 6);
+    ternary_csv_free (csv);
+}
+
+int main (int argc, char *argv[])
+{
+    int status;
+
+    g_test_init (&argc, &argv, NULL);
+
+    directory = g_dir_make_tmp ("ternaryplot-XXXXXX", NULL);
+    g_assert_nonnull (directory);
+
+    g_test_add_func ("/csv/crlf", test_crlf);
+    g_test_add_func ("/csv/quoted-header", test_quoted_header);
+    g_test_add_func ("/csv/non-finite", test_non_finite);
+    g_test_add_func ("/csv/zero-sum", test_zero_sum);
+    g_test_add_func ("/csv/malformed", test_malformed);
+
+    status = g_test_run ();
+
+    g_rmdir (directory);
+    g_free (directory);
+
+    return status;
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <math.h>
+#include <string.h>
+
+#include "ternaryplot.h"
+#include "ternaryplot-datafile.h"
+
+#define N_POINTS 1000
+
+/* header fields, as laid out in ternaryplot-datafile.c */
+#define AT_MAGIC 0
+#define AT_VERSION 4
+#define AT_FLAGS 8
+#define AT_N_POINTS 16
+#define AT_LABELS_OFFSET 32
+#define AT_INDEX_OFFSET 48
+
+static gchar *directory;
+
+static gchar *test_filename (const gchar *name)
+{
+    return g_build_filename (directory, name, NULL);
+}
+
+/* a small data set with labels, metadata and a pyramid */
+static gchar *write_sample (gchar **contents, gsize *length)
+{
+    static const gchar *labels[3] = { "Tax", "Luxury", "Science" };
+    gdouble x[N_POINTS], y[N_POINTS], z[N_POINTS];
+    TernaryPyramid *pyramid;
+    GError *error = NULL;
+    gchar *filename;
+    gint i;
+
+    for (i = 0; i < N_POINTS; i++)
+    {
+        gdouble sum = 3 + i % 7 + i % 5 + i % 3;
+
+        x[i] = (1 + i % 7) / sum;
+        y[i] = (1 + i % 5) / sum;
+        z[i] = (1 + i % 3) / sum;
+    }
+
+    filename = test_filename ("sample.tpd");
+    pyramid = ternary_pyramid_new (x, y, z, N_POINTS, 3);
+    g_assert_nonnull (pyramid);
+    g_assert_true (ternary_data_file_write (filename, x, y, z, N_POINTS,
+                   labels, "metadata", pyramid, &error));
+    g_assert_no_error (error);
+    ternary_pyramid_free (pyramid);
+
+    if (contents)
+        g_assert_true (g_file_get_contents (filename, contents, length,
+                                            NULL));
+
+    return filename;
+}
+
+/* the first length bytes of contents must be refused */
+static void expect_invalid (const gchar *contents, gsize length)
+{
+    TernaryDataFile *data;
+    GError *error = NULL;
+    gchar *filename;
+
+    filename = test_filename ("corrupt.tpd");
+    g_assert_true (g_file_set_contents (filename, contents, length, NULL));
+    data = ternary_data_file_open (filename, &error);
+    g_assert_null (data);
+    g_assert_error (error, TERNARY_PLOT_ERROR, TERNARY_PLOT_ERROR_INVALID);
+
+    g_clear_error (&error);
+    g_unlink (filename);
+    g_free (filename);
+}
+
+/* the same with the 32 bit word at offset at replaced */
+static void expect_corrupt (const gchar *contents, gsize length, gsize at,
+    guint32 word)
+{
+    gchar *copy;
+
+    copy = g_malloc (length);
+    memcpy (copy, contents, length);
+    word = GUINT32_TO_LE (word);
+    memcpy (copy + at, &word, sizeof (word));
+    expect_invalid (copy, length);
+    g_free (copy);
+}
+
+static void test_round_trip (void)
+{
+    TernaryDataFile *data;
+    TernaryPyramid *pyramid;
+    GError *error = NULL;
+    gchar *filename;
+    gint i;
+
+    filename = write_sample (NULL, NULL);
+    data = ternary_data_file_open (filename, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (data->n_points, ==, N_POINTS);
+    g_assert_true (data->closed);
+    g_assert_cmpstr (data->labels[0], ==, "Tax");
+    g_assert_cmpstr (data->labels[2], ==, "Science");
+    g_assert_cmpstr (data->metadata, ==, "metadata");
+    for (i = 0; i < N_POINTS; i++)
+        g_assert_cmpfloat (fabs (data->x[i] + data->y[i] + data->z[i] - 1.0),
+                           <, 1e-12);
+
+    pyramid = ternary_data_file_new_pyramid (data, &error);
+    g_assert_no_error (error);
+    g_assert_nonnull (pyramid);
+    g_assert_nonnull (pyramid->order);
+    g_assert_cmpuint (pyramid->counts[0][0], ==, N_POINTS);
+    ternary_pyramid_free (pyramid);
+
+    ternary_data_file_unref (data);
+    g_unlink (filename);
+    g_free (filename);
+}
+
+/* saving over the file the columns are mapped from */
+static void test_overwrite (void)
+{
+    TernaryDataFile *data, *again;
+    GError *error = NULL;
+    gchar *filename;
+
+    filename = write_sample (NULL, NULL);
+    data = ternary_data_file_open (filename, &error);
+    g_assert_no_error (error);
+    g_assert_true (ternary_data_file_write (filename, data->x, data->y,
+                   data->z, data->n_points, data->labels, NULL, NULL,
+                   &error));
+    g_assert_no_error (error);
+
+    again = ternary_data_file_open (filename, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (again->n_points, ==, N_POINTS);
+    g_assert_cmpfloat (again->x[N_POINTS - 1], ==, data->x[N_POINTS - 1]);
+    g_assert_null (again->metadata);
+
+    ternary_data_file_unref (again);
+    ternary_data_file_unref (data);
+    g_unlink (filename);
+    g_free (filename);
+}
+
+static void test_truncated (void)
+{
+    gchar *filename, *contents;
+    gsize length;
+
+    filename = write_sample (&contents, &length);
+
+    expect_invalid (contents, 0);
+    expect_invalid (contents, 63);
+    /* cut inside the columns and inside the index */
+    expect_invalid (contents, 64 + N_POINTS * sizeof (gdouble));
+    expect_invalid (contents, length - 4);
+
+    g_unlink (filename);
+    g_free (filename);
+    g_free (contents);
+}
+
+static void test_corrupt (void)
+{
+    gchar *filename, *contents;
+    gsize length;
+
+    filename = write_sample (&contents, &length);
+
+    expect_corrupt (contents, length, AT_MAGIC, 0x12345678);
+    expect_corrupt (contents, length, AT_VERSION, 0);
+    expect_corrupt (contents, length, AT_VERSION, 99);
+    expect_corrupt (contents, length, AT_FLAGS, 0x80);
+    /* more points than the file holds, and sections past its end */
+    expect_corrupt (contents, length, AT_N_POINTS, 10 * N_POINTS);
+    expect_corrupt (contents, length, AT_LABELS_OFFSET, length + 8);
+    expect_corrupt (contents, length, AT_INDEX_OFFSET, length);
+    expect_corrupt (contents, length, AT_INDEX_OFFSET, 66);
+
+    g_unlink (filename);
+    g_free (filename);
+    g_free (contents);
+}
+
+/* a bad index is reported when the pyramid is asked for, the columns
+ * stay usable */
+static void test_corrupt_index (void)
+{
+    TernaryDataFile *data;
+    TernaryPyramid *pyramid;
+    GError *error = NULL;
+    gchar *filename, *contents;
+    guint64 index_offset;
+    guint32 word = GUINT32_TO_LE (7);
+    gsize length;
+
+    filename = write_sample (&contents, &length);
+    memcpy (&index_offset, contents + AT_INDEX_OFFSET, sizeof (index_offset));
+    index_offset = GUINT64_FROM_LE (index_offset);
+
+    /* the pyramid version */
+    memcpy (contents + index_offset + 4, &word, sizeof (word));
+    g_assert_true (g_file_set_contents (filename, contents, length, NULL));
+
+    data = ternary_data_file_open (filename, &error);
+    g_assert_no_error (error);
+    pyramid = ternary_data_file_new_pyramid (data, &error);
+    g_assert_null (pyramid);
+    g_assert_error (error, TERNARY_PLOT_ERROR, TERNARY_PLOT_ERROR_INVALID);
+    g_clear_error (&error);
+    g_assert_cmpfloat (fabs (data->x[0] + data->y[0] + data->z[0] - 1.0),
+                       <, 1e-12);
+
+    ternary_data_file_unref (data);
+    g_unlink (filename);
+    g_free (filename);
+    g_free (contents);
+}
+
+int main (int argc, char *argv[])
+{
+    int status;
+
+    g_test_init (&argc, &argv, NULL);
+
+    directory = g_dir_make_tmp ("ternaryplot-XXXXXX", NULL);
+    g_assert_nonnull (directory);
+
+    g_test_add_func ("/datafile/round-trip", test_round_trip);
+    g_test_add_func ("/datafile/overwrite", test_overwrite);
+    g_test_add_func ("/datafile/truncated", test_truncated);
+    g_test_add_func ("/datafile/corrupt", test_corrupt);
+    g_test_add_func ("/datafile/corrupt-index", test_corrupt_index);
+
+    status = g_test_run ();
+
+    g_rmdir (directory);
+    g_free (directory);
+
+    return status;
+}
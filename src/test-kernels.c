@@ -0,0 +1,96 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+#include <math.h>
+
+#include "ternaryplot-kernels.h"
+
+#define N_POINTS 1000
+#define TOLERANCE 1e-12
+
+/* closed compositions with parts from 1e-6 to most of the whole */
+static void compositions (gdouble *x, gdouble *y, gdouble *z)
+{
+    gdouble a[N_POINTS], b[N_POINTS], c[N_POINTS];
+    gint i;
+
+    g_random_set_seed (1);
+    for (i = 0; i < N_POINTS; i++)
+    {
+        a[i] = pow (10, g_random_double_range (-6, 0));
+        b[i] = pow (10, g_random_double_range (-6, 0));
+        c[i] = pow (10, g_random_double_range (-6, 0));
+    }
+    ternary_kernels_closure (a, b, c, x, y, z, N_POINTS);
+}
+
+static void test_clr_round_trip (void)
+{
+    gdouble x[N_POINTS], y[N_POINTS], z[N_POINTS];
+    gdouble a[N_POINTS], b[N_POINTS], c[N_POINTS];
+    gdouble rx[N_POINTS], ry[N_POINTS], rz[N_POINTS];
+    gint i;
+
+    compositions (x, y, z);
+    ternary_kernels_clr (x, y, z, a, b, c, N_POINTS);
+    for (i = 0; i < N_POINTS; i++)
+        g_assert_cmpfloat (fabs (a[i] + b[i] + c[i]), <, TOLERANCE);
+
+    ternary_kernels_clr_inverse (a, b, c, rx, ry, rz, N_POINTS);
+    for (i = 0; i < N_POINTS; i++)
+    {
+        g_assert_cmpfloat (fabs (rx[i] - x[i]), <, TOLERANCE);
+        g_assert_cmpfloat (fabs (ry[i] - y[i]), <, TOLERANCE);
+        g_assert_cmpfloat (fabs (rz[i] - z[i]), <, TOLERANCE);
+    }
+
+    /* the implicit third part gives the same coordinates */
+    ternary_kernels_clr (x, y, NULL, rx, ry, rz, N_POINTS);
+    for (i = 0; i < N_POINTS; i++)
+        g_assert_cmpfloat (fabs (rz[i] - c[i]), <, 1e-6);
+}
+
+static void test_ilr_round_trip (void)
+{
+    gdouble x[N_POINTS], y[N_POINTS], z[N_POINTS];
+    gdouble u[N_POINTS], v[N_POINTS];
+    gdouble rx[N_POINTS], ry[N_POINTS], rz[N_POINTS];
+    gint i;
+
+    compositions (x, y, z);
+    ternary_kernels_ilr (x, y, z, u, v, N_POINTS);
+    ternary_kernels_ilr_inverse (u, v, rx, ry, rz, N_POINTS);
+    for (i = 0; i < N_POINTS; i++)
+    {
+        g_assert_cmpfloat (fabs (rx[i] - x[i]), <, TOLERANCE);
+        g_assert_cmpfloat (fabs (ry[i] - y[i]), <, TOLERANCE);
+        g_assert_cmpfloat (fabs (rz[i] - z[i]), <, TOLERANCE);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/kernels/clr-round-trip", test_clr_round_trip);
+    g_test_add_func ("/kernels/ilr-round-trip", test_ilr_round_trip);
+
+    return g_test_run ();
+}
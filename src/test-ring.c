@@ -0,0 +1,203 @@
+/*
+ * Copyright 2012 Daniil Ivanov <daniil.ivanov@gmail.com>
+ *
+ * This file is part of TernaryPlot-Gtk2.
+ *
+ * TernaryPlot-Gtk2 is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * TernaryPlot-Gtk2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with TernaryPlot-Gtk2. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <glib.h>
+
+#include "ternaryplot-ring.h"
+
+#define N_THREADS 4 /* producers, and as many consumers */
+#define N_PUSHED 100000 /* points pushed per producer */
+
+typedef struct _RingTest RingTest;
+
+struct _RingTest
+{
+    TernaryRing *ring;
+    gboolean drop_oldest; /* make room by popping, as the plot does */
+    gint n_producers; /* still pushing */
+    gint n_dropped;
+    guint8 *seen; /* per producer and sequence number, popped once */
+    gint n_seen;
+};
+
+/* points carry their producer in x and their sequence number in y */
+static gpointer produce (gpointer data)
+{
+    RingTest *test = data;
+    static gint next_id = 0;
+    gint id, i;
+
+    id = g_atomic_int_add (&next_id, 1) % N_THREADS;
+    for (i = 0; i < N_PUSHED; i++)
+        while (!ternary_ring_push (test->ring, id, i, 0.0))
+        {
+            gdouble x, y, z;
+
+            if (!test->drop_oldest)
+                g_thread_yield ();
+            else if (ternary_ring_pop (test->ring, &x, &y, &z))
+                g_atomic_int_inc (&test->n_dropped);
+        }
+    g_atomic_int_add (&test->n_producers, -1);
+
+    return NULL;
+}
+
+/* checks every point arrives once, and in order from each producer */
+static gpointer consume (gpointer data)
+{
+    RingTest *test = data;
+    gint last[N_THREADS];
+    gdouble x, y, z;
+    gint k;
+
+    for (k = 0; k < N_THREADS; k++)
+        last[k] = -1;
+
+    for (;;)
+    {
+        gint id, i;
+
+        if (!ternary_ring_pop (test->ring, &x, &y, &z))
+        {
+            if (g_atomic_int_get (&test->n_producers) == 0)
+                break;
+            g_thread_yield ();
+            continue;
+        }
+
+        id = (gint) x;
+        i = (gint) y;
+        g_assert_cmpint (id, >=, 0);
+        g_assert_cmpint (id, <, N_THREADS);
+        g_assert_cmpint (i, >, last[id]);
+        last[id] = i;
+        g_assert_cmpint (test->seen[id * N_PUSHED + i], ==, 0);
+        test->seen[id * N_PUSHED + i] = 1;
+        g_atomic_int_inc (&test->n_seen);
+    }
+
+    return NULL;
+}
+
+static void run_threads (RingTest *test)
+{
+    GThread *threads[2 * N_THREADS];
+    gdouble x, y, z;
+    gint k;
+
+    test->n_producers = N_THREADS;
+    test->seen = g_new0 (guint8, N_THREADS * N_PUSHED);
+    for (k = 0; k < N_THREADS; k++)
+    {
+        threads[k] = g_thread_new ("producer", produce, test);
+        threads[N_THREADS + k] = g_thread_new ("consumer", consume, test);
+    }
+    for (k = 0; k < 2 * N_THREADS; k++)
+        g_thread_join (threads[k]);
+
+    /* whatever the consumers left after the last check */
+    while (ternary_ring_pop (test->ring, &x, &y, &z))
+    {
+        g_assert_cmpint (test->seen[(gint) x * N_PUSHED + (gint) y], ==, 0);
+        test->n_seen++;
+    }
+}
+
+static void test_capacity (void)
+{
+    TernaryRing *ring;
+
+    ring = ternary_ring_new (3);
+    g_assert_cmpuint (ternary_ring_get_capacity (ring), ==, 4);
+    ternary_ring_free (ring);
+
+    ring = ternary_ring_new (65536);
+    g_assert_cmpuint (ternary_ring_get_capacity (ring), ==, 65536);
+    ternary_ring_free (ring);
+}
+
+/* positions run many times around the slots, and a full ring refuses */
+static void test_wraparound (void)
+{
+    TernaryRing *ring;
+    gdouble x, y, z;
+    gint i, k;
+
+    ring = ternary_ring_new (4);
+    for (i = 0; i < 1000; i++)
+    {
+        for (k = 0; k < 3; k++)
+            g_assert_true (ternary_ring_push (ring, i, k, 1.0));
+        for (k = 0; k < 3; k++)
+        {
+            g_assert_true (ternary_ring_pop (ring, &x, &y, &z));
+            g_assert_cmpfloat (x, ==, i);
+            g_assert_cmpfloat (y, ==, k);
+            g_assert_cmpfloat (z, ==, 1.0);
+        }
+    }
+    g_assert_false (ternary_ring_pop (ring, &x, &y, &z));
+
+    for (k = 0; k < 4; k++)
+        g_assert_true (ternary_ring_push (ring, k, 0.0, 0.0));
+    g_assert_false (ternary_ring_push (ring, 4.0, 0.0, 0.0));
+    g_assert_true (ternary_ring_pop (ring, &x, &y, &z));
+    g_assert_cmpfloat (x, ==, 0.0);
+    ternary_ring_free (ring);
+}
+
+static void test_mpmc (void)
+{
+    RingTest test = { 0 };
+
+    test.ring = ternary_ring_new (1024);
+    run_threads (&test);
+    g_assert_cmpint (test.n_seen, ==, N_THREADS * N_PUSHED);
+    g_assert_cmpint (test.n_dropped, ==, 0);
+
+    g_free (test.seen);
+    ternary_ring_free (test.ring);
+}
+
+/* producers popping the oldest to make room lose points, never twice */
+static void test_drop_oldest (void)
+{
+    RingTest test = { 0 };
+
+    test.ring = ternary_ring_new (64);
+    test.drop_oldest = TRUE;
+    run_threads (&test);
+    g_assert_cmpint (test.n_seen + test.n_dropped, ==, N_THREADS * N_PUSHED);
+
+    g_free (test.seen);
+    ternary_ring_free (test.ring);
+}
+
+int main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/ring/capacity", test_capacity);
+    g_test_add_func ("/ring/wraparound", test_wraparound);
+    g_test_add_func ("/ring/mpmc", test_mpmc);
+    g_test_add_func ("/ring/drop-oldest", test_drop_oldest);
+
+    return g_test_run ();
+}